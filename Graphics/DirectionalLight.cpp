@@ -1 +1,7 @@
 #include "DirectionalLight.h"
+
+void DirectionalLight::FillBlock(aie::LightBlock& block) const
+{
+	Light::FillBlock(block);
+	block.direction = direction;
+}
\ No newline at end of file
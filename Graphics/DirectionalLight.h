@@ -8,4 +8,6 @@ public:
 	~DirectionalLight() {}
 
 	vec3 direction = { 0, -1, 0 };
+
+	void FillBlock(aie::LightBlock& block) const override;
 };
@@ -1,7 +1,12 @@
 #include "GraphicsApp.h"
 #include "Gizmos.h"
 #include "Input.h"
+#include "TextureUploader.h"
+#include "gl_core_4_4.h"
+#include <imgui.h>
+#include <chrono>
 #include <iostream>
+#include <thread>
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
 
@@ -36,25 +41,27 @@ bool GraphicsApp::startup()
 	// load shaders
 	phongShader.loadShader(eShaderStage::VERTEX, "./shaders/phong.vert");
 	phongShader.loadShader(eShaderStage::FRAGMENT, "./shaders/phong.frag");
-	normalShader.loadShader(eShaderStage::VERTEX, "./shaders/normalmap.vert");
-	normalShader.loadShader(eShaderStage::FRAGMENT, "./shaders/normalmap.frag");
-	postShader.loadShader(eShaderStage::VERTEX, "./shaders/post.vert");
-	postShader.loadShader(eShaderStage::FRAGMENT, "./shaders/post.frag");
-
-	// link shaders
-	if (phongShader.link() == false)
-	{
-		cout << "Phong shader link error: " << phongShader.getLastError() << endl;
-		return false;
-	}
-	if (normalShader.link() == false)
-	{
-		cout << "Normal map shader link error: " << normalShader.getLastError() << endl;
-		return false;
-	}
-	if (postShader.link() == false)
+	normalShaders.loadShader(eShaderStage::VERTEX, "./shaders/normalmap.vert");
+	normalShaders.loadShader(eShaderStage::FRAGMENT, "./shaders/normalmap.frag");
+	postShaders.loadShader(eShaderStage::VERTEX, "./shaders/post.vert");
+	postShaders.loadShader(eShaderStage::FRAGMENT, "./shaders/post.frag");
+	indirectShader.loadShader(eShaderStage::VERTEX, "./shaders/phong_indirect.vert");
+	indirectShader.loadShader(eShaderStage::FRAGMENT, "./shaders/phong_indirect.frag");
+
+	// start every link before waiting on any, so the driver can compile them in parallel
+	phongShader.beginLink();
+	indirectShader.beginLink();
+
+	// every post effect, so that switching between them doesn't hitch
+	for (int effect = 0; effect < 4; ++effect)
+		postShaders.get({ { "POST_EFFECT", effect } });
+
+	// drawn with until the others are ready, small enough to wait on
+	fallbackShader.loadShader(eShaderStage::VERTEX, "./shaders/fallback.vert");
+	fallbackShader.loadShader(eShaderStage::FRAGMENT, "./shaders/fallback.frag");
+	if (fallbackShader.link() == false)
 	{
-		cout << "Post shader link error: " << postShader.getLastError() << endl;
+		cout << "Fallback shader link error: " << fallbackShader.getLastError() << endl;
 		return false;
 	}
 
@@ -68,10 +75,58 @@ bool GraphicsApp::startup()
 	// initialise meshes for target rendering
 	fullScreenQuadMesh.InitialiseFullScreenQuad();
 
-	// initiliase object meshes
-	dragon.LoadMesh("./stanford/dragon.obj");
-	spear.LoadMesh("./soulspear/soulspear.obj", true, true);
-	statuette.LoadMesh("./statuette/statuette.obj", true, true);
+	// initiliase object meshes, all sharing the pool's buffers
+	meshPool.initialise(256 * 1024, 1024 * 1024);
+	// their textures start with only small mips, the rest stream in as they're seen up close
+	dragon.LoadMesh("./stanford/dragon.obj", true, false, &meshPool, &textureStreamer);
+	spear.LoadMesh("./soulspear/soulspear.obj", true, true, &meshPool, &textureStreamer);
+	auto statuetteStart = chrono::high_resolution_clock::now();
+	statuette.LoadMesh("./statuette/statuette.obj", true, true, &meshPool, &textureStreamer);
+	statuetteLoadTime = chrono::duration<float, milli>(chrono::high_resolution_clock::now() - statuetteStart).count();
+
+	// the permutations the normal mapped meshes start with, others are compiled when first drawn
+	normalShaders.get(NormalMapDefines(spear.mesh));
+	normalShaders.get(NormalMapDefines(statuette.mesh));
+
+	// stand-alone copies of the benchmark meshes, to compare against the pool
+	unpooledMeshes[0].load("./soulspear/soulspear.obj", true, true);
+	unpooledMeshes[1].load("./statuette/statuette.obj", true, true);
+
+	// lay the benchmark meshes out in a grid
+	unsigned int benchmarkColumns = (unsigned int)sqrtf((float)benchmarkCount);
+	benchmarkTransforms.reserve(benchmarkCount);
+	for (unsigned int i = 0; i < benchmarkCount; ++i)
+	{
+		float x = (float)(i % benchmarkColumns) - benchmarkColumns * 0.5f;
+		float z = (float)(i / benchmarkColumns) - benchmarkColumns * 0.5f;
+		benchmarkTransforms.push_back(translate(mat4(1), vec3(x, 0, z) * 1.5f) * scale(mat4(1), vec3(0.25f)));
+	}
+	streamBuffer = new RingBuffer(8 * 1024 * 1024);
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, (int*)&uniformBufferAlignment);
+	unsigned int maxChunks = (unsigned int)glm::max(spear.mesh.getChunkCount(), statuette.mesh.getChunkCount());
+	benchmarkBatch.initialise(&meshPool, streamBuffer, benchmarkCount * maxChunks);
+	sceneBatch.initialise(&meshPool, streamBuffer, (unsigned int)dragon.mesh.getChunkCount());
+
+	// a sprite recorder per thread for the sprite storm
+	renderer2D = new Renderer2D();
+	spriteRecorders.resize(std::max(thread::hardware_concurrency(), 1u));
+
+	// images for the sprite storm, decoded and uploaded in the background over the first frames
+	const char* spriteImages[] = { "./textures/tankBlue.png", "./textures/tankGreen.png", "./textures/tankRed.png",
+		"./textures/barrelBlue.png", "./textures/barrelRed.png", "./textures/ship.png", "./textures/car.png" };
+	spriteTextures.resize(sizeof(spriteImages) / sizeof(spriteImages[0]));
+	for (size_t i = 0; i < spriteTextures.size(); ++i)
+		if (spriteTextures[i].load(spriteImages[i]) == false)
+			cout << "Missing sprite image " << spriteImages[i] << endl;
+
+	// enough labels to cover the screen for the text benchmark
+	textFont = new Font("./font/consolas.ttf", 16);
+	char label[32];
+	for (unsigned int i = 0; i < 1000; ++i)
+	{
+		sprintf_s(label, "Label %03u", i);
+		textLabels.push_back(label);
+	}
 
 	// initialise object transforms
 	dragon.transform =
@@ -101,11 +156,23 @@ bool GraphicsApp::startup()
 
 void GraphicsApp::shutdown()
 {
+	delete textFont;
+	delete worldGrid;
+	delete tileLayer;
+	delete tileset;
+	delete renderer2D;
+	delete streamBuffer;
 	Gizmos::destroy();
 }
 
 void GraphicsApp::update(float deltaTime)
 {
+	// shaders finish linking in the background, quit if any fail as startup would have
+	CheckShader(phongShader, "Phong");
+	CheckShader(normalShaders, "Normal map");
+	CheckShader(postShaders, "Post");
+	CheckShader(indirectShader, "Indirect");
+
 	// wipe the gizmos clean for this frame
 	Gizmos::clear();
 
@@ -141,6 +208,13 @@ void GraphicsApp::update(float deltaTime)
 	// update the camera
 	flyCam.Update(deltaTime);
 
+	// ask for the texture detail each object needs at its size on screen, then stream it
+	float screenHeight = (float)getWindowHeight();
+	dragon.mesh.requestTextures(dragon.GetScreenSize(&flyCam, screenHeight));
+	spear.mesh.requestTextures(spear.GetScreenSize(&flyCam, screenHeight));
+	statuette.mesh.requestTextures(statuette.GetScreenSize(&flyCam, screenHeight));
+	textureStreamer.update();
+
 	// quit if we press escape
 	aie::Input* input = aie::Input::getInstance();
 
@@ -151,6 +225,106 @@ void GraphicsApp::update(float deltaTime)
 
 	if (input->isKeyDown(aie::INPUT_KEY_ESCAPE))
 		quit();
+
+	// benchmark controls
+	ImGui::Begin("Benchmark");
+	ImGui::Checkbox("Scene multi-draw indirect", &sceneIndirect);
+	ImGui::Checkbox("Draw 10k meshes", &benchmarkEnabled);
+	ImGui::Checkbox("Multi-draw indirect", &benchmarkIndirect);
+	ImGui::Checkbox("Pooled meshes", &benchmarkPooled);
+	ImGui::Text("CPU submit: %.3f ms", benchmarkSubmitTime);
+
+	// the labels are the same every frame, so with the run cache on only the changing ones are laid out
+	ImGui::Checkbox("Draw 1k text labels", &textBenchmarkEnabled);
+	if (ImGui::Checkbox("Text run cache", &textRunCache))
+		textFont->setRunCacheEnabled(textRunCache);
+	unsigned int runLookups = textFont->getRunHits() + textFont->getRunMisses();
+	ImGui::Text("CPU text: %.3f ms (%.1f%% run cache hits)", textBenchmarkTime,
+				runLookups > 0 ? textFont->getRunHits() * 100.0f / runLookups : 0.0f);
+	textFont->resetRunStats();
+
+	ImGui::Checkbox("Draw 100k sprites", &spriteBenchmarkEnabled);
+	if (ImGui::Checkbox("Sort sprites", &spriteSorting))
+		renderer2D->setSortingEnabled(spriteSorting);
+	if (ImGui::Checkbox("Batch sprites by texture", &spriteTextureSorting))
+		renderer2D->setTextureSortingEnabled(spriteTextureSorting);
+	if (ImGui::Checkbox("Instanced sprites", &spriteInstancing))
+		renderer2D->setInstancingEnabled(spriteInstancing);
+	ImGui::Checkbox("Record sprites on threads", &spriteThreads);
+	ImGui::Checkbox("Textured sprites", &spriteTextured);
+
+	// a scrolling world much larger than the screen, drawn through its grid or all submitted to be culled
+	ImGui::Checkbox("Draw 200k sprite world", &worldBenchmarkEnabled);
+	ImGui::Checkbox("World spatial grid", &worldGridEnabled);
+	if (ImGui::Checkbox("Cull sprites", &spriteCulling))
+		renderer2D->setCullingEnabled(spriteCulling);
+	ImGui::Text("CPU world: %.3f ms (%u visited, %u culled, %u draw calls)", worldBenchmarkTime,
+				worldVisitedCount, worldCulledCount, worldDrawCalls);
+	ImGui::Checkbox("Draw 1024x1024 tile map", &tileBenchmarkEnabled);
+	ImGui::Text("CPU tiles: %.3f ms (%u draw calls, %u chunks rebuilt)", tileBenchmarkTime, tileDrawCalls, tileRebuilds);
+	ImGui::Text("CPU sprites: %.3f ms (%u draw calls, %u texture switches, %.1f MB uploaded)", spriteBenchmarkTime,
+				spriteBenchmarkDrawCalls, spriteBenchmarkTextureSwitches, spriteBenchmarkUploadedSize / (1024.0f * 1024.0f));
+
+	// compressed against what the same textures took as rgba, the first run also compresses and caches them
+	unsigned int textureBytes = 0, uncompressedBytes = 0;
+	for (size_t i = 0; i < statuette.mesh.getMaterialCount(); ++i)
+	{
+		const OBJMesh::Material& material = statuette.mesh.getMaterial(i);
+		const Texture* textures[] = { &material.diffuseTexture, &material.alphaTexture, &material.ambientTexture,
+			&material.specularTexture, &material.specularHighlightTexture, &material.normalTexture, &material.displacementTexture };
+		for (const Texture* texture : textures)
+		{
+			textureBytes += texture->getMemorySize();
+			if (texture->getHandle() > 0)
+				uncompressedBytes += texture->getWidth() * texture->getHeight() * 4 * 4 / 3;
+		}
+	}
+	ImGui::Text("Statuette textures: %.1f MB (%.1f MB uncompressed), loaded in %.1f ms",
+				textureBytes / (1024.0f * 1024.0f), uncompressedBytes / (1024.0f * 1024.0f), statuetteLoadTime);
+
+	// resident streamed texture memory against the budget
+	ImGui::Text("Streamed textures: %.1f / %.1f MB (%u loading, %u over budget)",
+				textureStreamer.getResidentSize() / (1024.0f * 1024.0f), textureStreamer.getBudget() / (1024.0f * 1024.0f),
+				textureStreamer.getPendingCount(), textureStreamer.getStarvedCount());
+
+	// images loaded through Texture::load(), spread over frames within the uploader's budget
+	aie::TextureUploader* uploader = aie::TextureUploader::getInstance();
+	ImGui::Text("Texture uploads: %u loading, %u failed (%.1f MB this frame, %u stalls)",
+				uploader->getPendingCount(), uploader->getFailedCount(), uploader->getUploadedSize() / (1024.0f * 1024.0f),
+				uploader->getStagingBuffer()->getStallCount());
+
+	// fewer lights compiles a new permutation rather than looping over unused ones
+	ImGui::SliderInt("Point lights", &pointLightCount, 0, LightsBlock::POINT_LIGHTS_COUNT);
+	ImGui::Text("Shader permutations: %u", (unsigned int)(normalShaders.getCount() + postShaders.getCount()));
+
+	// binds from the previous frame
+	ImGui::Text("Vertex array binds: %u", OBJMesh::getVertexArrayBindCount());
+	OBJMesh::resetVertexArrayBindCount();
+
+	// uniform uploads from the previous frame, each was a location lookup and an upload before shadowing
+	ImGui::Text("Uniform uploads: %u (%u unchanged skipped)",
+				ShaderProgram::getUniformUploadCount(), ShaderProgram::getUniformSkipCount());
+	ShaderProgram::resetUniformStats();
+
+	// mesh pool usage
+	const RangeAllocator& vertexSpace = meshPool.getVertexSpace();
+	const RangeAllocator& indexSpace = meshPool.getIndexSpace();
+	ImGui::Text("Pool vertices: %u / %u (%.1f%% fragmented, %u free blocks)",
+				vertexSpace.getUsed(), vertexSpace.getCapacity(),
+				vertexSpace.getFragmentation() * 100, vertexSpace.getFreeBlockCount());
+	ImGui::Text("Pool indices: %u / %u (%.1f%% fragmented, %u free blocks)",
+				indexSpace.getUsed(), indexSpace.getCapacity(),
+				indexSpace.getFragmentation() * 100, indexSpace.getFreeBlockCount());
+	if (ImGui::Button("Defragment pool"))
+		meshPool.defragment();
+
+	// stalls from the previous frame's uploads
+	RingBuffer* gizmoStream = Gizmos::getStreamBuffer();
+	ImGui::Text("Gizmo upload stalls: %u (%.3f ms)", gizmoStream->getStallCount(), gizmoStream->getStallTime());
+	ImGui::Text("Scene upload stalls: %u (%.3f ms)", streamBuffer->getStallCount(), streamBuffer->getStallTime());
+	gizmoStream->resetStats();
+	streamBuffer->resetStats();
+	ImGui::End();
 }
 
 void GraphicsApp::draw()
@@ -161,131 +335,72 @@ void GraphicsApp::draw()
 	// wipe the screen to the background colour
 	clearScreen();
 
-	// bind phong shader program
-	phongShader.bind();
+	// camera and lights for every program this frame
+	UploadFrameBlocks();
 
-	// indicate the light type to the shader
-	phongShader.bindUniform("lightType", standardLight.GetLightType());
+	// draw with the fallback until the scene's shaders are ready
+	ShaderProgram& phong = phongShader.isReady() ? phongShader : fallbackShader;
+	ShaderProgram& spearShader = normalShaders.get(NormalMapDefines(spear.mesh));
+	ShaderProgram& statuetteShader = normalShaders.get(NormalMapDefines(statuette.mesh));
+	ShaderProgram& spearNormal = spearShader.isReady() ? spearShader : fallbackShader;
+	ShaderProgram& statuetteNormal = statuetteShader.isReady() ? statuetteShader : fallbackShader;
 
-	// send light's position to shader as uniform
-	phongShader.bindUniform("lightPosition", standardLight.position);
+	if (sceneIndirect && indirectShader.isReady())
+	{
+		// the phong shaded objects in one call, their transforms and materials streamed with it
+		indirectShader.bind();
+		sceneBatch.clear();
+		dragon.Draw(sceneBatch);
+		sceneBatch.draw();
+	}
+	else
+	{
+		// bind phong shader program
+		phong.bind();
 
-	// send camera's position to shader as uniform
-	phongShader.bindUniform("cameraPosition", flyCam.GetPosition());
+		// bind transform
+		phong.bindUniform("ProjectionViewModel", dragon.GetProjectionViewMatrix(&flyCam));
 
-	// bind light
-	phongShader.bindUniform("Ia", standardLight.ambient);
-	phongShader.bindUniform("Id", standardLight.diffuse);
-	phongShader.bindUniform("Is", standardLight.specular);
-	phongShader.bindUniform("ambientStrength", standardLight.ambientStrength);
-	phongShader.bindUniform("specularStrength", standardLight.specularStrength);
-	phongShader.bindUniform("specularPower", standardLight.specularPower);
+		// bind transforms for lighting
+		phong.bindUniform("ModelMatrix", dragon.transform);
+		phong.bindUniform("NormalMatrix", inverseTranspose(mat3(dragon.transform)));
 
-	// bind transform
-	phongShader.bindUniform("ProjectionViewModel", dragon.GetProjectionViewMatrix(&flyCam));
+		// draw the dragon
+		dragon.Draw();
+	}
 
-	// bind transforms for lighting
-	phongShader.bindUniform("ModelMatrix", dragon.transform);
-	phongShader.bindUniform("NormalMatrix", inverseTranspose(mat3(dragon.transform)));
-
-	// draw the dragon
-	dragon.Draw();
-
-	// bind normal map shader program
-	normalShader.bind();
-
-	// send camera's position to shader as uniform
-	normalShader.bindUniform("cameraPosition", flyCam.GetPosition());
-
-	// bind directional light's variables
-	normalShader.bindUniform("dirLights[0].ambient", directionalLight.ambient);
-	normalShader.bindUniform("dirLights[0].diffuse", directionalLight.diffuse);
-	normalShader.bindUniform("dirLights[0].specular", directionalLight.specular);
-	normalShader.bindUniform("dirLights[0].ambientStrength", directionalLight.ambientStrength);
-	normalShader.bindUniform("dirLights[0].diffuseStrength", directionalLight.diffuseStrength);
-	normalShader.bindUniform("dirLights[0].specularStrength", directionalLight.specularStrength);
-	normalShader.bindUniform("dirLights[0].specularPower", directionalLight.specularPower);
-	normalShader.bindUniform("dirLights[0].direction", directionalLight.direction);
-
-	// send point light's position to shader as uniform
-	normalShader.bindUniform("pointLights[0].position", pointLight1.position);
-
-	// bind point light's variables
-	normalShader.bindUniform("pointLights[0].ambient", pointLight1.ambient);
-	normalShader.bindUniform("pointLights[0].diffuse", pointLight1.diffuse);
-	normalShader.bindUniform("pointLights[0].specular", pointLight1.specular);
-	normalShader.bindUniform("pointLights[0].ambientStrength", pointLight1.ambientStrength);
-	normalShader.bindUniform("pointLights[0].diffuseStrength", pointLight1.diffuseStrength);
-	normalShader.bindUniform("pointLights[0].specularStrength", pointLight1.specularStrength);
-	normalShader.bindUniform("pointLights[0].specularPower", pointLight1.specularPower);
-	normalShader.bindUniform("pointLights[0].constant", pointLight1.constant);
-	normalShader.bindUniform("pointLights[0].linear", pointLight1.linear);
-	normalShader.bindUniform("pointLights[0].quadratic", pointLight1.quadratic);
-
-	// send point light's position to shader as uniform
-	normalShader.bindUniform("pointLights[1].position", pointLight2.position);
-
-	// bind point light's variables
-	normalShader.bindUniform("pointLights[1].ambient", pointLight2.ambient);
-	normalShader.bindUniform("pointLights[1].diffuse", pointLight2.diffuse);
-	normalShader.bindUniform("pointLights[1].specular", pointLight2.specular);
-	normalShader.bindUniform("pointLights[1].ambientStrength", pointLight2.ambientStrength);
-	normalShader.bindUniform("pointLights[1].diffuseStrength", pointLight2.diffuseStrength);
-	normalShader.bindUniform("pointLights[1].specularStrength", pointLight2.specularStrength);
-	normalShader.bindUniform("pointLights[1].specularPower", pointLight2.specularPower);
-	normalShader.bindUniform("pointLights[1].constant", pointLight2.constant);
-	normalShader.bindUniform("pointLights[1].linear", pointLight2.linear);
-	normalShader.bindUniform("pointLights[1].quadratic", pointLight2.quadratic);
-
-	// send point light's position to shader as uniform
-	normalShader.bindUniform("pointLights[2].position", pointLight3.position);
-
-	// bind point light's variables
-	normalShader.bindUniform("pointLights[2].ambient", pointLight3.ambient);
-	normalShader.bindUniform("pointLights[2].diffuse", pointLight3.diffuse);
-	normalShader.bindUniform("pointLights[2].specular", pointLight3.specular);
-	normalShader.bindUniform("pointLights[2].ambientStrength", pointLight3.ambientStrength);
-	normalShader.bindUniform("pointLights[2].diffuseStrength", pointLight3.diffuseStrength);
-	normalShader.bindUniform("pointLights[2].specularStrength", pointLight3.specularStrength);
-	normalShader.bindUniform("pointLights[2].specularPower", pointLight3.specularPower);
-	normalShader.bindUniform("pointLights[2].constant", pointLight3.constant);
-	normalShader.bindUniform("pointLights[2].linear", pointLight3.linear);
-	normalShader.bindUniform("pointLights[2].quadratic", pointLight3.quadratic);
-
-	// send point light's position to shader as uniform
-	normalShader.bindUniform("pointLights[3].position", pointLight4.position);
-
-	// bind point light's variables
-	normalShader.bindUniform("pointLights[3].ambient", pointLight4.ambient);
-	normalShader.bindUniform("pointLights[3].diffuse", pointLight4.diffuse);
-	normalShader.bindUniform("pointLights[3].specular", pointLight4.specular);
-	normalShader.bindUniform("pointLights[3].ambientStrength", pointLight4.ambientStrength);
-	normalShader.bindUniform("pointLights[3].diffuseStrength", pointLight4.diffuseStrength);
-	normalShader.bindUniform("pointLights[3].specularStrength", pointLight4.specularStrength);
-	normalShader.bindUniform("pointLights[3].specularPower", pointLight4.specularPower);
-	normalShader.bindUniform("pointLights[3].constant", pointLight4.constant);
-	normalShader.bindUniform("pointLights[3].linear", pointLight4.linear);
-	normalShader.bindUniform("pointLights[3].quadratic", pointLight4.quadratic);
+	// bind the spear's normal map shader program
+	spearNormal.bind();
 
 	// bind transform
-	normalShader.bindUniform("ProjectionViewModel", spear.GetProjectionViewMatrix(&flyCam));
+	spearNormal.bindUniform("ProjectionViewModel", spear.GetProjectionViewMatrix(&flyCam));
 
 	// bind transforms for lighting
-	normalShader.bindUniform("ModelMatrix", spear.transform);
-	normalShader.bindUniform("NormalMatrix", inverseTranspose(mat3(spear.transform)));
+	spearNormal.bindUniform("ModelMatrix", spear.transform);
+	spearNormal.bindUniform("NormalMatrix", inverseTranspose(mat3(spear.transform)));
 
 	// draw the spear
 	spear.Draw();
 
+	// bind the statuette's normal map shader program, the same one if their textures match
+	statuetteNormal.bind();
+
 	// bind transform
-	normalShader.bindUniform("ProjectionViewModel", statuette.GetProjectionViewMatrix(&flyCam));
+	statuetteNormal.bindUniform("ProjectionViewModel", statuette.GetProjectionViewMatrix(&flyCam));
 
 	// bind transforms for lighting
-	normalShader.bindUniform("ModelMatrix", statuette.transform);
-	normalShader.bindUniform("NormalMatrix", inverseTranspose(mat3(statuette.transform)));
+	statuetteNormal.bindUniform("ModelMatrix", statuette.transform);
+	statuetteNormal.bindUniform("NormalMatrix", inverseTranspose(mat3(statuette.transform)));
 
 	// draw the spear
 	statuette.Draw();
+
+	if (benchmarkEnabled &&
+		(benchmarkIndirect ? indirectShader.isReady() : phongShader.isReady()))
+		DrawBenchmark();
+
+	// guard the frame's uniform blocks until the scene has finished with them
+	streamBuffer->fence();
 	
 	// unbind target to return to backbuffer
 	fullScreenRenderTarget.unbind();
@@ -293,14 +408,27 @@ void GraphicsApp::draw()
 	// clear the backbuffer
 	clearScreen();
 
-	// bind post shader and textures
-	postShader.bind();
-	postShader.bindUniform("postEffect", postIndex); // 0: default, 1: blur, 2: distort, 3: sobel
-	postShader.bindUniform("colourTarget", 0);
-	fullScreenRenderTarget.getTarget(0).bind(0);
+	// 0: default, 1: blur, 2: distort, 3: sobel
+	ShaderProgram& postShader = postShaders.get({ { "POST_EFFECT", postIndex } });
+	if (postShader.isReady())
+	{
+		// bind post shader and textures
+		postShader.bind();
+		postShader.bindUniform("colourTarget", 0);
+		fullScreenRenderTarget.getTarget(0).bind(0);
 
-	// draw the full screen quad
-	fullScreenQuadMesh.Draw();
+		// draw the full screen quad
+		fullScreenQuadMesh.Draw();
+	}
+	else
+	{
+		// copy the scene across untouched until the post shader is ready
+		unsigned int width = fullScreenRenderTarget.getWidth();
+		unsigned int height = fullScreenRenderTarget.getHeight();
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, fullScreenRenderTarget.getFrameBufferHandle());
+		glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	}
 
 	// draw the lights
 	standardLight.Draw();
@@ -310,4 +438,334 @@ void GraphicsApp::draw()
 	pointLight4.Draw();
 
 	Gizmos::draw(flyCam.GetProjectionViewTransform());
+
+	if (spriteBenchmarkEnabled)
+		DrawSpriteBenchmark();
+
+	if (worldBenchmarkEnabled)
+		DrawWorldBenchmark();
+
+	if (tileBenchmarkEnabled)
+		DrawTileBenchmark();
+
+	if (textBenchmarkEnabled)
+		DrawTextBenchmark();
+}
+
+void GraphicsApp::CheckShader(ShaderProgram& shader, const char* name)
+{
+	if (shader.isReady() == false && shader.hasFailed())
+	{
+		cout << name << " shader link error: " << shader.getLastError() << endl;
+		quit();
+	}
+}
+
+void GraphicsApp::CheckShader(ShaderPermutations& shaders, const char* name)
+{
+	ShaderProgram* failed = shaders.getFailed();
+	if (failed != nullptr)
+	{
+		cout << name << " shader link error: " << failed->getLastError() << endl;
+		quit();
+	}
+}
+
+ShaderDefines GraphicsApp::NormalMapDefines(const OBJMesh& mesh)
+{
+	// only leave a texture out if no material has one, the others sample the unbound texture as before
+	bool hasSpecular = false, hasNormal = false;
+	for (size_t i = 0; i < mesh.getMaterialCount(); ++i)
+	{
+		const OBJMesh::Material& material = mesh.getMaterial(i);
+		hasSpecular |= material.specularTexture.getHandle() > 0;
+		hasNormal |= material.normalTexture.getHandle() > 0;
+	}
+
+	ShaderDefines defines;
+	defines["DIR_LIGHTS_COUNT"] = LightsBlock::DIR_LIGHTS_COUNT;
+	defines["POINT_LIGHTS_COUNT"] = pointLightCount;
+	defines["HAS_SPECULAR_TEXTURE"] = hasSpecular ? 1 : 0;
+	defines["HAS_NORMAL_TEXTURE"] = hasNormal ? 1 : 0;
+	return defines;
+}
+
+void GraphicsApp::UploadFrameBlocks()
+{
+	unsigned int cameraOffset = 0, lightsOffset = 0;
+	CameraBlock* camera = (CameraBlock*)streamBuffer->allocate(sizeof(CameraBlock), uniformBufferAlignment, cameraOffset);
+	LightsBlock* lights = (LightsBlock*)streamBuffer->allocate(sizeof(LightsBlock), uniformBufferAlignment, lightsOffset);
+
+	// write straight in to the mapping, one upload for the whole frame
+	camera->projectionView = flyCam.GetProjectionViewTransform();
+	camera->cameraPosition = flyCam.GetPosition();
+	camera->padding = 0;
+
+	standardLight.FillBlock(lights->sceneLight);
+	directionalLight.FillBlock(lights->dirLights[0]);
+	pointLight1.FillBlock(lights->pointLights[0]);
+	pointLight2.FillBlock(lights->pointLights[1]);
+	pointLight3.FillBlock(lights->pointLights[2]);
+	pointLight4.FillBlock(lights->pointLights[3]);
+
+	glBindBufferRange(GL_UNIFORM_BUFFER, CAMERA_BLOCK, streamBuffer->getHandle(), cameraOffset, sizeof(CameraBlock));
+	glBindBufferRange(GL_UNIFORM_BUFFER, LIGHTS_BLOCK, streamBuffer->getHandle(), lightsOffset, sizeof(LightsBlock));
 }
+
+void GraphicsApp::DrawBenchmark()
+{
+	auto start = chrono::high_resolution_clock::now();
+
+	mat4 projectionView = flyCam.GetProjectionViewTransform();
+
+	if (benchmarkIndirect)
+	{
+		indirectShader.bind();
+
+		// rebuilt every frame so moving objects cost the same as static ones
+		benchmarkBatch.clear();
+		for (unsigned int i = 0; i < benchmarkCount; ++i)
+			benchmarkBatch.add(i % 2 == 0 ? spear.mesh : statuette.mesh, benchmarkTransforms[i]);
+		benchmarkBatch.draw();
+	}
+	else
+	{
+		phongShader.bind();
+
+		// looked up once the shader has finished linking
+		if (benchmarkModelMatrix.isValid() == false)
+		{
+			benchmarkProjectionViewModel = phongShader.getUniformHandle<mat4>("ProjectionViewModel");
+			benchmarkModelMatrix = phongShader.getUniformHandle<mat4>("ModelMatrix");
+			benchmarkNormalMatrix = phongShader.getUniformHandle<mat3>("NormalMatrix");
+		}
+
+		// alternate meshes so that unpooled meshes have to switch vertex arrays every draw
+		OBJMesh* meshes[2] = { &spear.mesh, &statuette.mesh };
+		if (benchmarkPooled == false)
+		{
+			meshes[0] = &unpooledMeshes[0];
+			meshes[1] = &unpooledMeshes[1];
+		}
+
+		for (unsigned int i = 0; i < benchmarkCount; ++i)
+		{
+			mat4& transform = benchmarkTransforms[i];
+			phongShader.bindUniform(benchmarkProjectionViewModel, projectionView * transform);
+			phongShader.bindUniform(benchmarkModelMatrix, transform);
+			phongShader.bindUniform(benchmarkNormalMatrix, inverseTranspose(mat3(transform)));
+			meshes[i % 2]->draw();
+		}
+	}
+
+	auto end = chrono::high_resolution_clock::now();
+
+	// smooth the timing so that it can be read
+	float milliseconds = chrono::duration<float, milli>(end - start).count();
+	benchmarkSubmitTime = benchmarkSubmitTime * 0.9f + milliseconds * 0.1f;
+}
+
+void GraphicsApp::DrawTextBenchmark()
+{
+	auto start = chrono::high_resolution_clock::now();
+
+	renderer2D->begin();
+
+	// a grid of labels that never change, at least one column wide however narrow the window
+	float width = (float)getWindowWidth();
+	float height = (float)getWindowHeight();
+	unsigned int columns = std::max((unsigned int)(width / 100.0f), 1u);
+	for (unsigned int i = 0; i < textLabels.size(); ++i)
+	{
+		float x = (i % columns) * 100.0f + 10.0f;
+		float y = height - (i / columns) * 20.0f - 20.0f;
+		renderer2D->drawText(textFont, textLabels[i].c_str(), x, y);
+	}
+
+	// and a few that change every frame, as counters would
+	char counter[64];
+	for (unsigned int i = 0; i < 4; ++i)
+	{
+		sprintf_s(counter, "Frame time %.4f ms", textBenchmarkTime + i);
+		renderer2D->drawText(textFont, counter, 10.0f, 20.0f + i * 20.0f);
+	}
+
+	renderer2D->end();
+
+	textBenchmarkTime = chrono::duration<float, milli>(chrono::high_resolution_clock::now() - start).count();
+}
+
+void GraphicsApp::DrawSpriteBenchmark()
+{
+	auto start = chrono::high_resolution_clock::now();
+
+	renderer2D->begin();
+
+	// each sprite circles its own point so that every vertex changes every frame
+	float width = (float)getWindowWidth();
+	float height = (float)getWindowHeight();
+	float time = getTime();
+	auto record = [=](SpriteRecorder& recorder, unsigned int first, unsigned int last)
+	{
+		for (unsigned int i = first; i < last; ++i)
+		{
+			float x = (i * 7919 % 1000) / 1000.0f * width;
+			float y = (i * 104729 % 1000) / 1000.0f * height;
+			float angle = time + i * 0.1f;
+			recorder.setRenderColour((i * 2654435761u) | 0xff);
+			if (spriteTextured && (i & 1) != 0)
+				recorder.drawSprite(&spriteTextures[i % spriteTextures.size()], x + cosf(angle) * 20.0f, y + sinf(angle) * 20.0f,
+									8.0f, 8.0f, angle);
+			else
+				recorder.drawBox(x + cosf(angle) * 20.0f, y + sinf(angle) * 20.0f, 4.0f, 4.0f, angle);
+		}
+	};
+
+	if (spriteThreads)
+	{
+		// each thread records a slice in to its own recorder, submitted in slice order once they finish
+		unsigned int threadCount = (unsigned int)spriteRecorders.size();
+		vector<thread> threads;
+		for (unsigned int t = 0; t < threadCount; ++t)
+		{
+			spriteRecorders[t].clear();
+			threads.emplace_back(record, ref(spriteRecorders[t]),
+								 spriteBenchmarkCount * t / threadCount, spriteBenchmarkCount * (t + 1) / threadCount);
+		}
+		for (unsigned int t = 0; t < threadCount; ++t)
+		{
+			threads[t].join();
+			renderer2D->submit(spriteRecorders[t]);
+		}
+	}
+	else
+	{
+		record(*renderer2D, 0, spriteBenchmarkCount);
+	}
+
+	renderer2D->end();
+	renderer2D->setRenderColour(1, 1, 1, 1);
+
+	spriteBenchmarkDrawCalls = renderer2D->getDrawCallCount();
+	spriteBenchmarkTextureSwitches = renderer2D->getTextureSwitchCount();
+	spriteBenchmarkUploadedSize = renderer2D->getUploadedSize();
+	spriteBenchmarkTime = chrono::duration<float, milli>(chrono::high_resolution_clock::now() - start).count();
+}
+
+void GraphicsApp::DrawWorldBenchmark()
+{
+	// scattered over a square 100 screens across, recorded the first time the world is drawn
+	const float worldSize = 40000.0f;
+	if (worldGrid == nullptr)
+	{
+		worldGrid = new SpriteGrid();
+		for (unsigned int i = 0; i < worldBenchmarkCount; ++i)
+		{
+			float x = (i * 7919u % 40009u) / 40009.0f * worldSize;
+			float y = (i * 104729u % 39989u) / 39989.0f * worldSize;
+			worldGrid->setRenderColour((i * 2654435761u) | 0xff);
+			worldGrid->drawBox(x, y, 16.0f, 16.0f, i * 0.1f);
+		}
+	}
+
+	auto start = chrono::high_resolution_clock::now();
+
+	// pan diagonally across the world
+	float pan = fmodf(getTime() * 500.0f, worldSize);
+	renderer2D->setCameraPos(pan, pan);
+	renderer2D->begin();
+
+	if (worldGridEnabled)
+		renderer2D->drawGrid(*worldGrid);
+	else
+		renderer2D->submit(*worldGrid);
+
+	renderer2D->end();
+	renderer2D->setCameraPos(0, 0);
+
+	worldVisitedCount = renderer2D->getVisitedCount();
+	worldCulledCount = renderer2D->getCulledCount();
+	worldDrawCalls = renderer2D->getDrawCallCount();
+	worldBenchmarkTime = chrono::duration<float, milli>(chrono::high_resolution_clock::now() - start).count();
+}
+
+void GraphicsApp::DrawTileBenchmark()
+{
+	// four flat coloured 16 pixel tiles side by side, and a layer of them made the first time it is drawn
+	if (tileLayer == nullptr)
+	{
+		unsigned char pixels[64 * 16 * 4];
+		const unsigned int colours[4] = { 0x3c8c3cff, 0x2850b4ff, 0xc8b478ff, 0x6e6e6eff };
+		for (unsigned int i = 0; i < 64 * 16; ++i)
+		{
+			unsigned int colour = colours[(i % 64) / 16];
+			pixels[i * 4 + 0] = (unsigned char)(colour >> 24);
+			pixels[i * 4 + 1] = (unsigned char)(colour >> 16);
+			pixels[i * 4 + 2] = (unsigned char)(colour >> 8);
+			pixels[i * 4 + 3] = (unsigned char)colour;
+		}
+		tileset = new Texture(64, 16, Texture::RGBA, pixels);
+
+		tileLayer = new TileLayer(tileset, 16, tileBenchmarkSize, tileBenchmarkSize, 16.0f);
+		tileLayer->setDepth(50.0f);
+
+		// the map is generated from a herringbone wang tileset, made from a template with the
+		// inside of each wang tile painted in diagonal stripes of the tile colours
+		unsigned int palette[4];
+		for (unsigned int i = 0; i < 4; ++i)
+			palette[i] = colours[i] >> 8;
+
+		vector<unsigned char> wangTileset;
+		unsigned int wangWidth = 0, wangHeight = 0;
+		bool generated = false;
+		if (TileLayer::makeWangTemplate(16, wangTileset, wangWidth, wangHeight))
+		{
+			for (unsigned int y = 1; y < wangHeight; ++y)
+			{
+				for (unsigned int x = 0; x < wangWidth; ++x)
+				{
+					unsigned char* pixel = &wangTileset[(y * wangWidth + x) * 3];
+					if (pixel[0] != 255 || pixel[1] != 255 || pixel[2] != 255)
+						continue;
+					unsigned int colour = palette[(x * 7 + y * 13) / 24 % 4];
+					pixel[0] = (unsigned char)(colour >> 16);
+					pixel[1] = (unsigned char)(colour >> 8);
+					pixel[2] = (unsigned char)colour;
+				}
+			}
+			generated = tileLayer->generate(wangTileset.data(), wangWidth, wangHeight, palette, 4, 1);
+		}
+
+		if (generated == false)
+		{
+			cout << "Tile map generation failed, filling with a pattern instead" << endl;
+			for (unsigned int y = 0; y < tileBenchmarkSize; ++y)
+				for (unsigned int x = 0; x < tileBenchmarkSize; ++x)
+					tileLayer->setTile(x, y, (x * 7 + y * 13) / 64 % 4);
+		}
+	}
+
+	// the layer sways from side to side, which is applied when drawing without rebuilding anything
+	tileLayer->setPosition(sinf(getTime()) * 32.0f, 0);
+
+	// one tile changes each frame, which should only rebuild the chunk it is in
+	unsigned int frame = (unsigned int)(getTime() * 60.0f);
+	unsigned int x = frame * 7919u % tileBenchmarkSize, y = frame * 104729u % tileBenchmarkSize;
+	tileLayer->setTile(x, y, (tileLayer->getTile(x, y) + 1) % 4);
+
+	auto start = chrono::high_resolution_clock::now();
+	unsigned int rebuilds = tileLayer->getRebuildCount();
+
+	// pan diagonally across the map
+	float mapSize = tileBenchmarkSize * tileLayer->getTileWorldSize();
+	float pan = fmodf(getTime() * 500.0f, mapSize);
+	renderer2D->setCameraPos(pan, pan);
+	renderer2D->begin();
+	renderer2D->drawTileLayer(*tileLayer);
+	renderer2D->end();
+	renderer2D->setCameraPos(0, 0);
+
+	tileDrawCalls = renderer2D->getDrawCallCount();
+	tileRebuilds = tileLayer->getRebuildCount() - rebuilds;
+	tileBenchmarkTime = chrono::duration<float, milli>(chrono::high_resolution_clock::now() - start).count();
+}
\ No newline at end of file
@@ -1,14 +1,25 @@
 #pragma once
 #include "FlyCamera.h"
+#include "IndirectBatch.h"
 #include "Mesh.h"
+#include "MeshPool.h"
 #include "RenderObject.h"
 #include "RenderTarget.h"
+#include "RingBuffer.h"
 #include "Shader.h"
 #include "DirectionalLight.h"
 #include "PointLight.h"
 #include "SpotLight.h"
 #include <Application.h>
+#include <Font.h>
+#include <Renderer2D.h>
+#include <SpriteGrid.h>
+#include <Texture.h>
+#include <TextureStreamer.h>
+#include <TileLayer.h>
 #include <glm/mat4x4.hpp>
+#include <string>
+#include <vector>
 
 class GraphicsApp : public aie::Application
 {
@@ -30,8 +41,19 @@ protected:
 
 	// shaders
 	ShaderProgram phongShader;
-	ShaderProgram normalShader;
-	ShaderProgram postShader;
+	ShaderPermutations normalShaders;
+	ShaderPermutations postShaders;
+	ShaderProgram indirectShader;
+
+	// drawn with while the other shaders are still compiling
+	ShaderProgram fallbackShader;
+
+	// quits with the error if the shader failed to link
+	void CheckShader(ShaderProgram& shader, const char* name);
+	void CheckShader(ShaderPermutations& shaders, const char* name);
+
+	// picks the normal map permutation for the mesh's textures and the lights in use
+	ShaderDefines NormalMapDefines(const OBJMesh& mesh);
 
 	// lights
 	Light standardLight;
@@ -41,12 +63,37 @@ protected:
 	PointLight pointLight3;
 	PointLight pointLight4;
 
+	// point lights the normal map shaders light with, from the first
+	int pointLightCount = LightsBlock::POINT_LIGHTS_COUNT;
+
+	// shared geometry for the render objects, declared first so that it outlives them
+	MeshPool meshPool;
+
+	// streams the render objects' texture mips within a budget, also outliving them
+	TextureStreamer textureStreamer{ 64 * 1024 * 1024 };
+
 	// render objects
 	RenderObject angel;
 	RenderObject dragon;
 	RenderObject spear;
 	RenderObject statuette;
 
+	// the render objects shaded with plain phong, drawn together with one multi-draw-indirect call.
+	// normal mapped objects bind their own textures, so they are still drawn one at a time
+	IndirectBatch sceneBatch;
+	bool sceneIndirect = true;
+
+	// time taken to load the statuette and its textures at startup
+	float statuetteLoadTime = 0;
+
+	// streams per-frame draw data, sized for three frames of the benchmark
+	RingBuffer* streamBuffer = nullptr;
+
+	// writes the camera and lights uniform blocks in to the stream and binds them for every program
+	void UploadFrameBlocks();
+
+	unsigned int uniformBufferAlignment = 256;
+
 	// render targets
 	RenderTarget fullScreenRenderTarget;
 
@@ -55,4 +102,80 @@ protected:
 
 	// post processing effect index
 	int postIndex = 3;
+
+	// submission benchmark, draws a grid of alternating spears and statuettes
+	// either one draw at a time or as one indirect batch
+	void DrawBenchmark();
+
+	static const unsigned int benchmarkCount = 10000;
+	bool benchmarkEnabled = false;
+	bool benchmarkIndirect = true;
+	bool benchmarkPooled = true;
+	OBJMesh unpooledMeshes[2];
+	std::vector<mat4> benchmarkTransforms;
+	IndirectBatch benchmarkBatch;
+	float benchmarkSubmitTime = 0;
+
+	// per-object uniforms for the benchmark, looked up once the shader has linked
+	UniformHandle<mat4> benchmarkProjectionViewModel;
+	UniformHandle<mat4> benchmarkModelMatrix;
+	UniformHandle<mat3> benchmarkNormalMatrix;
+
+	// text benchmark, covers the screen in static labels with a few that change every frame
+	void DrawTextBenchmark();
+
+	Renderer2D* renderer2D = nullptr;
+	Font* textFont = nullptr;
+	std::vector<std::string> textLabels;
+	bool textBenchmarkEnabled = false;
+	bool textRunCache = true;
+	float textBenchmarkTime = 0;
+
+	// sprite storm, a screen full of small boxes drifting about, for batch capacity and flushing
+	void DrawSpriteBenchmark();
+
+	static const unsigned int spriteBenchmarkCount = 100000;
+	bool spriteBenchmarkEnabled = false;
+	float spriteBenchmarkTime = 0;
+	unsigned int spriteBenchmarkDrawCalls = 0;
+	unsigned int spriteBenchmarkTextureSwitches = 0;
+	unsigned int spriteBenchmarkUploadedSize = 0;
+	bool spriteSorting = true;
+
+	// the storm's sprites all share a depth and overlap, so grouping them by texture reorders them
+	bool spriteTextureSorting = false;
+	bool spriteInstancing = true;
+
+	// half the storm drawn with these instead of boxes, loaded asynchronously at startup
+	std::vector<Texture> spriteTextures;
+	bool spriteTextured = false;
+
+	// a recorder per hardware thread, for recording the storm in slices
+	std::vector<SpriteRecorder> spriteRecorders;
+	bool spriteThreads = false;
+
+	// a large world of static sprites, panned across so that only a little of it is in view
+	void DrawWorldBenchmark();
+
+	static const unsigned int worldBenchmarkCount = 200000;
+	SpriteGrid* worldGrid = nullptr;
+	bool worldBenchmarkEnabled = false;
+	bool worldGridEnabled = true;
+	bool spriteCulling = true;
+	float worldBenchmarkTime = 0;
+	unsigned int worldVisitedCount = 0;
+	unsigned int worldCulledCount = 0;
+	unsigned int worldDrawCalls = 0;
+
+	// a generated tile map far larger than the screen, drawn a chunk per draw call with a tile changed
+	// every frame and the whole layer swaying, which should only rebuild the changed tile's chunk
+	void DrawTileBenchmark();
+
+	static const unsigned int tileBenchmarkSize = 1024;
+	Texture* tileset = nullptr;
+	TileLayer* tileLayer = nullptr;
+	bool tileBenchmarkEnabled = false;
+	float tileBenchmarkTime = 0;
+	unsigned int tileDrawCalls = 0;
+	unsigned int tileRebuilds = 0;
 };
@@ -0,0 +1,180 @@
+#include "IndirectBatch.h"
+#include "GLState.h"
+#include "MeshPool.h"
+#include "OBJMesh.h"
+#include "RingBuffer.h"
+#include "gl_core_4_4.h"
+#include <glm/gtc/matrix_inverse.hpp>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+namespace aie {
+
+IndirectBatch::IndirectBatch()
+	: m_pool(nullptr),
+	m_streamBuffer(nullptr),
+	m_maxDraws(0),
+	m_storageAlignment(0),
+	m_materialsDirty(false) {
+}
+
+bool IndirectBatch::initialise(MeshPool* pool, RingBuffer* streamBuffer, unsigned int maxDraws) {
+	assert(m_vao == 0);
+	assert(pool != nullptr && pool->getVertexArray() != 0);
+	assert(streamBuffer != nullptr);
+
+	static_assert(sizeof(DrawCommand) == 20, "DrawCommand must match DrawElementsIndirectCommand");
+	static_assert(sizeof(DrawData) == 144, "DrawData must match the std430 DrawBuffer layout");
+	static_assert(sizeof(MaterialData) == 48, "MaterialData must match the std430 MaterialBuffer layout");
+
+	m_pool = pool;
+	m_streamBuffer = streamBuffer;
+	m_maxDraws = maxDraws;
+
+	// storage buffer ranges must start on this alignment
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &m_storageAlignment);
+
+	m_commands.reserve(maxDraws);
+	m_drawData.reserve(maxDraws);
+
+	// draw IDs are fetched once per instance starting at baseInstance,
+	// so each command's baseInstance selects its own ID
+	std::vector<unsigned int> drawIDs(maxDraws);
+	for (unsigned int i = 0; i < maxDraws; ++i)
+		drawIDs[i] = i;
+
+	glGenBuffers(1, m_drawIDBuffer.put());
+	glGenBuffers(1, m_materialBuffer.put());
+
+	// same vertex layout as the pool, plus the draw ID
+	glGenVertexArrays(1, m_vao.put());
+	GLState::bindVertexArray(m_vao);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pool->getIndexBuffer());
+	glBindBuffer(GL_ARRAY_BUFFER, pool->getVertexBuffer());
+
+	OBJMesh::Layout::apply();
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_drawIDBuffer);
+	glBufferData(GL_ARRAY_BUFFER, maxDraws * sizeof(unsigned int), drawIDs.data(), GL_STATIC_DRAW);
+	VertexLayout<unsigned int, VertexAttrib<4, unsigned int, 0>>::apply();
+	glVertexAttribDivisor(4, 1);
+
+	GLState::bindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	return true;
+}
+
+void IndirectBatch::clear() {
+	m_commands.clear();
+	m_drawData.clear();
+}
+
+bool IndirectBatch::add(const OBJMesh& mesh, const glm::mat4& transform) {
+	assert(m_vao != 0 && "Indirect batch not initialised");
+
+	if (mesh.getPool() != m_pool) {
+		printf("Mesh [%s] is not in the batch's mesh pool!\n", mesh.getFilename().c_str());
+		return false;
+	}
+	if (m_commands.size() + mesh.getChunkCount() > m_maxDraws)
+		return false;
+
+	int materialBase = registerMaterials(mesh);
+
+	DrawData data;
+	data.modelMatrix = transform;
+	data.normalMatrix = glm::mat4(glm::inverseTranspose(glm::mat3(transform)));
+	data.padding[0] = data.padding[1] = data.padding[2] = 0;
+
+	for (size_t i = 0; i < mesh.getChunkCount(); ++i) {
+		const OBJMesh::MeshChunk& chunk = mesh.getChunk(i);
+		const MeshPool::Range& range = m_pool->getRange(chunk.poolAllocation);
+
+		DrawCommand command;
+		command.count = range.indexCount;
+		command.instanceCount = 1;
+		command.firstIndex = range.firstIndex;
+		command.baseVertex = range.baseVertex;
+		command.baseInstance = (unsigned int)m_commands.size();
+		m_commands.push_back(command);
+
+		data.materialIndex = materialBase + (chunk.materialID < 0 ? 0 : chunk.materialID);
+		m_drawData.push_back(data);
+	}
+
+	return true;
+}
+
+void IndirectBatch::draw() {
+	if (m_commands.empty())
+		return;
+
+	if (m_materialsDirty) {
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_materialBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, m_materials.size() * sizeof(MaterialData), m_materials.data(), GL_STATIC_DRAW);
+		m_materialsDirty = false;
+	}
+
+	// write this frame's draws straight in to the ring
+	unsigned int drawDataSize = (unsigned int)(m_drawData.size() * sizeof(DrawData));
+	unsigned int commandSize = (unsigned int)(m_commands.size() * sizeof(DrawCommand));
+	unsigned int drawDataOffset = 0, commandOffset = 0;
+
+	void* drawData = m_streamBuffer->allocate(drawDataSize, m_storageAlignment, drawDataOffset);
+	memcpy(drawData, m_drawData.data(), drawDataSize);
+
+	void* commands = m_streamBuffer->allocate(commandSize, sizeof(unsigned int), commandOffset);
+	memcpy(commands, m_commands.data(), commandSize);
+
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, m_streamBuffer->getHandle(), drawDataOffset, drawDataSize);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_materialBuffer);
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_streamBuffer->getHandle());
+
+	GLState::bindVertexArray(m_vao);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(size_t)commandOffset, (GLsizei)m_commands.size(), 0);
+	GLState::bindVertexArray(0);
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	m_streamBuffer->fence();
+}
+
+int IndirectBatch::registerMaterials(const OBJMesh& mesh) {
+
+	for (size_t i = 0; i < m_materialOwners.size(); ++i)
+		if (m_materialOwners[i] == mesh.getID())
+			return m_materialBases[i];
+
+	int base = (int)m_materials.size();
+	m_materialOwners.push_back(mesh.getID());
+	m_materialBases.push_back(base);
+
+	// meshes without materials get a plain white one
+	if (mesh.getMaterialCount() == 0) {
+		MaterialData data;
+		data.Ka = glm::vec4(1);
+		data.Kd = glm::vec4(1);
+		data.Ks = glm::vec4(0, 0, 0, 1);
+		m_materials.push_back(data);
+	}
+
+	for (size_t i = 0; i < mesh.getMaterialCount(); ++i) {
+		const OBJMesh::Material& material = mesh.getMaterial(i);
+
+		MaterialData data;
+		data.Ka = glm::vec4(material.ambient, 1);
+		data.Kd = glm::vec4(material.diffuse, material.opacity);
+		data.Ks = glm::vec4(material.specular, material.specularPower);
+		m_materials.push_back(data);
+	}
+
+	m_materialsDirty = true;
+	return base;
+}
+
+} // namespace aie
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "GLHandle.h"
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+#include <vector>
+
+namespace aie {
+
+class MeshPool;
+class OBJMesh;
+class RingBuffer;
+
+// collects every chunk of pooled meshes that share a shader, and submits them
+// all with a single glMultiDrawElementsIndirect call.
+// per-draw transforms and material indices are streamed each frame through a ring
+// buffer as a shader storage buffer (binding 0) and materials live in a second one (binding 1). the draw index is fed to the
+// vertex shader through an instanced attribute at location 4, sourced by baseInstance
+class IndirectBatch {
+public:
+
+	IndirectBatch();
+
+	// meshes added to the batch must have been loaded in to this pool,
+	// and the ring should have room for a few frames of maxDraws
+	bool initialise(MeshPool* pool, RingBuffer* streamBuffer, unsigned int maxDraws);
+
+	// removes all queued draws, materials stay registered
+	void clear();
+
+	// queues every chunk of the mesh with the given transform
+	bool add(const OBJMesh& mesh, const glm::mat4& transform);
+
+	// streams the queued draws and submits them with one call, a shader must be bound
+	void draw();
+
+	unsigned int getDrawCount() const { return (unsigned int)m_commands.size(); }
+	unsigned int getMaxDraws() const { return m_maxDraws; }
+
+private:
+
+	// matches the layout glMultiDrawElementsIndirect reads
+	struct DrawCommand {
+		unsigned int	count;
+		unsigned int	instanceCount;
+		unsigned int	firstIndex;
+		int				baseVertex;
+		unsigned int	baseInstance;
+	};
+
+	// std430 layout, the normal matrix is stored as a mat4 to avoid mat3 padding rules
+	struct DrawData {
+		glm::mat4		modelMatrix;
+		glm::mat4		normalMatrix;
+		int				materialIndex;
+		int				padding[3];
+	};
+
+	// std430 layout, specular power is stored in Ks.w
+	struct MaterialData {
+		glm::vec4		Ka;
+		glm::vec4		Kd;
+		glm::vec4		Ks;
+	};
+
+	// returns the index of the mesh's first material in the material buffer,
+	// registered by the mesh's id so that moving the mesh doesn't lose them
+	int registerMaterials(const OBJMesh& mesh);
+
+	MeshPool*					m_pool;
+	RingBuffer*					m_streamBuffer;
+	unsigned int				m_maxDraws;
+	int							m_storageAlignment;
+
+	VertexArrayHandle			m_vao;
+	BufferHandle				m_drawIDBuffer;
+	BufferHandle				m_materialBuffer;
+
+	std::vector<DrawCommand>	m_commands;
+	std::vector<DrawData>		m_drawData;
+
+	std::vector<unsigned int>	m_materialOwners;
+	std::vector<int>			m_materialBases;
+	std::vector<MaterialData>	m_materials;
+	bool						m_materialsDirty;
+};
+
+} // namespace aie
@@ -7,3 +7,22 @@ void Light::Draw()
 {
 	Gizmos::addSphere(position, 0.2f, 12, 12, vec4(diffuse, 1));
 }
+
+
+void Light::FillBlock(aie::LightBlock& block) const
+{
+	block.position = position;
+	block.type = lightType;
+	block.direction = vec3(0);
+	block.constant = 1;
+	block.ambient = ambient;
+	block.linear = 0;
+	block.diffuse = diffuse;
+	block.quadratic = 0;
+	block.specular = specular;
+	block.ambientStrength = ambientStrength;
+	block.diffuseStrength = diffuseStrength;
+	block.specularStrength = specularStrength;
+	block.specularPower = specularPower;
+	block.padding = 0;
+}
\ No newline at end of file
@@ -1,4 +1,5 @@
 #pragma once
+#include "UniformBlocks.h"
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
 
@@ -33,6 +34,9 @@ public:
 
 	virtual void Draw();
 
+	// copies the light into its std140 mirror for the lights uniform block
+	virtual void FillBlock(aie::LightBlock& block) const;
+
 protected:
 	int lightType = LightType::STANDARD;
 };
@@ -1,24 +1,18 @@
 #include "Mesh.h"
+#include "GLState.h"
 #include <gl_core_4_4.h>
 
-Mesh::~Mesh()
-{
-	glDeleteVertexArrays(1, &vertexArrayObjects);
-	glDeleteBuffers(1, &vertexBufferObjects);
-	glDeleteBuffers(1, &indexBufferObjects);
-}
-
 void Mesh::InitialiseQuad()
 {
 	// check that the mesh is not initialized already
 	assert(vertexArrayObjects == 0);
 
 	// generate buffers
-	glGenBuffers(1, &vertexBufferObjects);
-	glGenVertexArrays(1, &vertexArrayObjects);
+	glGenBuffers(1, vertexBufferObjects.put());
+	glGenVertexArrays(1, vertexArrayObjects.put());
 
 	// bind vertex array aka a mesh wrapper
-	glBindVertexArray(vertexArrayObjects);
+	aie::GLState::bindVertexArray(vertexArrayObjects);
 
 	// bind vertex buffer
 	glBindBuffer(GL_ARRAY_BUFFER, vertexBufferObjects);
@@ -53,20 +47,11 @@ void Mesh::InitialiseQuad()
 	// fill vertex buffer
 	glBufferData(GL_ARRAY_BUFFER, 6 * sizeof(Vertex), vertices, GL_STATIC_DRAW);
 
-	// enable first element as position
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), 0);
-
-	// enable second element as normal
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 4, GL_FLOAT, GL_TRUE, sizeof(Vertex), (void*)16);
-
-	// enable third element as texture
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)32);
+	// enable position, normal and texture elements
+	Layout::apply();
 
 	// unbind buffers
-	glBindVertexArray(0);
+	aie::GLState::bindVertexArray(0);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
 	// quad has 2 tris
@@ -79,35 +64,40 @@ void Mesh::InitialiseFullScreenQuad()
 	assert(vertexArrayObjects == 0);
 
 	// generate buffers
-	glGenBuffers(1, &vertexBufferObjects);
-	glGenVertexArrays(1, &vertexArrayObjects);
+	glGenBuffers(1, vertexBufferObjects.put());
+	glGenVertexArrays(1, vertexArrayObjects.put());
 
 	// bind vertex array aka a mesh wrapper
-	glBindVertexArray(vertexArrayObjects);
+	aie::GLState::bindVertexArray(vertexArrayObjects);
 
 	// bind vertex buffer
 	glBindBuffer(GL_ARRAY_BUFFER, vertexBufferObjects);
 
+	// full screen quads only need a 2D position
+	struct QuadVertex
+	{
+		vec2 position;
+	};
+
 	// define vertices
-	float vertices[] =
+	QuadVertex vertices[] =
 	{
-		-1, 1, // left top
-		-1, -1, // left bottom
-		1, 1, // right top
-		-1, -1, // left bottom
-		1, -1, // right bottom
-		1, 1, // right top
+		{ { -1, 1 } }, // left top
+		{ { -1, -1 } }, // left bottom
+		{ { 1, 1 } }, // right top
+		{ { -1, -1 } }, // left bottom
+		{ { 1, -1 } }, // right bottom
+		{ { 1, 1 } }, // right top
 	};
 
 	// fill vertex buffer
-	glBufferData(GL_ARRAY_BUFFER, 12 * sizeof(float), vertices, GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, 6 * sizeof(QuadVertex), vertices, GL_STATIC_DRAW);
 
 	// enable first element as position
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 8, 0);
+	aie::VertexLayout<QuadVertex, VERTEX_ATTRIB(QuadVertex, position, 0)>::apply();
 
 	// unbind buffers
-	glBindVertexArray(0);
+	aie::GLState::bindVertexArray(0);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
 	// quad has 2 tris
@@ -119,11 +109,11 @@ void Mesh::Initialise(unsigned int vertexCount, const Vertex* vertices, unsigned
 	assert(vertexArrayObjects == 0);
 
 	// generate buffers
-	glGenBuffers(1, &vertexBufferObjects);
-	glGenVertexArrays(1, &vertexArrayObjects);
+	glGenBuffers(1, vertexBufferObjects.put());
+	glGenVertexArrays(1, vertexArrayObjects.put());
 
 	// bind vertex array aka a mesh wrapper
-	glBindVertexArray(vertexArrayObjects);
+	aie::GLState::bindVertexArray(vertexArrayObjects);
 
 	// bind vertex buffer
 	glBindBuffer(GL_ARRAY_BUFFER, vertexBufferObjects);
@@ -131,14 +121,13 @@ void Mesh::Initialise(unsigned int vertexCount, const Vertex* vertices, unsigned
 	// fill vertex buffer
 	glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(Vertex), vertices, GL_STATIC_DRAW);
 
-	// enable first element as position
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), 0);
+	// enable position, normal and texture elements
+	Layout::apply();
 
 	// bind indices if there are any
 	if (indexCount != 0)
 	{
-		glGenBuffers(1, &indexBufferObjects);
+		glGenBuffers(1, indexBufferObjects.put());
 
 		// bind vertex buffer
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferObjects);
@@ -154,14 +143,14 @@ void Mesh::Initialise(unsigned int vertexCount, const Vertex* vertices, unsigned
 	}
 
 	// unbind buffers
-	glBindVertexArray(0);
+	aie::GLState::bindVertexArray(0);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 void Mesh::Draw()
 {
-	glBindVertexArray(vertexArrayObjects);
+	aie::GLState::bindVertexArray(vertexArrayObjects);
 
 	if (indexBufferObjects != 0)
 		glDrawElements(GL_TRIANGLES, 3 * triCount, GL_UNSIGNED_INT, 0);
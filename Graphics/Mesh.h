@@ -1,14 +1,22 @@
 #pragma once
 #include <glm/vec2.hpp>
 #include <glm/vec4.hpp>
+#include "GLHandle.h"
+#include "VertexLayout.h"
 
 using namespace glm;
 
 class Mesh
 {
 public:
-	Mesh() : triCount(0), vertexArrayObjects(0), vertexBufferObjects(0), indexBufferObjects(0) {}
-	virtual ~Mesh();
+	Mesh() : triCount(0) {}
+	virtual ~Mesh() {}
+
+	// meshes can be moved but not copied, as only one can own the buffers
+	Mesh(const Mesh&) = delete;
+	Mesh& operator=(const Mesh&) = delete;
+	Mesh(Mesh&& other) = default;
+	Mesh& operator=(Mesh&& other) = default;
 
 	struct Vertex
 	{
@@ -17,6 +25,12 @@ public:
 		vec2 texCoord;
 	};
 
+	// attribute setup for the vertex, checked against the struct at compile time
+	typedef aie::VertexLayout<Vertex,
+		VERTEX_ATTRIB(Vertex, position, 0),
+		VERTEX_ATTRIB(Vertex, normal, 1),
+		VERTEX_ATTRIB(Vertex, texCoord, 2)> Layout;
+
 	void InitialiseQuad();
 	void InitialiseFullScreenQuad();
 	void Initialise(unsigned int vertexCount, const Vertex* vertices, unsigned int indexCount = 0, unsigned int* indices = nullptr);
@@ -25,7 +39,7 @@ public:
 
 protected:
 	unsigned int triCount;
-	unsigned int vertexArrayObjects;
-	unsigned int vertexBufferObjects;
-	unsigned int indexBufferObjects;
+	aie::VertexArrayHandle vertexArrayObjects;
+	aie::BufferHandle vertexBufferObjects;
+	aie::BufferHandle indexBufferObjects;
 };
@@ -0,0 +1,193 @@
+#include "MeshPool.h"
+#include "GLState.h"
+#include "gl_core_4_4.h"
+#include <cassert>
+
+namespace aie {
+
+MeshPool::MeshPool() {
+}
+
+bool MeshPool::initialise(unsigned int vertexCapacity, unsigned int indexCapacity) {
+	assert(m_vao == 0);
+
+	m_vertexSpace.reset(vertexCapacity);
+	m_indexSpace.reset(indexCapacity);
+
+	glGenBuffers(1, m_vbo.put());
+	glGenBuffers(1, m_ibo.put());
+	glGenVertexArrays(1, m_vao.put());
+
+	GLState::bindVertexArray(m_vao);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCapacity * sizeof(unsigned int), nullptr, GL_STATIC_DRAW);
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+	glBufferData(GL_ARRAY_BUFFER, vertexCapacity * sizeof(OBJMesh::Vertex), nullptr, GL_STATIC_DRAW);
+
+	// same layout as a stand-alone OBJMesh chunk
+	OBJMesh::Layout::apply();
+
+	GLState::bindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	return true;
+}
+
+MeshPool::Allocation MeshPool::allocate(const OBJMesh::Vertex* vertices, unsigned int vertexCount,
+										const unsigned int* indices, unsigned int indexCount) {
+	assert(m_vao != 0 && "Mesh pool not initialised");
+
+	if (vertexCount == 0 || indexCount == 0)
+		return INVALID;
+
+	// grow by doubling when no free block fits, so repeated loads don't keep reallocating.
+	// the new space joins any free block at the end, so one grow is always enough
+	unsigned int vertexOffset = m_vertexSpace.allocate(vertexCount);
+	if (vertexOffset == RangeAllocator::INVALID) {
+		unsigned int capacity = m_vertexSpace.getCapacity();
+		unsigned int newCapacity = capacity * 2 > capacity + vertexCount ? capacity * 2 : capacity + vertexCount;
+		grow(m_vbo, capacity * sizeof(OBJMesh::Vertex), newCapacity * sizeof(OBJMesh::Vertex));
+		m_vertexSpace.grow(newCapacity);
+		vertexOffset = m_vertexSpace.allocate(vertexCount);
+	}
+
+	unsigned int indexOffset = m_indexSpace.allocate(indexCount);
+	if (indexOffset == RangeAllocator::INVALID) {
+		unsigned int capacity = m_indexSpace.getCapacity();
+		unsigned int newCapacity = capacity * 2 > capacity + indexCount ? capacity * 2 : capacity + indexCount;
+		grow(m_ibo, capacity * sizeof(unsigned int), newCapacity * sizeof(unsigned int));
+		m_indexSpace.grow(newCapacity);
+		indexOffset = m_indexSpace.allocate(indexCount);
+	}
+
+	Range range;
+	range.firstIndex = indexOffset;
+	range.indexCount = indexCount;
+	range.baseVertex = (int)vertexOffset;
+	range.vertexCount = vertexCount;
+
+	// reuse the slot of a freed allocation if there is one
+	Allocation allocation;
+	if (m_unusedAllocations.empty() == false) {
+		allocation = m_unusedAllocations.back();
+		m_unusedAllocations.pop_back();
+		m_ranges[allocation] = range;
+	}
+	else {
+		allocation = (Allocation)m_ranges.size();
+		m_ranges.push_back(range);
+	}
+
+	// element array bindings are vertex array state, so unbind the vao first
+	GLState::bindVertexArray(0);
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+	glBufferSubData(GL_ARRAY_BUFFER, vertexOffset * sizeof(OBJMesh::Vertex), vertexCount * sizeof(OBJMesh::Vertex), vertices);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_ibo);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, indexOffset * sizeof(unsigned int), indexCount * sizeof(unsigned int), indices);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	return allocation;
+}
+
+void MeshPool::free(Allocation allocation) {
+	if (allocation == INVALID)
+		return;
+
+	Range& range = m_ranges[allocation];
+
+	m_vertexSpace.free((unsigned int)range.baseVertex);
+	m_indexSpace.free(range.firstIndex);
+
+	range.indexCount = 0;
+	range.vertexCount = 0;
+	m_unusedAllocations.push_back(allocation);
+}
+
+void MeshPool::defragment() {
+
+	std::map<unsigned int, unsigned int> newVertexOffsets, newIndexOffsets;
+	compact(m_vbo, m_vertexSpace, sizeof(OBJMesh::Vertex), newVertexOffsets);
+	compact(m_ibo, m_indexSpace, sizeof(unsigned int), newIndexOffsets);
+
+	for (auto& range : m_ranges) {
+		if (range.indexCount == 0)
+			continue;
+		range.baseVertex = (int)newVertexOffsets[(unsigned int)range.baseVertex];
+		range.firstIndex = newIndexOffsets[range.firstIndex];
+	}
+}
+
+void MeshPool::grow(unsigned int buffer, unsigned int oldBytes, unsigned int newBytes) {
+
+	// copy the contents aside, then respecify the same buffer name so that
+	// vertex arrays referencing it stay valid
+	unsigned int temp = 0;
+	glGenBuffers(1, &temp);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, temp);
+	glBufferData(GL_COPY_WRITE_BUFFER, oldBytes, nullptr, GL_STREAM_COPY);
+
+	GLState::bindVertexArray(0);
+	glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+	if (oldBytes > 0)
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldBytes);
+
+	glBufferData(GL_COPY_READ_BUFFER, newBytes, nullptr, GL_STATIC_DRAW);
+
+	if (oldBytes > 0) {
+		glBindBuffer(GL_COPY_READ_BUFFER, temp);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldBytes);
+	}
+
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	glDeleteBuffers(1, &temp);
+}
+
+void MeshPool::compact(unsigned int buffer, RangeAllocator& space, unsigned int elementSize,
+					   std::map<unsigned int, unsigned int>& newOffsets) {
+
+	unsigned int usedBytes = space.getUsed() * elementSize;
+	if (usedBytes == 0)
+		return;
+
+	// pack every allocation in to a temporary buffer, in order, then copy the
+	// packed data back over the front of the buffer in one go
+	unsigned int temp = 0;
+	glGenBuffers(1, &temp);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, temp);
+	glBufferData(GL_COPY_WRITE_BUFFER, usedBytes, nullptr, GL_STREAM_COPY);
+
+	GLState::bindVertexArray(0);
+	glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+
+	unsigned int packed = 0;
+	for (auto& allocation : space.getAllocations()) {
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+							allocation.first * elementSize, packed * elementSize, allocation.second * elementSize);
+		newOffsets[allocation.first] = packed;
+		packed += allocation.second;
+	}
+
+	glBindBuffer(GL_COPY_READ_BUFFER, temp);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, usedBytes);
+
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	glDeleteBuffers(1, &temp);
+
+	// allocations from a single free block are handed out front to back, matching the packed order
+	std::map<unsigned int, unsigned int> sizes = space.getAllocations();
+	space.reset(space.getCapacity());
+	for (auto& allocation : sizes)
+		space.allocate(allocation.second);
+}
+
+} // namespace aie
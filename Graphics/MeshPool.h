@@ -0,0 +1,74 @@
+#pragma once
+
+#include "OBJMesh.h"
+#include "RangeAllocator.h"
+#include <vector>
+
+namespace aie {
+
+// a single vertex and index buffer pair that many meshes sub-allocate their
+// geometry from, so that they can all be drawn through one vertex array.
+// freed space is reused by later allocations, and defragment() closes the gaps
+class MeshPool {
+public:
+
+	// identifies a mesh's geometry in the pool, stays the same when the pool is defragmented
+	typedef unsigned int Allocation;
+	static const Allocation INVALID = 0xffffffff;
+
+	// where a mesh's geometry lives inside the shared buffers
+	struct Range {
+		unsigned int	firstIndex;
+		unsigned int	indexCount;
+		int				baseVertex;
+		unsigned int	vertexCount;
+	};
+
+	MeshPool();
+
+	// creates the shared buffers with an initial capacity, they grow as required
+	bool initialise(unsigned int vertexCapacity, unsigned int indexCapacity);
+
+	// copies vertices and indices in to free space in the shared buffers, indices stay relative to the range.
+	// returns INVALID for empty geometry, which has nothing to draw
+	Allocation allocate(const OBJMesh::Vertex* vertices, unsigned int vertexCount,
+						const unsigned int* indices, unsigned int indexCount);
+
+	// returns the allocation's space to the pool
+	void free(Allocation allocation);
+
+	// the allocation's current position in the shared buffers
+	const Range& getRange(Allocation allocation) const { return m_ranges[allocation]; }
+
+	// moves all geometry to the front of the buffers so that free space is one block
+	void defragment();
+
+	// the vertex array describes the OBJMesh::Vertex layout over the shared buffers
+	unsigned int getVertexArray() const { return m_vao; }
+	unsigned int getVertexBuffer() const { return m_vbo; }
+	unsigned int getIndexBuffer() const { return m_ibo; }
+
+	// vertex and index space, for utilisation and fragmentation statistics
+	const RangeAllocator& getVertexSpace() const { return m_vertexSpace; }
+	const RangeAllocator& getIndexSpace() const { return m_indexSpace; }
+
+private:
+
+	// resizes a buffer while keeping its name and its contents
+	void grow(unsigned int buffer, unsigned int oldBytes, unsigned int newBytes);
+
+	// packs a buffer's allocations together, returning each allocation's new offset
+	void compact(unsigned int buffer, RangeAllocator& space, unsigned int elementSize,
+				 std::map<unsigned int, unsigned int>& newOffsets);
+
+	VertexArrayHandle	m_vao;
+	BufferHandle		m_vbo, m_ibo;
+
+	RangeAllocator		m_vertexSpace;
+	RangeAllocator		m_indexSpace;
+
+	std::vector<Range>		m_ranges;
+	std::vector<Allocation>	m_unusedAllocations;
+};
+
+} // namespace aie
@@ -1,21 +1,112 @@
 #include "OBJMesh.h"
+#include "GLState.h"
+#include "MeshPool.h"
+#include "Shader.h"
+#include "TextureStreamer.h"
 #include "gl_core_4_4.h"
 #include <glm/geometric.hpp>
+#include <type_traits>
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "tiny_obj_loader.h"
 
 namespace aie {
 
+// vectors of meshes and materials only move them when they grow if moving can't throw
+static_assert(std::is_nothrow_move_constructible<OBJMesh>::value, "OBJMesh must move without throwing");
+static_assert(std::is_nothrow_move_constructible<OBJMesh::Material>::value, "Materials must move without throwing");
+
+// the material uniforms' handles in one linked program
+struct MaterialUniforms {
+	unsigned int				linkID;
+	UniformHandle<glm::vec3>	ka, kd, ks, ke;
+	UniformHandle<float>		opacity, specularPower;
+	UniformHandle<int>			alphaTexture, ambientTexture, diffuseTexture, specularTexture;
+	UniformHandle<int>			specularHighlightTexture, normalTexture, displacementTexture;
+};
+
+// resolved the first time any mesh is drawn with a program, a handful of programs draw meshes
+static std::vector<MaterialUniforms> s_materialUniforms;
+
+static const MaterialUniforms& getMaterialUniforms(const ShaderProgram& shader) {
+	for (auto& uniforms : s_materialUniforms) {
+		if (uniforms.linkID == shader.getLinkID())
+			return uniforms;
+	}
+
+	MaterialUniforms uniforms;
+	uniforms.linkID = shader.getLinkID();
+	uniforms.ka = shader.getUniformHandle<glm::vec3>("Ka");
+	uniforms.kd = shader.getUniformHandle<glm::vec3>("Kd");
+	uniforms.ks = shader.getUniformHandle<glm::vec3>("Ks");
+	uniforms.ke = shader.getUniformHandle<glm::vec3>("Ke");
+	uniforms.opacity = shader.getUniformHandle<float>("opacity");
+	uniforms.specularPower = shader.getUniformHandle<float>("specularPower");
+	uniforms.alphaTexture = shader.getUniformHandle<int>("alphaTexture");
+	uniforms.ambientTexture = shader.getUniformHandle<int>("ambientTexture");
+	uniforms.diffuseTexture = shader.getUniformHandle<int>("diffuseTexture");
+	uniforms.specularTexture = shader.getUniformHandle<int>("specularTexture");
+	uniforms.specularHighlightTexture = shader.getUniformHandle<int>("specularHighlightTexture");
+	uniforms.normalTexture = shader.getUniformHandle<int>("normalTexture");
+	uniforms.displacementTexture = shader.getUniformHandle<int>("displacementTexture");
+	s_materialUniforms.push_back(uniforms);
+	return s_materialUniforms.back();
+}
+
+unsigned int OBJMesh::sm_vertexArrayBinds = 0;
+unsigned int OBJMesh::sm_nextID = 0;
+
 OBJMesh::~OBJMesh() {
-	for (auto& c : m_meshChunks) {
-		glDeleteVertexArrays(1, &c.vao);
-		glDeleteBuffers(1, &c.vbo);
-		glDeleteBuffers(1, &c.ibo);
+	// give pooled geometry back to the pool
+	if (m_pool != nullptr) {
+		for (auto& c : m_meshChunks)
+			m_pool->free(c.poolAllocation);
+	}
+	releaseTextures();
+}
+
+OBJMesh::OBJMesh(OBJMesh&& other) noexcept
+	: m_id(other.m_id),
+	m_pool(other.m_pool),
+	m_streamer(other.m_streamer),
+	m_boundingRadius(other.m_boundingRadius),
+	m_filename(std::move(other.m_filename)),
+	m_meshChunks(std::move(other.m_meshChunks)),
+	m_materials(std::move(other.m_materials)) {
+
+	// the materials' storage moves with them, so streamed textures keep their addresses
+	other.m_id = 0;
+	other.m_pool = nullptr;
+	other.m_streamer = nullptr;
+	other.m_meshChunks.clear();
+}
+
+OBJMesh& OBJMesh::operator = (OBJMesh&& other) noexcept {
+	if (this != &other) {
+		if (m_pool != nullptr) {
+			for (auto& c : m_meshChunks)
+				m_pool->free(c.poolAllocation);
+		}
+		releaseTextures();
+
+		m_id = other.m_id;
+		m_pool = other.m_pool;
+		m_streamer = other.m_streamer;
+		m_boundingRadius = other.m_boundingRadius;
+		m_filename = std::move(other.m_filename);
+		m_meshChunks = std::move(other.m_meshChunks);
+		m_materials = std::move(other.m_materials);
+
+		other.m_id = 0;
+		other.m_pool = nullptr;
+		other.m_streamer = nullptr;
+		other.m_meshChunks.clear();
 	}
+	return *this;
 }
 
-bool OBJMesh::load(const char* filename, bool loadTextures /* = true */, bool flipTextureV /* = false */) {
+bool OBJMesh::load(const char* filename, bool loadTextures /* = true */, bool flipTextureV /* = false */, MeshPool* pool /* = nullptr */,
+				   TextureStreamer* streamer /* = nullptr */) {
 
 	if (m_meshChunks.empty() == false) {
 		printf("Mesh already initialised, can't re-initialise!\n");
@@ -38,6 +129,12 @@ bool OBJMesh::load(const char* filename, bool loadTextures /* = true */, bool fl
 	}
 
 	m_filename = filename;
+	m_id = ++sm_nextID;
+	m_pool = pool;
+	m_streamer = streamer;
+
+	// streamed textures start with their small mips
+	unsigned int maxSize = streamer != nullptr ? streamer->getStartSize() : 0;
 
 	// copy materials
 	m_materials.resize(materials.size());
@@ -51,14 +148,14 @@ bool OBJMesh::load(const char* filename, bool loadTextures /* = true */, bool fl
 		m_materials[index].specularPower = m.shininess;
 		m_materials[index].opacity = m.dissolve;
 
-		// textures
-		m_materials[index].alphaTexture.load((folder + m.alpha_texname).c_str());
-		m_materials[index].ambientTexture.load((folder + m.ambient_texname).c_str());
-		m_materials[index].diffuseTexture.load((folder + m.diffuse_texname).c_str());
-		m_materials[index].specularTexture.load((folder + m.specular_texname).c_str());
-		m_materials[index].specularHighlightTexture.load((folder + m.specular_highlight_texname).c_str());
-		m_materials[index].normalTexture.load((folder + m.bump_texname).c_str());
-		m_materials[index].displacementTexture.load((folder + m.displacement_texname).c_str());
+		// textures, block compressed and cached so later loads skip decoding the images
+		m_materials[index].alphaTexture.loadCompressed((folder + m.alpha_texname).c_str(), Texture::DATA, maxSize);
+		m_materials[index].ambientTexture.loadCompressed((folder + m.ambient_texname).c_str(), Texture::COLOUR, maxSize);
+		m_materials[index].diffuseTexture.loadCompressed((folder + m.diffuse_texname).c_str(), Texture::COLOUR, maxSize);
+		m_materials[index].specularTexture.loadCompressed((folder + m.specular_texname).c_str(), Texture::DATA, maxSize);
+		m_materials[index].specularHighlightTexture.loadCompressed((folder + m.specular_highlight_texname).c_str(), Texture::DATA, maxSize);
+		m_materials[index].normalTexture.loadCompressed((folder + m.bump_texname).c_str(), Texture::NORMALS, maxSize);
+		m_materials[index].displacementTexture.loadCompressed((folder + m.displacement_texname).c_str(), Texture::DATA, maxSize);
 
 		++index;
 	}
@@ -67,21 +164,13 @@ bool OBJMesh::load(const char* filename, bool loadTextures /* = true */, bool fl
 	m_meshChunks.reserve(shapes.size());
 	for (auto& s : shapes) {
 
-		MeshChunk chunk;
+		// shapes without any triangles, such as ones holding only lines or points, have nothing to draw
+		if (s.mesh.positions.empty() ||
+			s.mesh.indices.empty())
+			continue;
 
-		// generate buffers
-		glGenBuffers(1, &chunk.vbo);
-		glGenBuffers(1, &chunk.ibo);
-		glGenVertexArrays(1, &chunk.vao);
-
-		// bind vertex array aka a mesh wrapper
-		glBindVertexArray(chunk.vao);
-
-		// set the index buffer data
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, chunk.ibo);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-					 s.mesh.indices.size() * sizeof(unsigned int),
-					 s.mesh.indices.data(), GL_STATIC_DRAW);
+		MeshChunk chunk;
+		chunk.poolAllocation = 0;
 
 		// store index count for rendering
 		chunk.indexCount = (unsigned int)s.mesh.indices.size();
@@ -96,8 +185,10 @@ bool OBJMesh::load(const char* filename, bool loadTextures /* = true */, bool fl
 		bool hasTexture = s.mesh.texcoords.empty() == false;
 
 		for (size_t i = 0; i < vertCount; ++i) {
-			if (hasPosition)
+			if (hasPosition) {
 				vertices[i].position = glm::vec4(s.mesh.positions[i * 3 + 0], s.mesh.positions[i * 3 + 1], s.mesh.positions[i * 3 + 2], 1);
+				m_boundingRadius = glm::max(m_boundingRadius, glm::length(glm::vec3(vertices[i].position)));
+			}
 			if (hasNormal)
 				vertices[i].normal = glm::vec4(s.mesh.normals[i * 3 + 0], s.mesh.normals[i * 3 + 1], s.mesh.normals[i * 3 + 2], 0);
 
@@ -110,84 +201,132 @@ bool OBJMesh::load(const char* filename, bool loadTextures /* = true */, bool fl
 		if (hasNormal && hasTexture)
 			calculateTangents(vertices, s.mesh.indices);
 
-		// bind vertex buffer
-		glBindBuffer(GL_ARRAY_BUFFER, chunk.vbo);
+		if (pool != nullptr) {
+
+			// allocate from the shared buffers and draw through the pool's vertex array
+			chunk.poolAllocation = pool->allocate(vertices.data(), (unsigned int)vertices.size(),
+												  s.mesh.indices.data(), chunk.indexCount);
+			if (chunk.poolAllocation == MeshPool::INVALID)
+				continue;
+		}
+		else {
+
+			// generate buffers
+			glGenBuffers(1, chunk.vbo.put());
+			glGenBuffers(1, chunk.ibo.put());
+			glGenVertexArrays(1, chunk.vao.put());
 
-		// fill vertex buffer
-		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+			// bind vertex array aka a mesh wrapper
+			GLState::bindVertexArray(chunk.vao);
 
-		// enable first element as positions
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), 0);
+			// set the index buffer data
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, chunk.ibo);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+						 s.mesh.indices.size() * sizeof(unsigned int),
+						 s.mesh.indices.data(), GL_STATIC_DRAW);
 
-		// enable normals
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 4, GL_FLOAT, GL_TRUE, sizeof(Vertex), (void*)(sizeof(glm::vec4) * 1));
+			// bind vertex buffer
+			glBindBuffer(GL_ARRAY_BUFFER, chunk.vbo);
 
-		// enable texture coords
-		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(sizeof(glm::vec4) * 2));
+			// fill vertex buffer
+			glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
 
-		// enable tangents
-		glEnableVertexAttribArray(3);
-		glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(sizeof(glm::vec4) * 2 + sizeof(glm::vec2)));
+			// enable positions, normals, texture coords and tangents
+			Layout::apply();
 
-		// bind 0 for safety
-		glBindVertexArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+			// bind 0 for safety
+			GLState::bindVertexArray(0);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		}
 
 		// set chunk material
 		chunk.materialID = s.mesh.material_ids.empty() ? -1 : s.mesh.material_ids[0];
 
-		m_meshChunks.push_back(chunk);
+		m_meshChunks.push_back(std::move(chunk));
+	}
+
+	// the materials are in place now, so their textures won't move
+	if (streamer != nullptr) {
+		for (auto& material : m_materials) {
+			streamer->add(&material.alphaTexture);
+			streamer->add(&material.ambientTexture);
+			streamer->add(&material.diffuseTexture);
+			streamer->add(&material.specularTexture);
+			streamer->add(&material.specularHighlightTexture);
+			streamer->add(&material.normalTexture);
+			streamer->add(&material.displacementTexture);
+		}
 	}
 	
 	// load obj
 	return true;
 }
 
+void OBJMesh::requestTextures(float screenSize) const {
+	if (m_streamer == nullptr)
+		return;
+
+	for (auto& material : m_materials) {
+		const Texture* textures[] = { &material.alphaTexture, &material.ambientTexture, &material.diffuseTexture,
+			&material.specularTexture, &material.specularHighlightTexture, &material.normalTexture, &material.displacementTexture };
+		for (const Texture* texture : textures) {
+			if (texture->getLevelCount() > 0)
+				m_streamer->request(texture, TextureStreamer::getLevelForCoverage(*texture, screenSize));
+		}
+	}
+}
+
+void OBJMesh::releaseTextures() {
+	if (m_streamer == nullptr)
+		return;
+
+	for (auto& material : m_materials) {
+		m_streamer->remove(&material.alphaTexture);
+		m_streamer->remove(&material.ambientTexture);
+		m_streamer->remove(&material.diffuseTexture);
+		m_streamer->remove(&material.specularTexture);
+		m_streamer->remove(&material.specularHighlightTexture);
+		m_streamer->remove(&material.normalTexture);
+		m_streamer->remove(&material.displacementTexture);
+	}
+	m_streamer = nullptr;
+}
+
 void OBJMesh::draw(bool usePatches /* = false */) {
 
-	int program = -1;
-	glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+	ShaderProgram* shader = ShaderProgram::getBound();
 
-	if (program == -1) {
+	if (shader == nullptr) {
 		printf("No shader bound!\n");
 		return;
 	}
 
-	// pull uniforms from the shader
-	int kaUniform = glGetUniformLocation(program, "Ka");
-	int kdUniform = glGetUniformLocation(program, "Kd");
-	int ksUniform = glGetUniformLocation(program, "Ks");
-	int keUniform = glGetUniformLocation(program, "Ke");
-	int opacityUniform = glGetUniformLocation(program, "opacity");
-	int specPowUniform = glGetUniformLocation(program, "specularPower");
-
-	int alphaTexUniform = glGetUniformLocation(program, "alphaTexture");
-	int ambientTexUniform = glGetUniformLocation(program, "ambientTexture");
-	int diffuseTexUniform = glGetUniformLocation(program, "diffuseTexture");
-	int specTexUniform = glGetUniformLocation(program, "specularTexture");
-	int specHighlightTexUniform = glGetUniformLocation(program, "specularHighlightTexture");
-	int normalTexUniform = glGetUniformLocation(program, "normalTexture");
-	int dispTexUniform = glGetUniformLocation(program, "displacementTexture");
-
-	// set texture slots (these don't change per material)
-	if (diffuseTexUniform >= 0)
-		glUniform1i(diffuseTexUniform, 0);
-	if (alphaTexUniform >= 0)
-		glUniform1i(alphaTexUniform, 1);
-	if (ambientTexUniform >= 0)
-		glUniform1i(ambientTexUniform, 2);
-	if (specTexUniform >= 0)
-		glUniform1i(specTexUniform, 3);
-	if (specHighlightTexUniform >= 0)
-		glUniform1i(specHighlightTexUniform, 4);
-	if (normalTexUniform >= 0)
-		glUniform1i(normalTexUniform, 5);
-	if (dispTexUniform >= 0)
-		glUniform1i(dispTexUniform, 6);
+	// pull uniforms from the shader, looked up by name only the first time it is drawn with
+	const MaterialUniforms& uniforms = getMaterialUniforms(*shader);
+	auto kaUniform = uniforms.ka;
+	auto kdUniform = uniforms.kd;
+	auto ksUniform = uniforms.ks;
+	auto keUniform = uniforms.ke;
+	auto opacityUniform = uniforms.opacity;
+	auto specPowUniform = uniforms.specularPower;
+
+	auto alphaTexUniform = uniforms.alphaTexture;
+	auto ambientTexUniform = uniforms.ambientTexture;
+	auto diffuseTexUniform = uniforms.diffuseTexture;
+	auto specTexUniform = uniforms.specularTexture;
+	auto specHighlightTexUniform = uniforms.specularHighlightTexture;
+	auto normalTexUniform = uniforms.normalTexture;
+	auto dispTexUniform = uniforms.displacementTexture;
+
+	// set texture slots (these don't change per material, so only upload once)
+	shader->bindUniform(diffuseTexUniform, 0);
+	shader->bindUniform(alphaTexUniform, 1);
+	shader->bindUniform(ambientTexUniform, 2);
+	shader->bindUniform(specTexUniform, 3);
+	shader->bindUniform(specHighlightTexUniform, 4);
+	shader->bindUniform(normalTexUniform, 5);
+	shader->bindUniform(dispTexUniform, 6);
 
 	int currentMaterial = -1;
 
@@ -197,68 +336,70 @@ void OBJMesh::draw(bool usePatches /* = false */) {
 		// bind material
 		if (currentMaterial != c.materialID) {
 			currentMaterial = c.materialID;
-			if (kaUniform >= 0)
-				glUniform3fv(kaUniform, 1, &m_materials[currentMaterial].ambient[0]);
-			if (kdUniform >= 0)
-				glUniform3fv(kdUniform, 1, &m_materials[currentMaterial].diffuse[0]);
-			if (ksUniform >= 0)
-				glUniform3fv(ksUniform, 1, &m_materials[currentMaterial].specular[0]);
-			if (keUniform >= 0)
-				glUniform3fv(keUniform, 1, &m_materials[currentMaterial].emissive[0]);
-			if (opacityUniform >= 0)
-				glUniform1f(opacityUniform, m_materials[currentMaterial].opacity);
-			if (specPowUniform >= 0)
-				glUniform1f(specPowUniform, m_materials[currentMaterial].specularPower);
+			shader->bindUniform(kaUniform, m_materials[currentMaterial].ambient);
+			shader->bindUniform(kdUniform, m_materials[currentMaterial].diffuse);
+			shader->bindUniform(ksUniform, m_materials[currentMaterial].specular);
+			shader->bindUniform(keUniform, m_materials[currentMaterial].emissive);
+			shader->bindUniform(opacityUniform, m_materials[currentMaterial].opacity);
+			shader->bindUniform(specPowUniform, m_materials[currentMaterial].specularPower);
 
 			glActiveTexture(GL_TEXTURE0);
 			if (m_materials[currentMaterial].diffuseTexture.getHandle() > 0)
 				glBindTexture(GL_TEXTURE_2D, m_materials[currentMaterial].diffuseTexture.getHandle());
-			else if (diffuseTexUniform >= 0)
+			else if (diffuseTexUniform.isValid())
 				glBindTexture(GL_TEXTURE_2D, 0);
 
 			glActiveTexture(GL_TEXTURE1);
 			if (m_materials[currentMaterial].alphaTexture.getHandle() > 0)
 				glBindTexture(GL_TEXTURE_2D, m_materials[currentMaterial].alphaTexture.getHandle());
-			else if (alphaTexUniform >= 0)
+			else if (alphaTexUniform.isValid())
 				glBindTexture(GL_TEXTURE_2D, 0);
 
 			glActiveTexture(GL_TEXTURE2);
 			if (m_materials[currentMaterial].ambientTexture.getHandle() > 0)
 				glBindTexture(GL_TEXTURE_2D, m_materials[currentMaterial].ambientTexture.getHandle());
-			else if (ambientTexUniform >= 0)
+			else if (ambientTexUniform.isValid())
 				glBindTexture(GL_TEXTURE_2D, 0);
 
 			glActiveTexture(GL_TEXTURE3);
 			if (m_materials[currentMaterial].specularTexture.getHandle() > 0)
 				glBindTexture(GL_TEXTURE_2D, m_materials[currentMaterial].specularTexture.getHandle());
-			else if (specTexUniform >= 0)
+			else if (specTexUniform.isValid())
 				glBindTexture(GL_TEXTURE_2D, 0);
 
 			glActiveTexture(GL_TEXTURE4);
 			if (m_materials[currentMaterial].specularHighlightTexture.getHandle() > 0)
 				glBindTexture(GL_TEXTURE_2D, m_materials[currentMaterial].specularHighlightTexture.getHandle());
-			else if (specHighlightTexUniform >= 0)
+			else if (specHighlightTexUniform.isValid())
 				glBindTexture(GL_TEXTURE_2D, 0);
 
 			glActiveTexture(GL_TEXTURE5);
 			if (m_materials[currentMaterial].normalTexture.getHandle() > 0)
 				glBindTexture(GL_TEXTURE_2D, m_materials[currentMaterial].normalTexture.getHandle());
-			else if (normalTexUniform >= 0)
+			else if (normalTexUniform.isValid())
 				glBindTexture(GL_TEXTURE_2D, 0);
 
 			glActiveTexture(GL_TEXTURE6);
 			if (m_materials[currentMaterial].displacementTexture.getHandle() > 0)
 				glBindTexture(GL_TEXTURE_2D, m_materials[currentMaterial].displacementTexture.getHandle());
-			else if (dispTexUniform >= 0)
+			else if (dispTexUniform.isValid())
 				glBindTexture(GL_TEXTURE_2D, 0);
 		}
 
-		// bind and draw geometry
-		glBindVertexArray(c.vao);
-		if (usePatches)
-			glDrawElements(GL_PATCHES, c.indexCount, GL_UNSIGNED_INT, 0);
+		// bind geometry, pooled meshes all share one vertex array so the bind is skipped
+		// if the previous pooled mesh left it bound
+		unsigned int vao = m_pool != nullptr ? m_pool->getVertexArray() : c.vao.get();
+		if (GLState::bindVertexArray(vao))
+			sm_vertexArrayBinds++;
+
+		// draw geometry
+		if (m_pool != nullptr) {
+			const MeshPool::Range& range = m_pool->getRange(c.poolAllocation);
+			glDrawElementsBaseVertex(usePatches ? GL_PATCHES : GL_TRIANGLES, range.indexCount, GL_UNSIGNED_INT,
+									 (void*)(range.firstIndex * sizeof(unsigned int)), range.baseVertex);
+		}
 		else
-			glDrawElements(GL_TRIANGLES, c.indexCount, GL_UNSIGNED_INT, 0);
+			glDrawElements(usePatches ? GL_PATCHES : GL_TRIANGLES, c.indexCount, GL_UNSIGNED_INT, 0);
 	}
 }
 
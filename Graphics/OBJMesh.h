@@ -5,10 +5,15 @@
 #include <glm/vec4.hpp>
 #include <string>
 #include <vector>
+#include "GLHandle.h"
 #include "Texture.h"
+#include "VertexLayout.h"
 
 namespace aie {
 
+class MeshPool;
+class TextureStreamer;
+
 // a simple triangle mesh wrapper
 class OBJMesh {
 public:
@@ -23,6 +28,13 @@ public:
 		glm::vec4 tangent;	// added to attrib location 3
 	};
 
+	// attribute setup for the vertex, checked against the struct at compile time
+	typedef VertexLayout<Vertex,
+		VERTEX_ATTRIB(Vertex, position, 0),
+		VERTEX_ATTRIB(Vertex, normal, 1),
+		VERTEX_ATTRIB(Vertex, texcoord, 2),
+		VERTEX_ATTRIB(Vertex, tangent, 3)> Layout;
+
 	// a basic material
 	class Material {
 	public:
@@ -30,6 +42,9 @@ public:
 		Material() : ambient(1), diffuse(1), specular(0), emissive(0), specularPower(1), opacity(1) {}
 		~Material() {}
 
+		Material(Material&& other) = default;
+		Material& operator = (Material&& other) = default;
+
 		glm::vec3 ambient;
 		glm::vec3 diffuse;
 		glm::vec3 specular;
@@ -47,11 +62,33 @@ public:
 		Texture displacementTexture;		// bound slot 6
 	};
 
-	OBJMesh() {}
+	// a drawable piece of the mesh that uses a single material
+	struct MeshChunk {
+		// empty when the chunk lives in a MeshPool, which owns the buffers instead
+		VertexArrayHandle	vao;
+		BufferHandle		vbo, ibo;
+
+		unsigned int	indexCount;
+		int				materialID;
+
+		// the chunk's geometry in the MeshPool, if it lives in one
+		unsigned int	poolAllocation;
+	};
+
+	OBJMesh() : m_id(0), m_pool(nullptr), m_streamer(nullptr), m_boundingRadius(0) {}
 	~OBJMesh();
 
+	// meshes can be moved but not copied, as only one can own the buffers and textures
+	OBJMesh(const OBJMesh&) = delete;
+	OBJMesh& operator = (const OBJMesh&) = delete;
+	OBJMesh(OBJMesh&& other) noexcept;
+	OBJMesh& operator = (OBJMesh&& other) noexcept;
+
 	// will fail if a mesh has already been loaded in to this instance
-	bool load(const char* filename, bool loadTextures = true, bool flipTextureV = false);
+	// if a pool is given the geometry is allocated from its shared buffers instead of owning its own.
+	// if a streamer is given textures load with only their small mips and are streamed from then on
+	bool load(const char* filename, bool loadTextures = true, bool flipTextureV = false, MeshPool* pool = nullptr,
+			  TextureStreamer* streamer = nullptr);
 
 	// allow option to draw as patches for tessellation
 	void draw(bool usePatches = false);
@@ -59,23 +96,49 @@ public:
 	// access to the filename that was loaded
 	const std::string& getFilename() const { return m_filename; }
 
+	// unique to each loaded mesh and kept when it is moved, 0 until a mesh is loaded
+	unsigned int getID() const { return m_id; }
+
 	// material access
 	size_t getMaterialCount() const { return m_materials.size();  }
 	Material& getMaterial(size_t index) { return m_materials[index];  }
+	const Material& getMaterial(size_t index) const { return m_materials[index]; }
+
+	// chunk access for batching
+	size_t getChunkCount() const { return m_meshChunks.size(); }
+	const MeshChunk& getChunk(size_t index) const { return m_meshChunks[index]; }
+
+	// the pool the geometry was loaded in to, or nullptr if the chunks own their buffers
+	MeshPool* getPool() const { return m_pool; }
+
+	// distance of the furthest vertex from the mesh's origin
+	float getBoundingRadius() const { return m_boundingRadius; }
+
+	// asks the streamer the textures were loaded with for the mips needed to cover the
+	// given size on screen in pixels, does nothing if they aren't streamed
+	void requestTextures(float screenSize) const;
+
+	// vertex array binds made by draw() across all meshes, redundant binds are skipped
+	static unsigned int getVertexArrayBindCount() { return sm_vertexArrayBinds; }
+	static void resetVertexArrayBindCount() { sm_vertexArrayBinds = 0; }
 
 private:
 
 	void calculateTangents(std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices);
 
-	struct MeshChunk {
-		unsigned int	vao, vbo, ibo;
-		unsigned int	indexCount;
-		int				materialID;
-	};
+	// removes the materials' textures from the streamer
+	void releaseTextures();
 
+	unsigned int			m_id;
+	MeshPool*				m_pool;
+	TextureStreamer*		m_streamer;
+	float					m_boundingRadius;
 	std::string				m_filename;
 	std::vector<MeshChunk>	m_meshChunks;
 	std::vector<Material>	m_materials;
+
+	static unsigned int		sm_vertexArrayBinds;
+	static unsigned int		sm_nextID;
 };
 
 } // namespace aie
\ No newline at end of file
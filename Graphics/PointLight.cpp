@@ -1 +1,9 @@
 #include "PointLight.h"
+
+void PointLight::FillBlock(aie::LightBlock& block) const
+{
+	Light::FillBlock(block);
+	block.constant = constant;
+	block.linear = linear;
+	block.quadratic = quadratic;
+}
\ No newline at end of file
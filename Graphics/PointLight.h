@@ -26,4 +26,6 @@ public:
 	float constant = 1.0f;
 	float linear = 0.09f;
 	float quadratic = 0.032f;
+
+	void FillBlock(aie::LightBlock& block) const override;
 };
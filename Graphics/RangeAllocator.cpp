@@ -0,0 +1,134 @@
+#include "RangeAllocator.h"
+#include <cassert>
+#include <iterator>
+
+namespace aie {
+
+RangeAllocator::RangeAllocator()
+	: m_capacity(0),
+	m_used(0) {
+}
+
+void RangeAllocator::reset(unsigned int capacity) {
+	m_freeByOffset.clear();
+	m_freeBySize.clear();
+	m_allocated.clear();
+
+	m_capacity = capacity;
+	m_used = 0;
+
+	if (capacity > 0)
+		insertFree(0, capacity);
+}
+
+void RangeAllocator::grow(unsigned int newCapacity) {
+	assert(newCapacity >= m_capacity);
+
+	unsigned int offset = m_capacity;
+	unsigned int size = newCapacity - m_capacity;
+	m_capacity = newCapacity;
+
+	if (size == 0)
+		return;
+
+	// merge with a free block that already runs to the end
+	if (m_freeByOffset.empty() == false) {
+		auto last = std::prev(m_freeByOffset.end());
+		if (last->first + last->second == offset) {
+			offset = last->first;
+			size += last->second;
+			eraseFree(last);
+		}
+	}
+
+	insertFree(offset, size);
+}
+
+unsigned int RangeAllocator::allocate(unsigned int size) {
+	if (size == 0)
+		return INVALID;
+
+	auto fit = m_freeBySize.lower_bound(size);
+	if (fit == m_freeBySize.end())
+		return INVALID;
+
+	unsigned int offset = fit->second;
+	unsigned int blockSize = fit->first;
+	eraseFree(m_freeByOffset.find(offset));
+
+	// return the remainder to the free list
+	if (blockSize > size)
+		insertFree(offset + size, blockSize - size);
+
+	m_allocated[offset] = size;
+	m_used += size;
+
+	return offset;
+}
+
+void RangeAllocator::free(unsigned int offset) {
+	auto allocation = m_allocated.find(offset);
+	assert(allocation != m_allocated.end() && "Freeing a range that wasn't allocated");
+
+	unsigned int size = allocation->second;
+	m_allocated.erase(allocation);
+	m_used -= size;
+
+	// merge with the free block after
+	auto next = m_freeByOffset.find(offset + size);
+	if (next != m_freeByOffset.end()) {
+		size += next->second;
+		eraseFree(next);
+	}
+
+	// merge with the free block before
+	auto previous = m_freeByOffset.lower_bound(offset);
+	if (previous != m_freeByOffset.begin()) {
+		--previous;
+		if (previous->first + previous->second == offset) {
+			offset = previous->first;
+			size += previous->second;
+			eraseFree(previous);
+		}
+	}
+
+	insertFree(offset, size);
+}
+
+unsigned int RangeAllocator::getSize(unsigned int offset) const {
+	auto allocation = m_allocated.find(offset);
+	return allocation != m_allocated.end() ? allocation->second : 0;
+}
+
+unsigned int RangeAllocator::getLargestFreeBlock() const {
+	return m_freeBySize.empty() ? 0 : m_freeBySize.rbegin()->first;
+}
+
+float RangeAllocator::getFragmentation() const {
+	unsigned int freeSpace = m_capacity - m_used;
+	if (freeSpace == 0)
+		return 0;
+
+	return 1.0f - getLargestFreeBlock() / (float)freeSpace;
+}
+
+void RangeAllocator::insertFree(unsigned int offset, unsigned int size) {
+	m_freeByOffset[offset] = size;
+	m_freeBySize.insert(std::make_pair(size, offset));
+}
+
+void RangeAllocator::eraseFree(std::map<unsigned int, unsigned int>::iterator block) {
+
+	// several blocks can share a size, find the one at this offset
+	auto range = m_freeBySize.equal_range(block->second);
+	for (auto it = range.first; it != range.second; ++it) {
+		if (it->second == block->first) {
+			m_freeBySize.erase(it);
+			break;
+		}
+	}
+
+	m_freeByOffset.erase(block);
+}
+
+} // namespace aie
\ No newline at end of file
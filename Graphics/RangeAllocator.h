@@ -0,0 +1,58 @@
+#pragma once
+
+#include <map>
+
+namespace aie {
+
+// hands out ranges of a linear space (such as elements of a gpu buffer) using a
+// best-fit free list. freed ranges are merged with their free neighbours so
+// space can be reused by larger allocations later
+class RangeAllocator {
+public:
+
+	static const unsigned int INVALID = 0xffffffff;
+
+	RangeAllocator();
+
+	// resets to a single free range covering the capacity
+	void reset(unsigned int capacity);
+
+	// adds free space to the end of the range, for when the backing storage grows
+	void grow(unsigned int newCapacity);
+
+	// returns the offset of the smallest free range that fits, or INVALID if none do
+	unsigned int allocate(unsigned int size);
+
+	// returns a range to the free list, offset must have come from allocate
+	void free(unsigned int offset);
+
+	// size of an allocated range
+	unsigned int getSize(unsigned int offset) const;
+
+	// allocated ranges keyed by offset, in order
+	const std::map<unsigned int, unsigned int>& getAllocations() const { return m_allocated; }
+
+	unsigned int getCapacity() const { return m_capacity; }
+	unsigned int getUsed() const { return m_used; }
+	unsigned int getFreeBlockCount() const { return (unsigned int)m_freeByOffset.size(); }
+	unsigned int getLargestFreeBlock() const;
+
+	// 0 when all free space is one block, approaching 1 as it is split in to smaller pieces
+	float getFragmentation() const;
+
+private:
+
+	void insertFree(unsigned int offset, unsigned int size);
+	void eraseFree(std::map<unsigned int, unsigned int>::iterator block);
+
+	unsigned int							m_capacity;
+	unsigned int							m_used;
+
+	// free blocks indexed both ways, by offset to merge neighbours and by size to find the best fit
+	std::map<unsigned int, unsigned int>		m_freeByOffset;
+	std::multimap<unsigned int, unsigned int>	m_freeBySize;
+
+	std::map<unsigned int, unsigned int>		m_allocated;
+};
+
+} // namespace aie
\ No newline at end of file
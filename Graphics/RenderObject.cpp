@@ -24,9 +24,10 @@ mat4 RenderObject::GetProjectionViewMatrix(Camera* camera)
     return camera->GetProjectionViewTransform() * transform;
 }
 
-bool RenderObject::LoadMesh(const char* filename, bool loadTextures, bool flipTextureV)
+bool RenderObject::LoadMesh(const char* filename, bool loadTextures, bool flipTextureV, MeshPool* pool,
+							  TextureStreamer* streamer)
 {
-	if (mesh.load(filename, loadTextures, flipTextureV) == false)
+	if (mesh.load(filename, loadTextures, flipTextureV, pool, streamer) == false)
 	{
 		cout << "Mesh load error" << endl;
 		return false;
@@ -35,7 +36,27 @@ bool RenderObject::LoadMesh(const char* filename, bool loadTextures, bool flipTe
 	return true;
 }
 
+float RenderObject::GetScreenSize(Camera* camera, float screenHeight)
+{
+	// bound the mesh with a sphere, scaled by the largest axis of the transform
+	float scale = glm::max(length(vec3(transform[0])), glm::max(length(vec3(transform[1])), length(vec3(transform[2]))));
+	float radius = mesh.getBoundingRadius() * scale;
+
+	// up close the object fills the screen
+	float distance = length(camera->GetPosition() - GetPosition());
+	if (distance <= radius)
+		return screenHeight;
+
+	// the projection's y scale is 1 / tan(fov / 2), which maps the sphere's size at its distance to the screen
+	return radius / distance * camera->GetProjectionTransform()[1][1] * screenHeight;
+}
+
 void RenderObject::Draw()
 {
 	mesh.draw();
 }
+
+bool RenderObject::Draw(IndirectBatch& batch)
+{
+	return batch.add(mesh, transform);
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include "Camera.h"
+#include "IndirectBatch.h"
 #include "OBJMesh.h"
 #include <glm/matrix.hpp>
 
@@ -11,13 +12,26 @@ public:
 	RenderObject();
 	~RenderObject() {}
 
+	// moves along with its mesh
+	RenderObject(RenderObject&& other) = default;
+	RenderObject& operator=(RenderObject&& other) = default;
+
 	mat4 transform = mat4(1);
 	OBJMesh mesh;
 
 	vec3 GetPosition();
 	mat4 GetProjectionViewMatrix(Camera* camera);
 
-	bool LoadMesh(const char* filename, bool loadTextures = true, bool flipTextureV = false);
+	// meshes loaded in to a pool can also be drawn through an IndirectBatch,
+	// and meshes loaded with a streamer stream their textures' mips
+	bool LoadMesh(const char* filename, bool loadTextures = true, bool flipTextureV = false, MeshPool* pool = nullptr,
+				  TextureStreamer* streamer = nullptr);
+
+	// roughly how many pixels tall the object appears on a screen of the given height
+	float GetScreenSize(Camera* camera, float screenHeight);
 
 	virtual void Draw();
+
+	// queues the mesh in a multi-draw-indirect batch instead, the mesh must be in the batch's pool
+	bool Draw(IndirectBatch& batch);
 };
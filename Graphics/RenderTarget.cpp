@@ -7,21 +7,14 @@ namespace aie {
 RenderTarget::RenderTarget()
 	: m_width(0),
 	m_height(0),
-	m_targetCount(0),
-	m_targets(nullptr),
-	m_depthTarget(0),
-	m_fbo(0),
-	m_rbo(0)
+	m_targetCount(0)
 {
 }
 
 RenderTarget::RenderTarget(unsigned int targetCount, unsigned int width, unsigned int height)
 	: m_width(0),
 	m_height(0),
-	m_targetCount(0),
-	m_targets(nullptr),
-    m_depthTarget(0),
-    m_rbo(0)
+	m_targetCount(0)
 {
 	initialise(targetCount, width, height);
 }
@@ -29,11 +22,11 @@ RenderTarget::RenderTarget(unsigned int targetCount, unsigned int width, unsigne
 bool RenderTarget::initialise(unsigned int targetCount, unsigned int width, unsigned int height,bool use_depth_texture) {
 
 	// setup and bind a framebuffer object
-	glGenFramebuffers(1, &m_fbo);
+	glGenFramebuffers(1, m_fbo.put());
 	glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
 
     if (use_depth_texture) {
-        glGenTextures(1, &m_depthTarget);
+        glGenTextures(1, m_depthTarget.put());
         glBindTexture(GL_TEXTURE_2D, m_depthTarget);
         glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
 
@@ -45,7 +38,7 @@ bool RenderTarget::initialise(unsigned int targetCount, unsigned int width, unsi
         glBindTexture(GL_TEXTURE_2D, 0);
     }
     else { // setup and bind a 24bit depth buffer as a render buffer
-        glGenRenderbuffers(1, &m_rbo);
+        glGenRenderbuffers(1, m_rbo.put());
         glBindRenderbuffer(GL_RENDERBUFFER, m_rbo);
         glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24,
             width, height);
@@ -55,7 +48,7 @@ bool RenderTarget::initialise(unsigned int targetCount, unsigned int width, unsi
 	// create and attach textures
 	if (targetCount > 0) {
 
-		m_targets = new Texture[targetCount];
+		m_targets.resize(targetCount);
 
 		std::vector<GLenum> drawBuffers = {};
 
@@ -76,16 +69,10 @@ bool RenderTarget::initialise(unsigned int targetCount, unsigned int width, unsi
 
 		// cleanup
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		delete[] m_targets;
-		m_targets = nullptr;
-        if(m_depthTarget)
-            glDeleteTextures(1, &m_depthTarget);
-        else
-		    glDeleteRenderbuffers(1, &m_rbo);
-        
-		glDeleteFramebuffers(1, &m_fbo);
-		m_rbo = 0;
-		m_fbo = 0;
+		m_targets.clear();
+		m_depthTarget.reset();
+		m_rbo.reset();
+		m_fbo.reset();
 
 		return false;
 	}
@@ -99,15 +86,6 @@ bool RenderTarget::initialise(unsigned int targetCount, unsigned int width, unsi
 	return true;
 }
 
-RenderTarget::~RenderTarget() {
-	delete[] m_targets;
-    if (m_depthTarget)
-        glDeleteTextures(1, &m_depthTarget);
-    else
-    	glDeleteRenderbuffers(1, &m_rbo);
-	glDeleteFramebuffers(1, &m_fbo);
-}
-
 void RenderTarget::bind() {
 	glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
 }
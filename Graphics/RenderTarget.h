@@ -1,6 +1,8 @@
 #pragma once
 
+#include "GLHandle.h"
 #include "Texture.h"
+#include <vector>
 
 namespace aie {
 	
@@ -9,7 +11,13 @@ public:
 
 	RenderTarget();
 	RenderTarget(unsigned int targetCount, unsigned int width, unsigned int height);
-	virtual ~RenderTarget();
+	virtual ~RenderTarget() {}
+
+	// render targets can be moved but not copied, as only one can own the framebuffer
+	RenderTarget(const RenderTarget&) = delete;
+	RenderTarget& operator = (const RenderTarget&) = delete;
+	RenderTarget(RenderTarget&& other) = default;
+	RenderTarget& operator = (RenderTarget&& other) = default;
 
 	bool initialise(unsigned int targetCount, unsigned int width, unsigned int height,bool use_depth = false);
 
@@ -30,12 +38,12 @@ protected:
 	unsigned int	m_width;
 	unsigned int	m_height;
 
-	unsigned int	m_fbo;
-	unsigned int	m_rbo;
+	FramebufferHandle	m_fbo;
+	RenderbufferHandle	m_rbo;
 
-	unsigned int	m_targetCount;
-	Texture*		m_targets;
-    unsigned int    m_depthTarget;
+	unsigned int			m_targetCount;
+	std::vector<Texture>	m_targets;
+	TextureHandle			m_depthTarget;
 };
 
 } // namespace aie
\ No newline at end of file
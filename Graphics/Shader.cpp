@@ -1,60 +1,62 @@
 #include "Shader.h"
+#include <algorithm>
 #include <cstdio>
 #include <cassert>
+#include <cstring>
 #include "gl_core_4_4.h"
+#include "GLState.h"
+#include "ProgramCache.h"
 
 namespace aie {
 
-Shader::~Shader() {
-	glDeleteShader(m_handle);
-}
-
-bool Shader::loadShader(unsigned int stage, const char* filename) {
-	assert(stage > 0 && stage < eShaderStage::SHADER_STAGE_Count);
-
-	m_stage = stage;
-
-	switch (stage) {
-	case eShaderStage::VERTEX:	m_handle = glCreateShader(GL_VERTEX_SHADER);	break;
-	case eShaderStage::TESSELLATION_EVALUATION:	m_handle = glCreateShader(GL_TESS_EVALUATION_SHADER);	break;
-	case eShaderStage::TESSELLATION_CONTROL:	m_handle = glCreateShader(GL_TESS_CONTROL_SHADER);	break;
-	case eShaderStage::GEOMETRY:	m_handle = glCreateShader(GL_GEOMETRY_SHADER);	break;
-	case eShaderStage::FRAGMENT:	m_handle = glCreateShader(GL_FRAGMENT_SHADER);	break;
-	default:	break;
-	};
-	
-	// open file
+static bool readFile(const char* filename, std::string& contents) {
 	FILE* file = nullptr;
 	fopen_s(&file, filename, "rb");
+	if (file == nullptr) {
+		printf("Shader file [%s] could not be opened!\n", filename);
+		return false;
+	}
+
 	fseek(file, 0, SEEK_END);
 	unsigned int size = ftell(file);
-	char* source = new char[size + 1];
 	fseek(file, 0, SEEK_SET);
-	fread_s(source, size + 1, sizeof(char), size, file);
+
+	contents.resize(size);
+	fread_s(&contents[0], size, sizeof(char), size, file);
 	fclose(file);
-	source[size] = 0;
+	return true;
+}
 
-	glShaderSource(m_handle, 1, (const char**)&source, 0);
-	glCompileShader(m_handle);
+// from KHR_parallel_shader_compile, which the core 4.4 loader doesn't know about
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
 
-	delete[] source;
+int ShaderProgram::sm_parallelCompile = -1;
+ShaderProgram* ShaderProgram::sm_bound = nullptr;
+unsigned int ShaderProgram::sm_linkCount = 0;
+unsigned int ShaderProgram::sm_uniformUploads = 0;
+unsigned int ShaderProgram::sm_uniformSkips = 0;
 
-	int success = GL_TRUE;
-	glGetShaderiv(m_handle, GL_LINK_STATUS, &success);
-	if (success == GL_FALSE) {
-		int infoLogLength = 0;
-		glGetShaderiv(m_handle, GL_INFO_LOG_LENGTH, &infoLogLength);
+Shader::~Shader() {
+	delete[] m_lastError;
+	glDeleteShader(m_handle);
+}
 
-		delete[] m_lastError;
-		m_lastError = new char[infoLogLength];
-		glGetShaderInfoLog(m_handle, infoLogLength, 0, m_lastError);
+bool Shader::loadShader(unsigned int stage, const char* filename) {
+	std::string source;
+	if (readFile(filename, source) == false)
 		return false;
-	}
 
-	return true;
+	return createShader(stage, source.c_str());
 }
 
 bool Shader::createShader(unsigned int stage, const char* string) {
+	compileShader(stage, string);
+	return checkCompileStatus();
+}
+
+void Shader::compileShader(unsigned int stage, const char* string) {
 	assert(stage > 0 && stage < eShaderStage::SHADER_STAGE_Count);
 
 	m_stage = stage;
@@ -68,17 +70,22 @@ bool Shader::createShader(unsigned int stage, const char* string) {
 	default:	break;
 	};
 
+	m_source = string;
+
 	glShaderSource(m_handle, 1, (const char**)&string, 0);
 	glCompileShader(m_handle);
-	
+}
+
+bool Shader::checkCompileStatus() {
 	int success = GL_TRUE;
-	glGetShaderiv(m_handle, GL_LINK_STATUS, &success);
+	glGetShaderiv(m_handle, GL_COMPILE_STATUS, &success);
 	if (success == GL_FALSE) {
 		int infoLogLength = 0;
 		glGetShaderiv(m_handle, GL_INFO_LOG_LENGTH, &infoLogLength);
 
 		delete[] m_lastError;
-		m_lastError = new char[infoLogLength];
+		m_lastError = new char[infoLogLength + 1];
+		m_lastError[0] = 0;
 		glGetShaderInfoLog(m_handle, infoLogLength, 0, m_lastError);
 		return false;
 	}
@@ -87,233 +94,560 @@ bool Shader::createShader(unsigned int stage, const char* string) {
 }
 
 ShaderProgram::~ShaderProgram() {
+	if (sm_bound == this)
+		sm_bound = nullptr;
+
 	delete[] m_lastError;
 	glDeleteProgram(m_program);
 }
 
 bool ShaderProgram::loadShader(unsigned int stage, const char* filename) {
 	assert(stage > 0 && stage < eShaderStage::SHADER_STAGE_Count);
-	m_shaders[stage] = std::make_shared<Shader>();
-	return m_shaders[stage]->loadShader(stage, filename);
+	m_shaders[stage] = nullptr;
+	return readFile(filename, m_sources[stage]);
 }
 
 bool ShaderProgram::createShader(unsigned int stage, const char* string) {
 	assert(stage > 0 && stage < eShaderStage::SHADER_STAGE_Count);
-	m_shaders[stage] = std::make_shared<Shader>();
-	return m_shaders[stage]->createShader(stage, string);
+	m_shaders[stage] = nullptr;
+	m_sources[stage] = string;
+	return true;
 }
 
 void ShaderProgram::attachShader(const std::shared_ptr<Shader>& shader) {
 	assert(shader != nullptr);
 	m_shaders[shader->getStage()] = shader;
+	m_sources[shader->getStage()].clear();
+}
+
+void ShaderProgram::setDefines(const ShaderDefines& defines) {
+	assert(m_state == LinkState::Unlinked && "Shader program already linked");
+
+	m_defines.clear();
+	for (auto& define : defines)
+		m_defines += "#define " + define.first + " " + std::to_string(define.second) + "\n";
+}
+
+// puts the defines after the #version directive, which has to come before anything else
+static std::string injectDefines(const std::string& source, const std::string& defines) {
+	if (defines.empty())
+		return source;
+
+	size_t version = source.find("#version");
+	if (version == std::string::npos)
+		return defines + source;
+
+	size_t lineEnd = source.find('\n', version);
+	if (lineEnd == std::string::npos)
+		return source + "\n" + defines;
+
+	// keep the line numbers in errors matching the file
+	return source.substr(0, lineEnd + 1) + defines + "#line " +
+		std::to_string(std::count(source.begin(), source.begin() + lineEnd + 1, '\n') + 1) + "\n" +
+		source.substr(lineEnd + 1);
 }
 
 bool ShaderProgram::link() {
+	if (m_state == LinkState::Unlinked)
+		beginLink();
+	if (m_state == LinkState::Pending)
+		finishLink();
+	return m_state == LinkState::Linked;
+}
+
+void ShaderProgram::beginLink() {
+	assert(m_state == LinkState::Unlinked && "Shader program already linked");
+
+	if (sm_parallelCompile < 0) {
+		sm_parallelCompile = 0;
+
+		int extensionCount = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+		for (int i = 0; i < extensionCount; ++i) {
+			const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+			if (strcmp(extension, "GL_KHR_parallel_shader_compile") == 0 ||
+				strcmp(extension, "GL_ARB_parallel_shader_compile") == 0)
+				sm_parallelCompile = 1;
+		}
+	}
+
+	// key the cached binary on every stage's source and the defines
+	m_cacheKey = ProgramCache::hash(m_defines.c_str());
+	for (unsigned int stage = 0; stage < eShaderStage::SHADER_STAGE_Count; ++stage) {
+		if (m_shaders[stage] == nullptr &&
+			m_sources[stage].empty())
+			continue;
+
+		m_cacheKey = ProgramCache::hash(&stage, sizeof(stage), m_cacheKey);
+		m_cacheKey = ProgramCache::hash(m_shaders[stage] != nullptr ? m_shaders[stage]->getSource() : m_sources[stage].c_str(), m_cacheKey);
+	}
+
 	m_program = glCreateProgram();
+	if (ProgramCache::load(m_program, m_cacheKey)) {
+		reflectUniforms();
+		m_state = LinkState::Linked;
+		return;
+	}
+
+	// compile any stages still waiting as source, without waiting on the results
+	for (unsigned int stage = 0; stage < eShaderStage::SHADER_STAGE_Count; ++stage) {
+		if (m_sources[stage].empty())
+			continue;
+
+		m_shaders[stage] = std::make_shared<Shader>();
+		m_shaders[stage]->compileShader(stage, injectDefines(m_sources[stage], m_defines).c_str());
+		m_sources[stage].clear();
+	}
+
 	for (auto& s : m_shaders)
 		if (s != nullptr)
 			glAttachShader(m_program, s->getHandle());
+	glProgramParameteri(m_program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 	glLinkProgram(m_program);
 
+	m_state = LinkState::Pending;
+}
+
+bool ShaderProgram::isReady() {
+	if (m_state == LinkState::Pending) {
+
+		// without the extension there is no way to ask, so this waits
+		if (sm_parallelCompile > 0) {
+			int complete = GL_FALSE;
+			glGetProgramiv(m_program, GL_COMPLETION_STATUS_KHR, &complete);
+			if (complete == GL_FALSE)
+				return false;
+		}
+
+		finishLink();
+	}
+
+	return m_state == LinkState::Linked;
+}
+
+void ShaderProgram::finishLink() {
 	int success = GL_TRUE;
 	glGetProgramiv(m_program, GL_LINK_STATUS, &success);
 	if (success == GL_FALSE) {
+		m_state = LinkState::Failed;
+
+		// a stage that failed to compile gives a more useful error than the link
+		for (auto& s : m_shaders) {
+			if (s != nullptr &&
+				s->checkCompileStatus() == false) {
+				setLastError(s->getLastError());
+				return;
+			}
+		}
+
 		int infoLogLength = 0;
 		glGetProgramiv(m_program, GL_INFO_LOG_LENGTH, &infoLogLength);
 
 		delete[] m_lastError;
 		m_lastError = new char[infoLogLength + 1];
+		m_lastError[0] = 0;
 		glGetProgramInfoLog(m_program, infoLogLength, 0, m_lastError);
-		return false;
+		return;
 	}
-	return true;
+
+	ProgramCache::store(m_program, m_cacheKey);
+
+	reflectUniforms();
+	m_state = LinkState::Linked;
+}
+
+void ShaderProgram::setLastError(const char* error) {
+	delete[] m_lastError;
+	m_lastError = new char[strlen(error) + 1];
+	strcpy(m_lastError, error);
 }
 
 void ShaderProgram::bind() {
 	assert(m_program > 0 && "Invalid shader program");
-	glUseProgram(m_program);
+	GLState::useProgram(m_program);
+	sm_bound = this;
+}
+
+ShaderProgram* ShaderProgram::getBound() {
+
+	// anything else using a program through GLState leaves this one no longer bound
+	if (sm_bound != nullptr &&
+		sm_bound->m_program != GLState::getProgram())
+		sm_bound = nullptr;
+	return sm_bound;
+}
+
+void ShaderProgram::reflectUniforms() {
+	m_linkID = ++sm_linkCount;
+	m_uniforms.clear();
+	m_uniformIndices.clear();
+	m_missingUniforms.clear();
+	m_uniformData.clear();
+
+	int count = 0, maxLength = 0;
+	glGetProgramiv(m_program, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+	std::vector<char> buffer(maxLength + 1);
+
+	for (int i = 0; i < count; ++i) {
+		int size = 0;
+		unsigned int glType = 0;
+		glGetActiveUniform(m_program, i, (int)buffer.size(), nullptr, &size, &glType, buffer.data());
+
+		// uniforms in blocks have no location
+		int location = glGetUniformLocation(m_program, buffer.data());
+		if (location < 0)
+			continue;
+
+		UniformType type = UniformType::Unsupported;
+		switch (glType) {
+		case GL_FLOAT:		type = UniformType::Float;	break;
+		case GL_FLOAT_VEC2:	type = UniformType::Vec2;	break;
+		case GL_FLOAT_VEC3:	type = UniformType::Vec3;	break;
+		case GL_FLOAT_VEC4:	type = UniformType::Vec4;	break;
+		case GL_FLOAT_MAT2:	type = UniformType::Mat2;	break;
+		case GL_FLOAT_MAT3:	type = UniformType::Mat3;	break;
+		case GL_FLOAT_MAT4:	type = UniformType::Mat4;	break;
+		case GL_INT:
+		case GL_BOOL:		type = UniformType::Int;	break;
+		case GL_INT_VEC2: case GL_INT_VEC3: case GL_INT_VEC4:
+		case GL_BOOL_VEC2: case GL_BOOL_VEC3: case GL_BOOL_VEC4:
+		case GL_UNSIGNED_INT: case GL_UNSIGNED_INT_VEC2: case GL_UNSIGNED_INT_VEC3: case GL_UNSIGNED_INT_VEC4:
+		case GL_DOUBLE: case GL_DOUBLE_VEC2: case GL_DOUBLE_VEC3: case GL_DOUBLE_VEC4:
+		case GL_FLOAT_MAT2x3: case GL_FLOAT_MAT2x4: case GL_FLOAT_MAT3x2:
+		case GL_FLOAT_MAT3x4: case GL_FLOAT_MAT4x2: case GL_FLOAT_MAT4x3:
+			break;
+
+		// anything else is a sampler or image, set by unit like an int
+		default:			type = UniformType::Int;	break;
+		};
+
+		// arrays are reported by their first element, register them both with and without it
+		std::string name = buffer.data();
+		size_t bracket = name.rfind("[0]");
+		bool isArray = bracket != std::string::npos && bracket + 3 == name.size();
+		if (isArray)
+			name.erase(bracket);
+
+		unsigned int dataOffset = (unsigned int)m_uniformData.size();
+		addUniform(name, location, type, size, dataOffset);
+		if (isArray) {
+			m_uniformIndices[ProgramCache::hash((name + "[0]").c_str())] = (int)m_uniforms.size() - 1;
+
+			unsigned int elementSize = m_uniforms.back().elementSize;
+			for (int element = 1; element < size; ++element) {
+				std::string elementName = name + "[" + std::to_string(element) + "]";
+				int elementLocation = glGetUniformLocation(m_program, elementName.c_str());
+				addUniform(elementName, elementLocation, type, size - element, dataOffset + element * elementSize);
+			}
+		}
+	}
 }
 
-int ShaderProgram::getUniform(const char* name) {
-	return glGetUniformLocation(m_program, name);
+void ShaderProgram::addUniform(const std::string& name, int location, UniformType type, int arraySize, unsigned int dataOffset) {
+	Uniform uniform;
+	uniform.name = name;
+	uniform.location = location;
+	uniform.type = type;
+	uniform.arraySize = arraySize;
+	uniform.dataOffset = dataOffset;
+	uniform.warned = false;
+
+	switch (type) {
+	case UniformType::Int:		uniform.elementSize = sizeof(int);			break;
+	case UniformType::Float:	uniform.elementSize = sizeof(float);		break;
+	case UniformType::Vec2:		uniform.elementSize = sizeof(glm::vec2);	break;
+	case UniformType::Vec3:		uniform.elementSize = sizeof(glm::vec3);	break;
+	case UniformType::Vec4:		uniform.elementSize = sizeof(glm::vec4);	break;
+	case UniformType::Mat2:		uniform.elementSize = sizeof(glm::mat2);	break;
+	case UniformType::Mat3:		uniform.elementSize = sizeof(glm::mat3);	break;
+	case UniformType::Mat4:		uniform.elementSize = sizeof(glm::mat4);	break;
+	default:					uniform.elementSize = 0;					break;
+	};
+
+	// seed the shadow with what the program holds after linking, including initialisers
+	unsigned int end = dataOffset + arraySize * uniform.elementSize;
+	if (end > m_uniformData.size())
+		m_uniformData.resize(end);
+
+	if (uniform.elementSize > 0 &&
+		location >= 0) {
+		void* data = &m_uniformData[dataOffset];
+		if (type == UniformType::Int)
+			glGetUniformiv(m_program, location, (int*)data);
+		else
+			glGetUniformfv(m_program, location, (float*)data);
+	}
+
+	m_uniformIndices[ProgramCache::hash(name.c_str())] = (int)m_uniforms.size();
+	m_uniforms.push_back(uniform);
 }
 
-bool ShaderProgram::bindUniform(const char* name, int value) {
-	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
+int ShaderProgram::findUniform(const char* name) const {
+	auto iter = m_uniformIndices.find(ProgramCache::hash(name));
+	if (iter == m_uniformIndices.end())
+		return -1;
+
+	// a different name with the same hash isn't a match
+	const std::string& found = m_uniforms[iter->second].name;
+	if (strncmp(found.c_str(), name, found.size()) != 0 ||
+		(name[found.size()] != 0 && strcmp(name + found.size(), "[0]") != 0))
+		return -1;
+	return iter->second;
+}
+
+int ShaderProgram::lookupUniform(const char* name) {
+	int index = findUniform(name);
+	if (index < 0 &&
+		m_missingUniforms.insert(name).second)
 		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+	return index;
+}
+
+bool ShaderProgram::shadowUniform(int index, UniformType type, int count, const void* value) {
+	Uniform& uniform = m_uniforms[index];
+
+	if (uniform.type != type) {
+		if (uniform.warned == false) {
+			printf("Shader uniform [%s] bound with the wrong type!\n", uniform.name.c_str());
+			uniform.warned = true;
+		}
+		return false;
+	}
+
+	assert(count <= uniform.arraySize && "Too many values for shader uniform");
+
+	unsigned char* shadow = &m_uniformData[uniform.dataOffset];
+	size_t size = count * uniform.elementSize;
+	if (memcmp(shadow, value, size) == 0) {
+		sm_uniformSkips++;
 		return false;
 	}
-	glUniform1i(i, value);
+
+	memcpy(shadow, value, size);
+	sm_uniformUploads++;
 	return true;
 }
 
+bool ShaderProgram::setUniform(int index, int count, const int* value) {
+	if (shadowUniform(index, UniformType::Int, count, value))
+		glProgramUniform1iv(m_program, m_uniforms[index].location, count, value);
+	return m_uniforms[index].type == UniformType::Int;
+}
+
+bool ShaderProgram::setUniform(int index, int count, const float* value) {
+	if (shadowUniform(index, UniformType::Float, count, value))
+		glProgramUniform1fv(m_program, m_uniforms[index].location, count, value);
+	return m_uniforms[index].type == UniformType::Float;
+}
+
+bool ShaderProgram::setUniform(int index, int count, const glm::vec2* value) {
+	if (shadowUniform(index, UniformType::Vec2, count, value))
+		glProgramUniform2fv(m_program, m_uniforms[index].location, count, (const float*)value);
+	return m_uniforms[index].type == UniformType::Vec2;
+}
+
+bool ShaderProgram::setUniform(int index, int count, const glm::vec3* value) {
+	if (shadowUniform(index, UniformType::Vec3, count, value))
+		glProgramUniform3fv(m_program, m_uniforms[index].location, count, (const float*)value);
+	return m_uniforms[index].type == UniformType::Vec3;
+}
+
+bool ShaderProgram::setUniform(int index, int count, const glm::vec4* value) {
+	if (shadowUniform(index, UniformType::Vec4, count, value))
+		glProgramUniform4fv(m_program, m_uniforms[index].location, count, (const float*)value);
+	return m_uniforms[index].type == UniformType::Vec4;
+}
+
+bool ShaderProgram::setUniform(int index, int count, const glm::mat2* value) {
+	if (shadowUniform(index, UniformType::Mat2, count, value))
+		glProgramUniformMatrix2fv(m_program, m_uniforms[index].location, count, GL_FALSE, (const float*)value);
+	return m_uniforms[index].type == UniformType::Mat2;
+}
+
+bool ShaderProgram::setUniform(int index, int count, const glm::mat3* value) {
+	if (shadowUniform(index, UniformType::Mat3, count, value))
+		glProgramUniformMatrix3fv(m_program, m_uniforms[index].location, count, GL_FALSE, (const float*)value);
+	return m_uniforms[index].type == UniformType::Mat3;
+}
+
+bool ShaderProgram::setUniform(int index, int count, const glm::mat4* value) {
+	if (shadowUniform(index, UniformType::Mat4, count, value))
+		glProgramUniformMatrix4fv(m_program, m_uniforms[index].location, count, GL_FALSE, (const float*)value);
+	return m_uniforms[index].type == UniformType::Mat4;
+}
+
+int ShaderProgram::getUniform(const char* name) {
+	int index = findUniform(name);
+	return index >= 0 ? m_uniforms[index].location : -1;
+}
+
+bool ShaderProgram::bindUniform(const char* name, int value) {
+	assert(m_program > 0 && "Invalid shader program");
+	int index = lookupUniform(name);
+	if (index < 0)
+		return false;
+	return setUniform(index, 1, &value);
+}
+
 bool ShaderProgram::bindUniform(const char* name, float value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+	int index = lookupUniform(name);
+	if (index < 0)
 		return false;
-	}
-	glUniform1f(i, value);
-	return true;
+	return setUniform(index, 1, &value);
 }
 
 bool ShaderProgram::bindUniform(const char* name, const glm::vec2& value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+	int index = lookupUniform(name);
+	if (index < 0)
 		return false;
-	}
-	glUniform2f(i, value.x, value.y);
-	return true;
+	return setUniform(index, 1, &value);
 }
 
 bool ShaderProgram::bindUniform(const char* name, const glm::vec3& value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+	int index = lookupUniform(name);
+	if (index < 0)
 		return false;
-	}
-	glUniform3f(i, value.x, value.y, value.z);
-	return true;
+	return setUniform(index, 1, &value);
 }
 
 bool ShaderProgram::bindUniform(const char* name, const glm::vec4& value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+	int index = lookupUniform(name);
+	if (index < 0)
 		return false;
-	}
-	glUniform4f(i, value.x, value.y, value.z, value.w);
-	return true;
+	return setUniform(index, 1, &value);
 }
 
 bool ShaderProgram::bindUniform(const char* name, const glm::mat2& value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+	int index = lookupUniform(name);
+	if (index < 0)
 		return false;
-	}
-	glUniformMatrix2fv(i, 1, GL_FALSE, &value[0][0]);
-	return true;
+	return setUniform(index, 1, &value);
 }
 
 bool ShaderProgram::bindUniform(const char* name, const glm::mat3& value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+	int index = lookupUniform(name);
+	if (index < 0)
 		return false;
-	}
-	glUniformMatrix3fv(i, 1, GL_FALSE, &value[0][0]);
-	return true;
+	return setUniform(index, 1, &value);
 }
 
 bool ShaderProgram::bindUniform(const char* name, const glm::mat4& value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+	int index = lookupUniform(name);
+	if (index < 0)
 		return false;
-	}
-	glUniformMatrix4fv(i, 1, GL_FALSE, &value[0][0]);
-	return true;
+	return setUniform(index, 1, &value);
 }
 
 bool ShaderProgram::bindUniform(const char* name, int count, int* value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+	int index = lookupUniform(name);
+	if (index < 0)
 		return false;
-	}
-	glUniform1iv(i, count, value);
-	return true;
+	return setUniform(index, count, value);
 }
 
 bool ShaderProgram::bindUniform(const char* name, int count, float* value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+	int index = lookupUniform(name);
+	if (index < 0)
 		return false;
-	}
-	glUniform1fv(i, count, value);
-	return true;
+	return setUniform(index, count, value);
 }
 
 bool ShaderProgram::bindUniform(const char* name, int count, const glm::vec2* value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+	int index = lookupUniform(name);
+	if (index < 0)
 		return false;
-	}
-	glUniform2fv(i, count, (float*)value);
-	return true;
+	return setUniform(index, count, value);
 }
 
 bool ShaderProgram::bindUniform(const char* name, int count, const glm::vec3* value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+	int index = lookupUniform(name);
+	if (index < 0)
 		return false;
-	}
-	glUniform3fv(i, count, (float*)value);
-	return true;
+	return setUniform(index, count, value);
 }
 
 bool ShaderProgram::bindUniform(const char* name, int count, const glm::vec4* value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+	int index = lookupUniform(name);
+	if (index < 0)
 		return false;
-	}
-	glUniform4fv(i, count, (float*)value);
-	return true;
+	return setUniform(index, count, value);
 }
 
 bool ShaderProgram::bindUniform(const char* name, int count, const glm::mat2* value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+	int index = lookupUniform(name);
+	if (index < 0)
 		return false;
-	}
-	glUniformMatrix2fv(i, count, GL_FALSE, (float*)value);
-	return true;
+	return setUniform(index, count, value);
 }
 
 bool ShaderProgram::bindUniform(const char* name, int count, const glm::mat3* value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+	int index = lookupUniform(name);
+	if (index < 0)
 		return false;
-	}
-	glUniformMatrix3fv(i, count, GL_FALSE, (float*)value);
-	return true;
+	return setUniform(index, count, value);
 }
 
 bool ShaderProgram::bindUniform(const char* name, int count, const glm::mat4* value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+	int index = lookupUniform(name);
+	if (index < 0)
 		return false;
-	}
-	glUniformMatrix4fv(i, count, GL_FALSE, (float*)value);
+	return setUniform(index, count, value);
+}
+
+bool ShaderPermutations::loadShader(unsigned int stage, const char* filename) {
+	assert(stage > 0 && stage < eShaderStage::SHADER_STAGE_Count);
+	assert(m_programs.empty() && "Shader permutations already in use");
+	return readFile(filename, m_sources[stage]);
+}
+
+bool ShaderPermutations::createShader(unsigned int stage, const char* string) {
+	assert(stage > 0 && stage < eShaderStage::SHADER_STAGE_Count);
+	assert(m_programs.empty() && "Shader permutations already in use");
+	m_sources[stage] = string;
 	return true;
 }
 
+ShaderProgram& ShaderPermutations::get(const ShaderDefines& defines) {
+	auto iter = m_programs.find(defines);
+	if (iter != m_programs.end())
+		return *iter->second;
+
+	ShaderProgram* program = new ShaderProgram();
+	for (unsigned int stage = 0; stage < eShaderStage::SHADER_STAGE_Count; ++stage)
+		if (m_sources[stage].empty() == false)
+			program->createShader(stage, m_sources[stage].c_str());
+	program->setDefines(defines);
+	program->beginLink();
+
+	m_programs[defines].reset(program);
+	return *program;
+}
+
+ShaderProgram* ShaderPermutations::getFailed() {
+	for (auto& program : m_programs)
+		if (program.second->isReady() == false &&
+			program.second->hasFailed())
+			return program.second.get();
+	return nullptr;
+}
+
 void ShaderProgram::bindUniform(int ID, int value) {
 	assert(m_program > 0 && "Invalid shader program");
 	assert(ID >= 0 && "Invalid shader uniform");
@@ -6,7 +6,12 @@
 #include <glm/mat2x2.hpp>
 #include <glm/mat3x3.hpp>
 #include <glm/mat4x4.hpp>
+#include <map>
 #include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 namespace aie {
 
@@ -23,6 +28,9 @@ enum eShaderStage : unsigned int {
 	SHADER_STAGE_Count,
 };
 
+// preprocessor defines for a shader permutation, by name. ordered so that equal sets compare equal
+typedef std::map<std::string, int> ShaderDefines;
+
 // individual sharable shader stages
 class Shader {
 public:
@@ -37,9 +45,17 @@ public:
 	bool loadShader(unsigned int stage, const char* filename);
 	bool createShader(unsigned int stage, const char* string);
 
+	// issues the compile without waiting on it, so several shaders can compile at once.
+	// checkCompileStatus() waits for the result
+	void compileShader(unsigned int stage, const char* string);
+	bool checkCompileStatus();
+
 	unsigned int getStage() const { return m_stage; }
 	unsigned int getHandle() const { return m_handle; }
 
+	// the source the shader was compiled from
+	const char* getSource() const { return m_source.c_str(); }
+
 	const char* getLastError() const { return m_lastError; }
 
 protected:
@@ -47,31 +63,105 @@ protected:
 	unsigned int	m_stage;
 	unsigned int	m_handle;
 	char*			m_lastError;
+	std::string		m_source;
+};
+
+// refers to an active uniform reflected from a linked ShaderProgram, typed by the value it takes.
+// handles for uniforms the program doesn't use are invalid, and binding them does nothing
+template <typename T>
+class UniformHandle {
+public:
+
+	typedef T ValueType;
+
+	UniformHandle() : m_index(-1) {}
+
+	bool isValid() const { return m_index >= 0; }
+
+private:
+
+	friend class ShaderProgram;
+
+	explicit UniformHandle(int index) : m_index(index) {}
+
+	int		m_index;
 };
 
 // combines shaders together into a single program for the GPU
 class ShaderProgram {
 public:
 
-	ShaderProgram() : m_program(0), m_lastError(nullptr) {
+	ShaderProgram() : m_program(0), m_lastError(nullptr), m_state(LinkState::Unlinked), m_cacheKey(0), m_linkID(0) {
 		m_shaders[0] = m_shaders[1] = m_shaders[2] = m_shaders[3] = m_shaders[4] = 0;
 	}
 	~ShaderProgram();
 
+	// stages given as source are only compiled when linking, and only if the
+	// linked program can't be loaded from the program cache instead
 	bool loadShader(unsigned int stage, const char* filename);
 	bool createShader(unsigned int stage, const char* string);
 	void attachShader(const std::shared_ptr<Shader>& shader);
 
+	// defines injected after the #version line of every stage given as source, set before linking.
+	// stages attached as Shaders are already compiled and don't see them
+	void setDefines(const ShaderDefines& defines);
+
+	// links and waits for the result
 	bool link();
 
+	// issues the compiles and link without waiting on them. begin every program
+	// before checking any of them so the driver can work on them all at once
+	void beginLink();
+
+	// true once linked successfully. doesn't wait on the driver if it supports
+	// KHR_parallel_shader_compile, so a fallback can be drawn with until then
+	bool isReady();
+
+	// true if compiling or linking failed, getLastError() has the reason
+	bool hasFailed() const { return m_state == LinkState::Failed; }
+
 	const char* getLastError() const { return m_lastError; }
 
 	void bind();
 
+	// the program bound through bind(), or nullptr if another program has been bound since
+	static ShaderProgram* getBound();
+
 	unsigned int getHandle() const { return m_program; }
 
+	// different for every link of every program, so handles cached against it can't be
+	// mistaken for another program's, even one given the same address or gl name. 0 until linked
+	unsigned int getLinkID() const { return m_linkID; }
+
+	// location of an active uniform, or -1 if the program doesn't use it
 	int getUniform(const char* name);
 
+	// typed handle to an active uniform, looked up once rather than by name every bind
+	template <typename T>
+	UniformHandle<T> getUniformHandle(const char* name) const {
+		return UniformHandle<T>(findUniform(name));
+	}
+
+	// uploads only if the value differs from what the program already holds.
+	// these don't need the program to be bound
+	template <typename T>
+	void bindUniform(UniformHandle<T> handle, const typename UniformHandle<T>::ValueType& value) {
+		if (handle.isValid())
+			setUniform(handle.m_index, 1, &value);
+	}
+	template <typename T>
+	void bindUniform(UniformHandle<T> handle, int count, const typename UniformHandle<T>::ValueType* value) {
+		if (handle.isValid())
+			setUniform(handle.m_index, count, value);
+	}
+
+	// driver uniform uploads made, and those skipped because the value hadn't changed
+	static unsigned int getUniformUploadCount() { return sm_uniformUploads; }
+	static unsigned int getUniformSkipCount() { return sm_uniformSkips; }
+	static void resetUniformStats() { sm_uniformUploads = sm_uniformSkips = 0; }
+
+	// these upload straight to the bound program, bypassing the shadowed values
+
 	void bindUniform(int ID, int value);
 	void bindUniform(int ID, float value);
 	void bindUniform(int ID, const glm::vec2& value);
@@ -89,7 +179,7 @@ public:
 	void bindUniform(int ID, int count, const glm::mat3* value);
 	void bindUniform(int ID, int count, const glm::mat4* value);
 
-	// these calls should be avoided, but wraps up opengl a little
+	// looked up in the reflected uniforms, so cheaper than they were but handles are still preferred
 	bool bindUniform(const char* name, int value);
 	bool bindUniform(const char* name, float value);
 	bool bindUniform(const char* name, const glm::vec2& value);
@@ -109,11 +199,119 @@ public:
 
 private:
 
+	enum class LinkState {
+		Unlinked,
+		Pending,
+		Linked,
+		Failed,
+	};
+
+	// reads back the link result once the driver is done
+	void finishLink();
+	void setLastError(const char* error);
+
+	// the uniform value types the shadowed bindUniform calls accept
+	enum class UniformType {
+		Int,
+		Float,
+		Vec2,
+		Vec3,
+		Vec4,
+		Mat2,
+		Mat3,
+		Mat4,
+		Unsupported,
+	};
+
+	// an active uniform, array elements past the first get their own entry so they can
+	// be found by name, sharing the array's shadowed values from their element onwards
+	struct Uniform {
+		std::string		name;
+		int				location;
+		UniformType		type;
+		int				arraySize;
+		unsigned int	dataOffset;
+		unsigned int	elementSize;
+		bool			warned;
+	};
+
+	void reflectUniforms();
+	void addUniform(const std::string& name, int location, UniformType type, int arraySize, unsigned int dataOffset);
+
+	int findUniform(const char* name) const;
+
+	// finds a uniform for the name based calls, warning only once about missing ones
+	int lookupUniform(const char* name);
+
+	// compares against and updates the shadowed values, returning if an upload is needed
+	bool shadowUniform(int index, UniformType type, int count, const void* value);
+
+	bool setUniform(int index, int count, const int* value);
+	bool setUniform(int index, int count, const float* value);
+	bool setUniform(int index, int count, const glm::vec2* value);
+	bool setUniform(int index, int count, const glm::vec3* value);
+	bool setUniform(int index, int count, const glm::vec4* value);
+	bool setUniform(int index, int count, const glm::mat2* value);
+	bool setUniform(int index, int count, const glm::mat3* value);
+	bool setUniform(int index, int count, const glm::mat4* value);
+
 	unsigned int	m_program;
 
 	std::shared_ptr<Shader> m_shaders[eShaderStage::SHADER_STAGE_Count];
 
+	// stages waiting to be compiled
+	std::string		m_sources[eShaderStage::SHADER_STAGE_Count];
+
+	// #define lines for the defines, ready to be injected
+	std::string		m_defines;
+
 	char*			m_lastError;
+
+	LinkState			m_state;
+	unsigned long long	m_cacheKey;
+	unsigned int		m_linkID;
+
+	std::vector<Uniform>					m_uniforms;
+	// keyed on the hash of the name, so looking a name up doesn't build a string. the uniform's
+	// own name is checked on a hit, arrays also being found by their first element
+	std::unordered_map<unsigned long long, int>	m_uniformIndices;
+	std::unordered_set<std::string>			m_missingUniforms;
+
+	// last values uploaded, per uniform
+	std::vector<unsigned char>				m_uniformData;
+
+	// -1 until checked for KHR_parallel_shader_compile
+	static int				sm_parallelCompile;
+
+	static ShaderProgram*	sm_bound;
+	static unsigned int		sm_linkCount;
+	static unsigned int		sm_uniformUploads;
+	static unsigned int		sm_uniformSkips;
+};
+
+// programs built from the same sources with different defines, such as light counts or
+// which textures are present, so each only runs the code it needs instead of branching.
+// a permutation is compiled the first time it's asked for and kept from then on
+class ShaderPermutations {
+public:
+
+	bool loadShader(unsigned int stage, const char* filename);
+	bool createShader(unsigned int stage, const char* string);
+
+	// the program for the defines, beginning its link if it's new.
+	// check isReady() before drawing with it
+	ShaderProgram& get(const ShaderDefines& defines);
+
+	// a permutation that failed to link, or nullptr if none have
+	ShaderProgram* getFailed();
+
+	size_t getCount() const { return m_programs.size(); }
+
+private:
+
+	std::string		m_sources[eShaderStage::SHADER_STAGE_Count];
+
+	std::map<ShaderDefines, std::unique_ptr<ShaderProgram>>	m_programs;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+#include <cstddef>
+
+namespace aie {
+
+// uniform buffer binding points shared by every shader program,
+// these must match the binding qualifiers on the blocks in the shaders
+enum eUniformBlock : unsigned int {
+	CAMERA_BLOCK = 0,
+	LIGHTS_BLOCK,
+
+	UNIFORM_BLOCK_Count,
+};
+
+// base alignment of a block member under the std140 rules. vec3 aligns like a vec4 and
+// matrices like arrays of vec4 columns. mat3 and arrays of scalars are padded out per
+// column or element, so they are left undefined to fail the checks rather than mismatch
+template <typename T> struct Std140 {};
+template <> struct Std140<float>		{ enum { alignment = 4 }; };
+template <> struct Std140<int>			{ enum { alignment = 4 }; };
+template <> struct Std140<unsigned int>	{ enum { alignment = 4 }; };
+template <> struct Std140<glm::vec2>	{ enum { alignment = 8 }; };
+template <> struct Std140<glm::vec3>	{ enum { alignment = 16 }; };
+template <> struct Std140<glm::vec4>	{ enum { alignment = 16 }; };
+template <> struct Std140<glm::mat4>	{ enum { alignment = 16 }; };
+
+// arrays and structs are rounded up to vec4 alignment, and so is their stride
+template <typename T, size_t N> struct Std140<T[N]> {
+	static_assert(sizeof(T) % 16 == 0, "std140 pads array elements to a multiple of 16 bytes");
+	enum { alignment = 16 };
+};
+
+// declares a struct as usable within a block, checking its size can be used as is in arrays
+#define STD140_STRUCT(type) \
+	static_assert(sizeof(type) % 16 == 0, #type " must be padded to a multiple of 16 bytes for std140"); \
+	template <> struct Std140<type> { enum { alignment = 16 }; }
+
+// checks a member sits where std140 would put it
+#define STD140_MEMBER(type, member) \
+	static_assert(offsetof(type, member) % Std140<decltype(type::member)>::alignment == 0, \
+				  #type "::" #member " is not aligned to the std140 rules")
+
+// per-frame camera data, block CameraBlock
+struct CameraBlock {
+	glm::mat4	projectionView;
+	glm::vec3	cameraPosition;
+	float		padding;
+};
+
+// a single light, struct Light. used for every kind of light, with the
+// direction or attenuation left unused by the kinds that don't need them
+struct LightBlock {
+	glm::vec3	position;
+	int			type;
+	glm::vec3	direction;
+	float		constant;
+	glm::vec3	ambient;
+	float		linear;
+	glm::vec3	diffuse;
+	float		quadratic;
+	glm::vec3	specular;
+	float		ambientStrength;
+	float		diffuseStrength;
+	float		specularStrength;
+	int			specularPower;
+	float		padding;
+};
+
+// every light in the scene, block LightsBlock. counts match the shaders' defines
+struct LightsBlock {
+	enum {
+		DIR_LIGHTS_COUNT = 1,
+		POINT_LIGHTS_COUNT = 4,
+	};
+
+	// the single light used by the phong shaders
+	LightBlock	sceneLight;
+
+	LightBlock	dirLights[DIR_LIGHTS_COUNT];
+	LightBlock	pointLights[POINT_LIGHTS_COUNT];
+};
+
+STD140_STRUCT(CameraBlock);
+STD140_MEMBER(CameraBlock, projectionView);
+STD140_MEMBER(CameraBlock, cameraPosition);
+STD140_MEMBER(CameraBlock, padding);
+
+STD140_STRUCT(LightBlock);
+STD140_MEMBER(LightBlock, position);
+STD140_MEMBER(LightBlock, type);
+STD140_MEMBER(LightBlock, direction);
+STD140_MEMBER(LightBlock, constant);
+STD140_MEMBER(LightBlock, ambient);
+STD140_MEMBER(LightBlock, linear);
+STD140_MEMBER(LightBlock, diffuse);
+STD140_MEMBER(LightBlock, quadratic);
+STD140_MEMBER(LightBlock, specular);
+STD140_MEMBER(LightBlock, ambientStrength);
+STD140_MEMBER(LightBlock, diffuseStrength);
+STD140_MEMBER(LightBlock, specularStrength);
+STD140_MEMBER(LightBlock, specularPower);
+STD140_MEMBER(LightBlock, padding);
+
+STD140_STRUCT(LightsBlock);
+STD140_MEMBER(LightsBlock, sceneLight);
+STD140_MEMBER(LightsBlock, dirLights);
+STD140_MEMBER(LightsBlock, pointLights);
+
+} // namespace aie
\ No newline at end of file
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <glm/fwd.hpp>
+#include <cstddef>
+#include "gl_core_4_4.h"
+
+namespace aie {
+
+// how a single scalar type is handed to opengl. floats are read as they are,
+// small integer types are normalised to [0,1] or [-1,1] and 32-bit integers stay integers
+template <typename T> struct VertexScalar;
+template <> struct VertexScalar<float>			{ enum : unsigned int { type = GL_FLOAT,			normalised = GL_FALSE,	integer = false }; };
+template <> struct VertexScalar<signed char>	{ enum : unsigned int { type = GL_BYTE,				normalised = GL_TRUE,	integer = false }; };
+template <> struct VertexScalar<unsigned char>	{ enum : unsigned int { type = GL_UNSIGNED_BYTE,	normalised = GL_TRUE,	integer = false }; };
+template <> struct VertexScalar<short>			{ enum : unsigned int { type = GL_SHORT,			normalised = GL_TRUE,	integer = false }; };
+template <> struct VertexScalar<unsigned short>	{ enum : unsigned int { type = GL_UNSIGNED_SHORT,	normalised = GL_TRUE,	integer = false }; };
+template <> struct VertexScalar<int>			{ enum : unsigned int { type = GL_INT,				normalised = GL_FALSE,	integer = true }; };
+template <> struct VertexScalar<unsigned int>	{ enum : unsigned int { type = GL_UNSIGNED_INT,		normalised = GL_FALSE,	integer = true }; };
+
+// splits a member type in to its scalar type and component count
+template <typename T>
+struct VertexMember {
+	typedef T scalar;
+	enum : unsigned int { components = 1 };
+};
+
+template <glm::length_t L, typename T, glm::precision P>
+struct VertexMember<glm::vec<L, T, P>> {
+	typedef T scalar;
+	enum : unsigned int { components = L };
+};
+
+// a single attribute, read from a member of type T at the given byte offset within the vertex.
+// normally built with the VERTEX_ATTRIB macro so that the type and offset come from the struct itself
+template <unsigned int Location, typename T, size_t Offset>
+struct VertexAttrib {
+
+	typedef VertexScalar<typename VertexMember<T>::scalar> Scalar;
+
+	static const unsigned int	location = Location;
+	static const unsigned int	components = VertexMember<T>::components;
+	static const size_t			offset = Offset;
+	static const size_t			size = sizeof(T);
+
+	static_assert(components >= 1 && components <= 4, "Vertex attributes can have at most 4 components");
+	static_assert(Offset % 4 == 0, "Vertex attributes must be 4-byte aligned");
+	static_assert(Location < 16, "Vertex attribute location out of range");
+
+	// specified as a template so that the whole setup is resolved at compile time
+	template <size_t Stride>
+	static void apply() {
+		glEnableVertexAttribArray(Location);
+		if (Scalar::integer)
+			glVertexAttribIPointer(Location, components, Scalar::type, Stride, (void*)Offset);
+		else
+			glVertexAttribPointer(Location, components, Scalar::type, Scalar::normalised, Stride, (void*)Offset);
+	}
+};
+
+#define VERTEX_ATTRIB(vertex, member, location) \
+	aie::VertexAttrib<location, decltype(vertex::member), offsetof(vertex, member)>
+
+namespace detail {
+
+constexpr bool locationUnused(unsigned int) { return true; }
+
+template <typename... Rest>
+constexpr bool locationUnused(unsigned int location, unsigned int first, Rest... rest) {
+	return location != first && locationUnused(location, rest...);
+}
+
+constexpr bool uniqueLocations() { return true; }
+
+template <typename... Rest>
+constexpr bool uniqueLocations(unsigned int first, Rest... rest) {
+	return locationUnused(first, rest...) && uniqueLocations(rest...);
+}
+
+// the bytes an attribute covers within the vertex, [begin, end)
+struct Range {
+	size_t begin, end;
+};
+
+constexpr bool rangeClear(Range) { return true; }
+
+template <typename... Rest>
+constexpr bool rangeClear(Range range, Range other, Rest... rest) {
+	return (range.end <= other.begin || other.end <= range.begin) && rangeClear(range, rest...);
+}
+
+constexpr bool disjointRanges() { return true; }
+
+template <typename... Rest>
+constexpr bool disjointRanges(Range first, Rest... rest) {
+	return rangeClear(first, rest...) && disjointRanges(rest...);
+}
+
+constexpr bool allTrue() { return true; }
+
+template <typename... Rest>
+constexpr bool allTrue(bool first, Rest... rest) {
+	return first && allTrue(rest...);
+}
+
+} // namespace detail
+
+// describes every attribute of a vertex struct, generating its attribute setup and stride.
+// the struct's layout is checked when the description is compiled, so a reordered or resized
+// member can't silently mismatch the offsets the shaders are fed with
+template <typename Vertex, typename... Attribs>
+struct VertexLayout {
+
+	static const size_t			stride = sizeof(Vertex);
+	static const unsigned int	attributeCount = sizeof...(Attribs);
+
+	static_assert(sizeof...(Attribs) > 0, "A vertex layout needs at least one attribute");
+	static_assert(detail::uniqueLocations(Attribs::location...), "Vertex attribute locations must be unique");
+	static_assert(detail::allTrue((Attribs::offset + Attribs::size <= sizeof(Vertex))...), "Vertex attribute lies outside of the vertex");
+	static_assert(detail::disjointRanges(detail::Range{ Attribs::offset, Attribs::offset + Attribs::size }...), "Vertex attributes overlap");
+
+	// enables and describes each attribute for the currently bound vertex array and array buffer
+	static void apply() {
+		int expand[] = { 0, (Attribs::template apply<stride>(), 0)... };
+		(void)expand;
+	}
+};
+
+} // namespace aie
\ No newline at end of file
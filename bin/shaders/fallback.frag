@@ -0,0 +1,24 @@
+// a minimal fragment shader, lit from the camera so shapes can be made out
+#version 420
+
+in vec4 vPosition;
+in vec3 vNormal;
+
+out vec4 FragColour;
+
+// per-frame camera data, mirrored by aie::CameraBlock
+layout( std140, binding = 0 ) uniform CameraBlock
+{
+	mat4 ProjectionView;
+	vec3 cameraPosition;
+};
+
+void main()
+{
+	vec3 N = normalize( vNormal );
+	vec3 V = normalize( cameraPosition - vPosition.xyz );
+
+	float lambertTerm = max( 0, dot( N, V ));
+
+	FragColour = vec4( vec3( 0.25 + 0.5 * lambertTerm ), 1 );
+}
\ No newline at end of file
@@ -1,7 +1,5 @@
 // a normal map fragment shader
-#version 410
-#define DIR_LIGHTS_COUNT 1
-#define POINT_LIGHTS_COUNT 4
+#version 420
 
 in vec2 vTexCoord;
 in vec3 vNormal;
@@ -10,90 +8,103 @@ in vec3 vBiTangent;
 in vec4 vPosition;
 out vec4 FragColour;
 
-struct Light
-{
-	vec3 ambient;
-	vec3 diffuse;
-	vec3 specular;
+// permutation defines, set by aie::ShaderPermutations. these defaults match the full scene
+#ifndef DIR_LIGHTS_COUNT
+#define DIR_LIGHTS_COUNT 1
+#endif
+#ifndef POINT_LIGHTS_COUNT
+#define POINT_LIGHTS_COUNT 4
+#endif
+#ifndef HAS_SPECULAR_TEXTURE
+#define HAS_SPECULAR_TEXTURE 1
+#endif
+#ifndef HAS_NORMAL_TEXTURE
+#define HAS_NORMAL_TEXTURE 1
+#endif
 
-	float ambientStrength;
-	float diffuseStrength;
-	float specularStrength;
+uniform sampler2D diffuseTexture;
+#if HAS_SPECULAR_TEXTURE
+uniform sampler2D specularTexture;
+#endif
+#if HAS_NORMAL_TEXTURE
+uniform sampler2D normalTexture;
+#endif
 
-	int specularPower;
-};
+uniform vec3 Ka; // material ambient
+uniform vec3 Kd; // material diffuse
+uniform vec3 Ks; // material specular
+uniform float specularPower; // material specular power
 
-struct DirLight
+// per-frame camera data, mirrored by aie::CameraBlock
+layout( std140, binding = 0 ) uniform CameraBlock
 {
-	vec3 direction;
-
-	vec3 ambient;
-	vec3 diffuse;
-	vec3 specular;
-
-	float ambientStrength;
-	float diffuseStrength;
-	float specularStrength;
-	
-	int specularPower;
+	mat4 ProjectionView;
+	vec3 cameraPosition;
 };
 
-struct PointLight
+// block sizes, fixed by aie::LightsBlock whatever the counts used
+#define DIR_LIGHTS_MAX 1
+#define POINT_LIGHTS_MAX 4
+
+// every kind of light shares a struct, mirrored by aie::LightBlock
+struct Light
 {
 	vec3 position;
-
+	int type;
+	vec3 direction;
 	float constant;
-	float linear;
-	float quadratic;
-	
 	vec3 ambient;
+	float linear;
 	vec3 diffuse;
+	float quadratic;
 	vec3 specular;
-
 	float ambientStrength;
 	float diffuseStrength;
 	float specularStrength;
-	
 	int specularPower;
 };
 
-uniform sampler2D diffuseTexture;
-uniform sampler2D specularTexture;
-uniform sampler2D normalTexture;
-
-uniform DirLight dirLights[DIR_LIGHTS_COUNT];
-uniform PointLight pointLights[POINT_LIGHTS_COUNT];
+// every light in the scene, mirrored by aie::LightsBlock
+layout( std140, binding = 1 ) uniform LightsBlock
+{
+	Light sceneLight;
+	Light dirLights[DIR_LIGHTS_MAX];
+	Light pointLights[POINT_LIGHTS_MAX];
+};
 
-uniform vec3 Ka; // material ambient
-uniform vec3 Kd; // material diffuse
-uniform vec3 Ks; // material specular
-uniform float specularPower; // material specular power
+// the surface being lit, sampled once for every light
+vec3 N;
+vec3 texDiffuse;
+vec3 texSpecular;
 
-uniform vec3 Ia; // light ambient
-uniform vec3 Id; // light diffuse
-uniform vec3 Is; // light specular
-uniform float ambientStrength; // strength of ambient light
-uniform float specularStrength; // strength of specular light
+void SampleSurface()
+{
+	N = normalize( vNormal );
 
-uniform vec3 lightPosition;
-uniform vec3 cameraPosition;
+	texDiffuse = texture( diffuseTexture, vTexCoord ).rgb;
 
-// only used when using a directional light
-uniform vec3 lightDirection;
+#if HAS_SPECULAR_TEXTURE
+	texSpecular = texture( specularTexture, vTexCoord ).rgb;
+#else
+	texSpecular = vec3( 1 );
+#endif
 
-vec3 Standard()
-{
-	vec3 N = normalize( vNormal );
+#if HAS_NORMAL_TEXTURE
 	vec3 T = normalize( vTangent );
 	vec3 B = normalize( vBiTangent );
-	vec3 L = normalize( vec3( vPosition ) - lightPosition );
 
-	vec3 texDiffuse = texture( diffuseTexture, vTexCoord ).rgb;
-	vec3 texSpecular = texture( specularTexture, vTexCoord ).rgb;
-	vec3 texNormal = texture( normalTexture, vTexCoord ).rgb;
+	// normal maps are compressed to just x and y, so rebuild z
+	vec2 texNormal = texture( normalTexture, vTexCoord ).rg * 2 - 1;
+	float texNormalZ = sqrt( max( 0, 1 - dot( texNormal, texNormal )));
 
 	mat3 TBN = mat3( T, B, N );
-	N = TBN * ( texNormal * 2 - 1 );
+	N = TBN * vec3( texNormal, texNormalZ );
+#endif
+}
+
+vec3 Standard()
+{
+	vec3 L = normalize( vec3( vPosition ) - sceneLight.position );
 
 	// calculate lambert term
 	float lambertTerm = max( 0, dot( N, -L ));
@@ -106,28 +117,18 @@ vec3 Standard()
 	float specularTerm = pow( max( 0, dot( R, V )), specularPower );
 
 	// calculate each light property
-	vec3 ambient = Ia * Ks * ambientStrength;
-	vec3 diffuse = Id * Kd * texDiffuse * lambertTerm;
-	vec3 specular = Is * Ks * texSpecular * specularTerm * specularStrength;
+	vec3 ambient = sceneLight.ambient * Ks * sceneLight.ambientStrength;
+	vec3 diffuse = sceneLight.diffuse * Kd * texDiffuse * lambertTerm;
+	vec3 specular = sceneLight.specular * Ks * texSpecular * specularTerm * sceneLight.specularStrength;
 
 	// output final colour
 	return ambient + diffuse + specular;
 }
 
-vec3 CalculateDirLight( DirLight light )
+vec3 CalculateDirLight( Light light )
 {
-	vec3 N = normalize( vNormal );
-	vec3 T = normalize( vTangent );
-	vec3 B = normalize( vBiTangent );
 	vec3 L = normalize( light.direction );
 
-	vec3 texDiffuse = texture( diffuseTexture, vTexCoord ).rgb;
-	vec3 texSpecular = texture( specularTexture, vTexCoord ).rgb;
-	vec3 texNormal = texture( normalTexture, vTexCoord ).rgb;
-
-	mat3 TBN = mat3( T, B, N );
-	N = TBN * ( texNormal * 2 - 1 );
-
 	// calculate lambert term
 	float lambertTerm = max( 0, dot( N, -L ));
 	
@@ -147,20 +148,10 @@ vec3 CalculateDirLight( DirLight light )
 	return ambient + diffuse + specular;
 }
 
-vec3 CalculatePointLight(PointLight light)
+vec3 CalculatePointLight(Light light)
 {
-	vec3 N = normalize( vNormal );
-	vec3 T = normalize( vTangent );
-	vec3 B = normalize( vBiTangent );
 	vec3 L = normalize( vec3( vPosition ) - light.position );
 
-	vec3 texDiffuse = texture( diffuseTexture, vTexCoord ).rgb;
-	vec3 texSpecular = texture( specularTexture, vTexCoord ).rgb;
-	vec3 texNormal = texture( normalTexture, vTexCoord ).rgb;
-
-	mat3 TBN = mat3( T, B, N );
-	N = TBN * ( texNormal * 2 - 1 );
-
 	// calculate lambert term
 	float lambertTerm = max( 0, dot( N, -L ));
 
@@ -189,9 +180,11 @@ vec3 CalculatePointLight(PointLight light)
 
 void main()
 {
-	//vec3 norm = normalize(Normal);
-	vec3 result;
+	SampleSurface();
+
+	vec3 result = vec3( 0 );
 
+	// constant counts, so these unroll to just the lights in use
 	for (int i = 0; i < DIR_LIGHTS_COUNT; ++i)
 	{
 		result += CalculateDirLight( dirLights[i] );
@@ -1,5 +1,5 @@
 // classic Phong fragment shader
-#version 410
+#version 420
 
 in vec4 vPosition;
 in vec3 vNormal;
@@ -10,34 +10,51 @@ out vec4 FragColour;
 uniform sampler2D diffuseTexture;
 uniform sampler2D specularTexture;
 
-uniform int lightType; // the type of light used
-
-uniform vec3 Ia; // ambient light colour
-uniform vec3 Id; // diffuse light colour
-uniform vec3 Is; // specular light colour
-uniform float ambientStrength; // strength of ambient light
-uniform float specularStrength; // strength of specular light
-
 uniform vec3 Ka; // ambient material colour
 uniform vec3 Kd; // diffuse material colour
 uniform vec3 Ks; // specular material colour
 uniform float specularPower; // material specular power
 
-uniform vec3 lightPosition;
-uniform vec3 cameraPosition;
+// per-frame camera data, mirrored by aie::CameraBlock
+layout( std140, binding = 0 ) uniform CameraBlock
+{
+	mat4 ProjectionView;
+	vec3 cameraPosition;
+};
 
-// only used when using a directional light
-uniform vec3 lightDirection;
+#define DIR_LIGHTS_COUNT 1
+#define POINT_LIGHTS_COUNT 4
 
-// only used when using a point light
-uniform float constant;
-uniform float linear;
-uniform float quadratic;
+// every kind of light shares a struct, mirrored by aie::LightBlock
+struct Light
+{
+	vec3 position;
+	int type;
+	vec3 direction;
+	float constant;
+	vec3 ambient;
+	float linear;
+	vec3 diffuse;
+	float quadratic;
+	vec3 specular;
+	float ambientStrength;
+	float diffuseStrength;
+	float specularStrength;
+	int specularPower;
+};
+
+// every light in the scene, mirrored by aie::LightsBlock
+layout( std140, binding = 1 ) uniform LightsBlock
+{
+	Light sceneLight;
+	Light dirLights[DIR_LIGHTS_COUNT];
+	Light pointLights[POINT_LIGHTS_COUNT];
+};
 
 vec4 Standard()
 {
 	vec3 N = normalize( vNormal );
-	vec3 L = normalize( vec3( vPosition ) - lightPosition );
+	vec3 L = normalize( vec3( vPosition ) - sceneLight.position );
 
 	// calculate lambert term
 	float lambertTerm = max( 0, dot( N, -L ));
@@ -50,9 +67,9 @@ vec4 Standard()
 	float specularTerm = pow( max( 0, dot( R, V )), specularPower );
 
 	// calculate each colour property
-	vec3 ambient = Ia * Ka * ambientStrength;
-	vec3 diffuse = Id * Kd * lambertTerm;
-	vec3 specular = Is * Ks * specularTerm * specularStrength;
+	vec3 ambient = sceneLight.ambient * Ka * sceneLight.ambientStrength;
+	vec3 diffuse = sceneLight.diffuse * Kd * lambertTerm;
+	vec3 specular = sceneLight.specular * Ks * specularTerm * sceneLight.specularStrength;
 
 	// output final colour
 	return vec4( ambient + diffuse + specular, 1 );
@@ -61,7 +78,7 @@ vec4 Standard()
 vec4 Directional()
 {
 	vec3 N = normalize( vNormal );
-	vec3 L = normalize( lightDirection );
+	vec3 L = normalize( sceneLight.direction );
 
 	// calculate lambert term
 	float lambertTerm = max( 0, dot( N, -L ));
@@ -74,9 +91,9 @@ vec4 Directional()
 	float specularTerm = pow( max( 0, dot( R, V )), specularPower );
 
 	// calculate each colour property
-	vec3 ambient = Ia * Ka * ambientStrength;
-	vec3 diffuse = Id * Kd * lambertTerm;
-	vec3 specular = Is * Ks * specularTerm * specularStrength;
+	vec3 ambient = sceneLight.ambient * Ka * sceneLight.ambientStrength;
+	vec3 diffuse = sceneLight.diffuse * Kd * lambertTerm;
+	vec3 specular = sceneLight.specular * Ks * specularTerm * sceneLight.specularStrength;
 
 	// output final colour
 	return vec4( ambient + diffuse + specular, 1 );
@@ -85,7 +102,7 @@ vec4 Directional()
 vec4 Point()
 {
 	vec3 N = normalize( vNormal );
-	vec3 L = normalize( vec3( vPosition ) - lightPosition );
+	vec3 L = normalize( vec3( vPosition ) - sceneLight.position );
 
 	// calculate lambert term
 	float lambertTerm = max( 0, dot( N, -L ));
@@ -98,12 +115,12 @@ vec4 Point()
 	float specularTerm = pow( max( 0, dot( R, V )), specularPower );
 
 	// calculate each colour property
-	vec3 ambient = Ia * Ka * ambientStrength;
-	vec3 diffuse = Id * Kd * lambertTerm;
-	vec3 specular = Is * Ks * specularTerm * specularStrength;
+	vec3 ambient = sceneLight.ambient * Ka * sceneLight.ambientStrength;
+	vec3 diffuse = sceneLight.diffuse * Kd * lambertTerm;
+	vec3 specular = sceneLight.specular * Ks * specularTerm * sceneLight.specularStrength;
 
-	float distance = length( lightPosition - vec3( vPosition ) );
-	float attenuation = 1.0 / ( constant + linear * distance + quadratic * distance * distance );
+	float distance = length( sceneLight.position - vec3( vPosition ) );
+	float attenuation = 1.0 / ( sceneLight.constant + sceneLight.linear * distance + sceneLight.quadratic * distance * distance );
 
 	ambient *= attenuation;
 	diffuse *= attenuation;
@@ -114,11 +131,11 @@ vec4 Point()
 
 void main()
 {
-	if ( lightType == 1 )
+	if ( sceneLight.type == 1 )
 	{
 		FragColour = Directional();
 	}
-	else if ( lightType == 2 )
+	else if ( sceneLight.type == 2 )
 	{
 		FragColour = Point();
 	}
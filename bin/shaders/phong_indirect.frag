@@ -0,0 +1,83 @@
+// Phong fragment shader for multi-draw-indirect batches
+#version 430
+
+in vec4 vPosition;
+in vec3 vNormal;
+in vec2 vTexCoord;
+flat in int vMaterialIndex;
+
+out vec4 FragColour;
+
+struct Material
+{
+	vec4 Ka;
+	vec4 Kd;
+	vec4 Ks; // w is the specular power
+};
+
+layout( std430, binding = 1 ) readonly buffer MaterialBuffer
+{
+	Material materials[];
+};
+
+// per-frame camera data, mirrored by aie::CameraBlock
+layout( std140, binding = 0 ) uniform CameraBlock
+{
+	mat4 ProjectionView;
+	vec3 cameraPosition;
+};
+
+#define DIR_LIGHTS_COUNT 1
+#define POINT_LIGHTS_COUNT 4
+
+// every kind of light shares a struct, mirrored by aie::LightBlock
+struct Light
+{
+	vec3 position;
+	int type;
+	vec3 direction;
+	float constant;
+	vec3 ambient;
+	float linear;
+	vec3 diffuse;
+	float quadratic;
+	vec3 specular;
+	float ambientStrength;
+	float diffuseStrength;
+	float specularStrength;
+	int specularPower;
+};
+
+// every light in the scene, mirrored by aie::LightsBlock
+layout( std140, binding = 1 ) uniform LightsBlock
+{
+	Light sceneLight;
+	Light dirLights[DIR_LIGHTS_COUNT];
+	Light pointLights[POINT_LIGHTS_COUNT];
+};
+
+void main()
+{
+	Material material = materials[ vMaterialIndex ];
+
+	vec3 N = normalize( vNormal );
+	vec3 L = normalize( vec3( vPosition ) - sceneLight.position );
+
+	// calculate lambert term
+	float lambertTerm = max( 0, dot( N, -L ));
+
+	// calculate view vector and reflection vector
+	vec3 V = normalize( cameraPosition - vPosition.xyz );
+	vec3 R = reflect( L, N );
+
+	// calculate specular term
+	float specularTerm = pow( max( 0, dot( R, V )), material.Ks.w );
+
+	// calculate each colour property
+	vec3 ambient = sceneLight.ambient * material.Ka.rgb * sceneLight.ambientStrength;
+	vec3 diffuse = sceneLight.diffuse * material.Kd.rgb * lambertTerm;
+	vec3 specular = sceneLight.specular * material.Ks.rgb * specularTerm * sceneLight.specularStrength;
+
+	// output final colour
+	FragColour = vec4( ambient + diffuse + specular, 1 );
+}
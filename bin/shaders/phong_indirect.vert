@@ -0,0 +1,43 @@
+// Phong vertex shader for multi-draw-indirect batches
+#version 430
+
+layout( location = 0 ) in vec4 Position;
+layout( location = 1 ) in vec4 Normal;
+layout( location = 2 ) in vec2 TexCoord;
+layout( location = 4 ) in uint DrawID;
+
+out vec4 vPosition;
+out vec3 vNormal;
+out vec2 vTexCoord;
+flat out int vMaterialIndex;
+
+struct DrawData
+{
+	mat4 ModelMatrix;
+	mat4 NormalMatrix;
+	int materialIndex;
+};
+
+// one entry per draw, indexed by the draw ID
+layout( std430, binding = 0 ) readonly buffer DrawBuffer
+{
+	DrawData draws[];
+};
+
+// per-frame camera data, mirrored by aie::CameraBlock
+layout( std140, binding = 0 ) uniform CameraBlock
+{
+	mat4 ProjectionView;
+	vec3 cameraPosition;
+};
+
+void main()
+{
+	DrawData draw = draws[ DrawID ];
+
+	vTexCoord = TexCoord;
+	vPosition = draw.ModelMatrix * Position;
+	vNormal = mat3( draw.NormalMatrix ) * Normal.xyz;
+	vMaterialIndex = draw.materialIndex;
+	gl_Position = ProjectionView * vPosition;
+}
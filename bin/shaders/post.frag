@@ -5,7 +5,10 @@ in vec2 vTexCoord;
 
 uniform sampler2D colourTarget;
 
-uniform int postEffect;
+// 0: default, 1: blur, 2: distort, 3: sobel. set by aie::ShaderPermutations
+#ifndef POST_EFFECT
+#define POST_EFFECT 0
+#endif
 
 out vec4 FragColour;
 
@@ -95,20 +98,13 @@ void main()
 	vec2 texCoord = vTexCoord / scale + texelSize * 0.5f;
 
 	// sample post effect
-	if ( postEffect == 1 )
-	{
-		FragColour = BoxBlur( texCoord );
-	}
-	else if ( postEffect == 2 )
-	{
-		FragColour = Distort( texCoord );
-	}
-	else if ( postEffect == 3 )
-	{
-		FragColour = Sobel( texCoord );
-	}
-	else
-	{
-		FragColour = Default( texCoord );
-	}
+#if POST_EFFECT == 1
+	FragColour = BoxBlur( texCoord );
+#elif POST_EFFECT == 2
+	FragColour = Distort( texCoord );
+#elif POST_EFFECT == 3
+	FragColour = Sobel( texCoord );
+#else
+	FragColour = Default( texCoord );
+#endif
 }
\ No newline at end of file
@@ -2,8 +2,13 @@
 #include "gl_core_4_4.h"
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
+#include <cstdio>
 #include <iostream>
 #include "Input.h"
+#include "GLHandle.h"
+#include "GLState.h"
+#include "ProgramCache.h"
+#include "TextureUploader.h"
 #include "imgui_glfw3.h"
 
 namespace aie {
@@ -49,6 +54,15 @@ bool Application::createWindow(const char* title, int width, int height, bool fu
 	// start input manager
 	Input::create();
 
+	// released gl objects are held on to until the gpu is done with them
+	DeletionQueue::create();
+
+	// linked programs are saved so later runs can skip compiling them
+	ProgramCache::create("./shadercache");
+
+	// textures load and upload in the background rather than stalling the frame
+	TextureUploader::create();
+
 	// imgui
 	ImGui_Init(m_window, true);
 	
@@ -58,6 +72,9 @@ bool Application::createWindow(const char* title, int width, int height, bool fu
 void Application::destroyWindow() {
 
 	ImGui_Shutdown();
+	TextureUploader::destroy();
+	ProgramCache::destroy();
+	DeletionQueue::destroy();
 	Input::destroy();
 
 	glfwDestroyWindow(m_window);
@@ -70,6 +87,11 @@ void Application::run(const char* title, int width, int height, bool fullscreen)
 	if (createWindow(title,width,height, fullscreen) &&
 		startup()) {
 
+		// glfw's timer starts when it is initialised, so this covers creating the window too
+		ProgramCache* programCache = ProgramCache::getInstance();
+		printf("Startup took %.1f ms, %u programs loaded from the cache and %u compiled\n",
+			   glfwGetTime() * 1000.0, programCache->getHitCount(), programCache->getMissCount());
+
 		// variables for timing
 		double prevTime = glfwGetTime();
 		double currTime = 0;
@@ -104,6 +126,12 @@ void Application::run(const char* title, int width, int height, bool fullscreen)
 				fpsInterval -= 1.0f;
 			}
 
+			// don't carry shadowed bindings between frames, in case anything bound behind GLState's back
+			GLState::invalidate();
+
+			// finish textures the gpu has caught up with and upload more of those still arriving
+			TextureUploader::getInstance()->update();
+
 			// clear imgui
 			ImGui_NewFrame();
 
@@ -117,6 +145,9 @@ void Application::run(const char* title, int width, int height, bool fullscreen)
 			//present backbuffer to the monitor
 			glfwSwapBuffers(m_window);
 
+			// delete gl objects that are no longer in use
+			DeletionQueue::getInstance()->advanceFrame();
+
 			// should the game exit?
 			m_gameOver = m_gameOver || glfwWindowShouldClose(m_window) == GLFW_TRUE;
 		}
@@ -1,171 +1,793 @@
 #include "gl_core_4_4.h"
 #include "Font.h"
+#include "ProgramCache.h"
+#include "TextureUploader.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <stdio.h>
+#include <direct.h>
+#include <windows.h>
+
+// stb_truetype declares its own fallback packer types unless stb_rect_pack comes first
+#define STBRP_STATIC
+#define STB_RECT_PACK_IMPLEMENTATION
+#include <stb_rect_pack.h>
 
 #define STB_TRUETYPE_IMPLEMENTATION
 #include <stb_truetype.h>
 
 namespace aie {
 
-Font::Font(const char* trueTypeFontFile, unsigned short fontHeight) 
-	: m_glyphData(nullptr),
-	m_glHandle(0),
-	m_pixelBufferHandle(0),
-	m_textureWidth(0),
-	m_textureHeight(0) {
-	
-	FILE* file = nullptr;
-	fopen_s(&file, trueTypeFontFile, "rb");
-	if (file != nullptr) {
-		
-		unsigned char* ttf_buffer = new unsigned char[4096 * 1024];
+// the pixel height distance fields are made at, drawing scales them to any font height
+static const unsigned int FACE_SIZE = 32;
+
+// how far in pixels at the face size the fields reach either side of the outline
+static const int SDF_SPREAD = 4;
+
+// outlines are rasterized this many times larger to find the distances from
+static const int SDF_OVERSAMPLE = 4;
+
+static const unsigned short FACE_TEXTURE_SIZE = 1024;
+
+// space left around each glyph so that filtering doesn't pick up its neighbours
+static const unsigned int GLYPH_PADDING = 1;
+
+// runs kept per font, the least recently used half is dropped when there are more
+static const size_t MAX_RUNS = 512;
+
+// where the distance fields made for each typeface are kept between runs
+static const char* FONT_CACHE_DIRECTORY = "./fontcache";
+
+// written at the start of a cache file, followed by its entries and then their fields
+struct FontCacheHeader {
+	unsigned int		magic;
+	unsigned int		count;
+	unsigned long long	key;
+};
+
+// a glyph's distance field in a cache file, its offset being from the start of the file
+struct FontCacheEntry {
+	int				index;
+	unsigned int	width, height;
+	unsigned int	offset;
+};
+
+static const unsigned int FONT_CACHE_MAGIC = 0x46445346; // "FSDF"
+
+// squared distances to the nearest feature along a line, from Felzenszwalb and Huttenlocher's
+// "Distance Transforms of Sampled Functions". f is 0 at features and large elsewhere
+static void distanceTransform(const float* f, int n, float* d, int* v, float* z) {
+	int k = 0;
+	v[0] = 0;
+	z[0] = -1e20f;
+	z[1] = 1e20f;
+	for (int q = 1; q < n; ++q) {
+		float s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2 * q - 2 * v[k]);
+		while (s <= z[k]) {
+			--k;
+			s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2 * q - 2 * v[k]);
+		}
+		++k;
+		v[k] = q;
+		z[k] = s;
+		z[k + 1] = 1e20f;
+	}
 
-		fread(ttf_buffer, 1, 4096 * 1024, file);
-		fclose(file);
+	k = 0;
+	for (int q = 0; q < n; ++q) {
+		while (z[k + 1] < q)
+			++k;
+		d[q] = (float)((q - v[k]) * (q - v[k])) + f[v[k]];
+	}
+}
 
-		// determine size of texture image
-		m_textureWidth = fontHeight / 16 * 256;
-		m_textureHeight = fontHeight / 16 * 256;
+// transforms the columns then the rows, leaving the squared distance to the nearest feature in each pixel
+static void distanceTransform(std::vector<float>& grid, int width, int height) {
+	int size = std::max(width, height);
+	std::vector<float> f(size), d(size), z(size + 1);
+	std::vector<int> v(size);
+
+	for (int x = 0; x < width; ++x) {
+		for (int y = 0; y < height; ++y)
+			f[y] = grid[y * width + x];
+		distanceTransform(f.data(), height, d.data(), v.data(), z.data());
+		for (int y = 0; y < height; ++y)
+			grid[y * width + x] = d[y];
+	}
 
-		if (fontHeight <= 16) {
-			m_textureWidth = 256;
-			m_textureHeight = 256;
-		}
-		
-		if (m_textureWidth > 2048)
-			m_textureWidth = 2048;
-		if (m_textureHeight > 2048)
-			m_textureHeight = 2048;
+	for (int y = 0; y < height; ++y) {
+		distanceTransform(&grid[y * width], width, d.data(), v.data(), z.data());
+		std::copy(d.begin(), d.begin() + width, grid.begin() + y * width);
+	}
+}
+
+class Font::Face {
+public:
+
+	// the face for a font file, shared by every font made from it
+	static Face* acquire(const char* filename);
+	void release();
+
+	Glyph& getGlyph(int codepoint);
+
+	// rasterizes any of the glyphs that aren't in the texture, returning false if others had to move
+	bool cacheGlyphs(const std::vector<Glyph*>& glyphs);
+
+	// uploads the parts of the texture changed since the last call
+	void updateTexture();
+
+	// bumped whenever glyphs are moved in the texture
+	unsigned int getGeneration() const { return m_generation; }
+
+	// marks glyphs as drawn without needing them rasterized
+	void touch(const std::vector<Glyph*>& glyphs);
 
-		glGenBuffers(1, &m_pixelBufferHandle);
-		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_pixelBufferHandle);
-		glBufferData(GL_PIXEL_UNPACK_BUFFER, m_textureWidth * m_textureHeight, nullptr, GL_STREAM_COPY);
-		unsigned char* tempBitmapData = (GLubyte*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, 
-																   m_textureWidth * m_textureHeight,
-																   GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	unsigned int	m_glHandle;
+	unsigned short	m_textureSize;
+	unsigned int	m_residentCount;
+	unsigned int	m_evictionCount;
 
-		m_glyphData = new stbtt_bakedchar[256];
-		memset(m_glyphData, 0, sizeof(stbtt_bakedchar) * 256);
-		stbtt_BakeFontBitmap(ttf_buffer, 0, fontHeight, tempBitmapData, m_textureWidth, m_textureHeight, 0, 256, (stbtt_bakedchar*)m_glyphData);
+private:
 
-		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	Face(const char* filename);
+	~Face();
 
-		glGenTextures(1, &m_glHandle);
-		glBindTexture(GL_TEXTURE_2D, m_glHandle);
+	// finds room for the glyph and makes its distance field there
+	bool packGlyph(Glyph& glyph);
 
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, m_textureWidth, m_textureHeight, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+	// keeps the most recently used glyphs and repacks them, dropping the rest
+	void evict();
 
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	// copies the glyph's distance field in to the texture's pixels, making it if it isn't cached
+	void copyDistanceField(const Glyph& glyph);
+
+	// makes the glyph's distance field, packed tightly in to the output
+	void makeDistanceField(const Glyph& glyph, unsigned char* output);
+
+	// maps the cache file made by an earlier run, and saves it again with any fields made since
+	void openCache();
+	void closeCache();
+	void saveCache();
+
+	std::string						m_filename;
+	unsigned int					m_references;
+
+	std::vector<unsigned char>		m_fontData;
+	stbtt_fontinfo					m_fontInfo;
+	bool							m_loaded;
+	float							m_scale;
+
+	std::unordered_map<int, Glyph>	m_glyphs;
+	unsigned int					m_tick;
+	unsigned int					m_generation;
+
+	// the texture's pixels, and the rectangles of it to upload
+	std::vector<unsigned char>		m_pixels;
+	std::vector<unsigned int>		m_dirty;
+
+	stbrp_context					m_packer;
+	std::vector<stbrp_node>			m_nodes;
+
+	// the cache file is keyed on the font's contents and the settings the fields are made with
+	unsigned long long				m_cacheKey;
+	HANDLE							m_cacheFile;
+	HANDLE							m_cacheMapping;
+	const unsigned char*			m_cacheView;
+
+	// the mapped file's fields by glyph index, and the fields made this run that it doesn't have
+	std::unordered_map<int, const FontCacheEntry*>			m_cachedFields;
+	std::unordered_map<int, std::vector<unsigned char>>	m_madeFields;
+
+	static std::unordered_map<std::string, Face*>	m_faces;
+};
+
+std::unordered_map<std::string, Font::Face*> Font::Face::m_faces;
+
+Font::Face* Font::Face::acquire(const char* filename) {
+	Face*& face = m_faces[filename];
+	if (face == nullptr)
+		face = new Face(filename);
+
+	face->m_references++;
+	return face;
+}
+
+void Font::Face::release() {
+	if (--m_references > 0)
+		return;
+
+	m_faces.erase(m_filename);
+	delete this;
+}
 
-		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+Font::Face::Face(const char* filename)
+	: m_glHandle(0),
+	m_textureSize(0),
+	m_residentCount(0),
+	m_evictionCount(0),
+	m_filename(filename),
+	m_references(0),
+	m_fontInfo(),
+	m_loaded(false),
+	m_scale(0),
+	m_tick(0),
+	m_generation(1),
+	m_packer(),
+	m_cacheKey(0),
+	m_cacheFile(INVALID_HANDLE_VALUE),
+	m_cacheMapping(nullptr),
+	m_cacheView(nullptr) {
 
-		delete[] ttf_buffer;
+	FILE* file = nullptr;
+	fopen_s(&file, filename, "rb");
+	if (file == nullptr)
+		return;
+
+	// the font is kept for rasterizing glyphs as they are needed
+	fseek(file, 0, SEEK_END);
+	m_fontData.resize(ftell(file));
+	fseek(file, 0, SEEK_SET);
+	size_t read = fread(m_fontData.data(), 1, m_fontData.size(), file);
+	fclose(file);
+
+	if (read != m_fontData.size() ||
+		stbtt_InitFont(&m_fontInfo, m_fontData.data(), stbtt_GetFontOffsetForIndex(m_fontData.data(), 0)) == 0) {
+		printf("Error: Failed to load font [%s]!\n", filename);
+		return;
 	}
+	m_loaded = true;
+	m_scale = stbtt_ScaleForPixelHeight(&m_fontInfo, (float)FACE_SIZE);
+
+	unsigned int settings[] = { FACE_SIZE, SDF_SPREAD, SDF_OVERSAMPLE };
+	m_cacheKey = ProgramCache::hash(m_fontData.data(), m_fontData.size());
+	m_cacheKey = ProgramCache::hash(settings, sizeof(settings), m_cacheKey);
+	openCache();
+
+	m_textureSize = FACE_TEXTURE_SIZE;
+	m_pixels.resize(m_textureSize * m_textureSize, 0);
+
+	m_nodes.resize(m_textureSize);
+	stbrp_init_target(&m_packer, m_textureSize, m_textureSize, m_nodes.data(), (int)m_nodes.size());
+
+	glGenTextures(1, &m_glHandle);
+	glBindTexture(GL_TEXTURE_2D, m_glHandle);
+
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, m_textureSize, m_textureSize, 0, GL_RED, GL_UNSIGNED_BYTE, m_pixels.data());
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
 }
 
-Font::~Font() {
-	delete[] (stbtt_bakedchar*)m_glyphData;
+Font::Face::~Face() {
+	if (m_madeFields.empty() == false)
+		saveCache();
+	closeCache();
 
 	glDeleteTextures(1, &m_glHandle);
-	glDeleteBuffers(1, &m_pixelBufferHandle);
 }
 
-float Font::getStringWidth(const char* str) {
+void Font::Face::openCache() {
+	char path[64];
+	sprintf_s(path, "%s/%016llx.sdf", FONT_CACHE_DIRECTORY, m_cacheKey);
+
+	m_cacheFile = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (m_cacheFile == INVALID_HANDLE_VALUE)
+		return;
+
+	// the fields are read straight from the mapping as glyphs are packed, so only the pages used are read in
+	LARGE_INTEGER size = {};
+	if (GetFileSizeEx(m_cacheFile, &size) == 0 ||
+		size.QuadPart < (LONGLONG)sizeof(FontCacheHeader) ||
+		(m_cacheMapping = CreateFileMappingA(m_cacheFile, nullptr, PAGE_READONLY, 0, 0, nullptr)) == nullptr ||
+		(m_cacheView = (const unsigned char*)MapViewOfFile(m_cacheMapping, FILE_MAP_READ, 0, 0, 0)) == nullptr) {
+		closeCache();
+		return;
+	}
 
-	stbtt_aligned_quad Q = {};
-	float xPos = 0.0f;
-	float yPos = 0.0f;
+	// a stale or damaged file is ignored, and replaced when the face is released
+	const FontCacheHeader* header = (const FontCacheHeader*)m_cacheView;
+	size_t entriesEnd = sizeof(FontCacheHeader) + (size_t)header->count * sizeof(FontCacheEntry);
+	if (header->magic != FONT_CACHE_MAGIC ||
+		header->key != m_cacheKey ||
+		entriesEnd > (size_t)size.QuadPart) {
+		closeCache();
+		return;
+	}
 
-	while (*str != 0) {
-		stbtt_GetBakedQuad(
-			(stbtt_bakedchar*)m_glyphData,
-			m_textureWidth,
-			m_textureHeight,
-			(unsigned char)*str, &xPos, &yPos, &Q, 1);
+	const FontCacheEntry* entries = (const FontCacheEntry*)(header + 1);
+	for (unsigned int i = 0; i < header->count; ++i) {
+		if (entries[i].offset + (size_t)entries[i].width * entries[i].height <= (size_t)size.QuadPart)
+			m_cachedFields[entries[i].index] = &entries[i];
+	}
+}
+
+void Font::Face::closeCache() {
+	m_cachedFields.clear();
+
+	if (m_cacheView != nullptr)
+		UnmapViewOfFile(m_cacheView);
+	if (m_cacheMapping != nullptr)
+		CloseHandle(m_cacheMapping);
+	if (m_cacheFile != INVALID_HANDLE_VALUE)
+		CloseHandle(m_cacheFile);
 
-		str++;
+	m_cacheView = nullptr;
+	m_cacheMapping = nullptr;
+	m_cacheFile = INVALID_HANDLE_VALUE;
+}
+
+void Font::Face::saveCache() {
+
+	// gather everything before unmapping the file, as it's about to be written over
+	std::vector<FontCacheEntry> entries;
+	std::vector<unsigned char> fields;
+	for (auto& pair : m_cachedFields) {
+		if (m_madeFields.find(pair.first) != m_madeFields.end())
+			continue;
+
+		FontCacheEntry entry = *pair.second;
+		const unsigned char* field = m_cacheView + entry.offset;
+		entry.offset = (unsigned int)fields.size();
+		fields.insert(fields.end(), field, field + entry.width * entry.height);
+		entries.push_back(entry);
+	}
+	for (auto& pair : m_madeFields) {
+		int x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+		stbtt_GetGlyphBitmapBox(&m_fontInfo, pair.first, m_scale, m_scale, &x0, &y0, &x1, &y1);
+
+		FontCacheEntry entry = {};
+		entry.index = pair.first;
+		entry.width = x1 - x0 + SDF_SPREAD * 2;
+		entry.height = y1 - y0 + SDF_SPREAD * 2;
+		entry.offset = (unsigned int)fields.size();
+		fields.insert(fields.end(), pair.second.begin(), pair.second.end());
+		entries.push_back(entry);
 	}
 
-	// get the position of the last vert for the last character rendered
-	return Q.x1;
+	closeCache();
+
+	FontCacheHeader header = {};
+	header.magic = FONT_CACHE_MAGIC;
+	header.count = (unsigned int)entries.size();
+	header.key = m_cacheKey;
+
+	unsigned int fieldsStart = (unsigned int)(sizeof(header) + entries.size() * sizeof(FontCacheEntry));
+	for (auto& entry : entries)
+		entry.offset += fieldsStart;
+
+	char path[64];
+	sprintf_s(path, "%s/%016llx.sdf", FONT_CACHE_DIRECTORY, m_cacheKey);
+	_mkdir(FONT_CACHE_DIRECTORY);
+
+	FILE* file = nullptr;
+	fopen_s(&file, path, "wb");
+	if (file == nullptr)
+		return;
+
+	fwrite(&header, sizeof(header), 1, file);
+	fwrite(entries.data(), sizeof(FontCacheEntry), entries.size(), file);
+	fwrite(fields.data(), 1, fields.size(), file);
+	fclose(file);
 }
 
-float Font::getStringHeight(const char* str) {
+Font::Glyph& Font::Face::getGlyph(int codepoint) {
+	auto iter = m_glyphs.find(codepoint);
+	if (iter != m_glyphs.end())
+		return iter->second;
+
+	Glyph& glyph = m_glyphs[codepoint];
+	glyph.index = 0;
+	glyph.x0 = glyph.y0 = glyph.x1 = glyph.y1 = 0;
+	glyph.advance = 0;
+	glyph.resident = false;
+	glyph.atlasX = glyph.atlasY = 0;
+	glyph.lastUsed = 0;
+
+	if (m_loaded) {
+		glyph.index = stbtt_FindGlyphIndex(&m_fontInfo, codepoint);
+
+		int advance = 0, bearing = 0;
+		stbtt_GetGlyphHMetrics(&m_fontInfo, glyph.index, &advance, &bearing);
+		stbtt_GetGlyphBitmapBox(&m_fontInfo, glyph.index, m_scale, m_scale, &glyph.x0, &glyph.y0, &glyph.x1, &glyph.y1);
+		glyph.advance = advance * m_scale;
+	}
+	return glyph;
+}
 
-	stbtt_aligned_quad Q = {};
-	float low = 9999999, high = -9999999;
-	float xPos = 0.0f;
-	float yPos = 0.0f;
+void Font::Face::touch(const std::vector<Glyph*>& glyphs) {
+	++m_tick;
+	for (Glyph* glyph : glyphs)
+		glyph->lastUsed = m_tick;
+}
 
-	while (*str != 0) {
-		stbtt_GetBakedQuad(
-			(stbtt_bakedchar*)m_glyphData,
-			m_textureWidth,
-			m_textureHeight,
-			(unsigned char)*str, &xPos, &yPos, &Q, 1);
+bool Font::Face::cacheGlyphs(const std::vector<Glyph*>& glyphs) {
+	if (m_loaded == false)
+		return true;
+
+	touch(glyphs);
+
+	bool moved = false;
+	for (Glyph* glyph : glyphs) {
+		if (glyph->resident)
+			continue;
 
-		low = low > Q.y0 ? Q.y0 : low;
-		high = high < Q.y1 ? Q.y1 : high;
+		// make room by dropping glyphs that haven't been drawn lately, the ones in this string are kept.
+		// a string with more glyphs than fit only evicts once, and draws without the rest
+		if (packGlyph(*glyph) == false &&
+			moved == false) {
+			evict();
+			moved = true;
+			packGlyph(*glyph);
+		}
+	}
+	return moved == false;
+}
+
+bool Font::Face::packGlyph(Glyph& glyph) {
+	unsigned int width = glyph.x1 - glyph.x0 + SDF_SPREAD * 2;
+	unsigned int height = glyph.y1 - glyph.y0 + SDF_SPREAD * 2;
+
+	stbrp_rect rect = {};
+	rect.w = (stbrp_coord)(width + GLYPH_PADDING * 2);
+	rect.h = (stbrp_coord)(height + GLYPH_PADDING * 2);
+	stbrp_pack_rects(&m_packer, &rect, 1);
+	if (rect.was_packed == 0)
+		return false;
+
+	glyph.resident = true;
+	glyph.atlasX = rect.x + GLYPH_PADDING;
+	glyph.atlasY = rect.y + GLYPH_PADDING;
+	m_residentCount++;
+
+	copyDistanceField(glyph);
+
+	unsigned int dirty[] = { glyph.atlasX, glyph.atlasY, width, height };
+	m_dirty.insert(m_dirty.end(), dirty, dirty + 4);
+	return true;
+}
 
-		str++;
+void Font::Face::copyDistanceField(const Glyph& glyph) {
+	unsigned int width = glyph.x1 - glyph.x0 + SDF_SPREAD * 2;
+	unsigned int height = glyph.y1 - glyph.y0 + SDF_SPREAD * 2;
+
+	// fields are looked for in the cache file first, then in those made already, as
+	// evicting makes the glyphs it keeps again
+	const unsigned char* field = nullptr;
+	auto cached = m_cachedFields.find(glyph.index);
+	if (cached != m_cachedFields.end() &&
+		cached->second->width == width &&
+		cached->second->height == height) {
+		field = m_cacheView + cached->second->offset;
+	}
+	else {
+		std::vector<unsigned char>& made = m_madeFields[glyph.index];
+		if (made.empty()) {
+			made.resize(width * height);
+			makeDistanceField(glyph, made.data());
+		}
+		field = made.data();
 	}
 
-	return high - low;
+	unsigned char* output = &m_pixels[glyph.atlasY * m_textureSize + glyph.atlasX];
+	for (unsigned int y = 0; y < height; ++y)
+		memcpy(output + y * m_textureSize, field + y * width, width);
 }
 
-void Font::getStringSize(const char* str, float& width, float& height) {
+void Font::Face::makeDistanceField(const Glyph& glyph, unsigned char* output) {
+	int width = glyph.x1 - glyph.x0 + SDF_SPREAD * 2;
+	int height = glyph.y1 - glyph.y0 + SDF_SPREAD * 2;
+
+	// rasterize the outline larger, in to a grid covering the field. its bounds
+	// are always inside the field's, scaled up, as they are rounded outwards
+	int gridWidth = width * SDF_OVERSAMPLE;
+	int gridHeight = height * SDF_OVERSAMPLE;
+	float scale = m_scale * SDF_OVERSAMPLE;
+
+	int x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+	stbtt_GetGlyphBitmapBox(&m_fontInfo, glyph.index, scale, scale, &x0, &y0, &x1, &y1);
+	int offsetX = x0 - (glyph.x0 - SDF_SPREAD) * SDF_OVERSAMPLE;
+	int offsetY = y0 - (glyph.y0 - SDF_SPREAD) * SDF_OVERSAMPLE;
+
+	std::vector<unsigned char> coverage(gridWidth * gridHeight, 0);
+	stbtt_MakeGlyphBitmap(&m_fontInfo, &coverage[offsetY * gridWidth + offsetX],
+						  x1 - x0, y1 - y0, gridWidth, scale, scale, glyph.index);
+
+	// distances from outside to the outline, and from inside to it
+	std::vector<float> outside(coverage.size()), inside(coverage.size());
+	for (size_t i = 0; i < coverage.size(); ++i) {
+		bool isInside = coverage[i] >= 128;
+		outside[i] = isInside ? 0 : 1e20f;
+		inside[i] = isInside ? 1e20f : 0;
+	}
+	distanceTransform(outside, gridWidth, gridHeight);
+	distanceTransform(inside, gridWidth, gridHeight);
+
+	// sample the centre of each texel, 128 being the edge and higher inside
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			int sample = (y * SDF_OVERSAMPLE + SDF_OVERSAMPLE / 2) * gridWidth + x * SDF_OVERSAMPLE + SDF_OVERSAMPLE / 2;
+			float distance = (sqrtf(outside[sample]) - sqrtf(inside[sample])) / SDF_OVERSAMPLE;
+			float value = 128.0f - distance * (127.0f / SDF_SPREAD);
+			output[y * width + x] = (unsigned char)std::min(std::max(value, 0.0f), 255.0f);
+		}
+	}
+}
 
-	stbtt_aligned_quad Q = {};
-	float low = 9999999, high = -9999999;
-	float xPos = 0.0f;
-	float yPos = 0.0f;
+void Font::Face::evict() {
+	m_evictionCount++;
+	m_generation++;
+
+	std::vector<Glyph*> resident;
+	for (auto& pair : m_glyphs)
+		if (pair.second.resident)
+			resident.push_back(&pair.second);
+
+	std::sort(resident.begin(), resident.end(), [](const Glyph* a, const Glyph* b) {
+		return a->lastUsed > b->lastUsed;
+	});
+
+	// keep the glyphs in use now, then the most recent up to half the texture, so that
+	// there is room to add more before having to evict again
+	unsigned int keptArea = 0;
+	unsigned int maxArea = m_textureSize * m_textureSize / 2;
+	std::vector<Glyph*> kept;
+	for (Glyph* glyph : resident) {
+		unsigned int area = (glyph->x1 - glyph->x0 + SDF_SPREAD * 2 + GLYPH_PADDING * 2) *
+			(glyph->y1 - glyph->y0 + SDF_SPREAD * 2 + GLYPH_PADDING * 2);
+		if (glyph->lastUsed != m_tick &&
+			keptArea + area > maxArea)
+			break;
+		keptArea += area;
+		kept.push_back(glyph);
+	}
 
-	while (*str != 0) {
-		stbtt_GetBakedQuad(
-			(stbtt_bakedchar*)m_glyphData,
-			m_textureWidth,
-			m_textureHeight,
-			(unsigned char)*str, &xPos, &yPos, &Q, 1);
+	for (Glyph* glyph : resident)
+		glyph->resident = false;
+	m_residentCount = 0;
+
+	// start again with an empty texture, the kept glyphs are made again rather than moved
+	std::fill(m_pixels.begin(), m_pixels.end(), (unsigned char)0);
+	stbrp_init_target(&m_packer, m_textureSize, m_textureSize, m_nodes.data(), (int)m_nodes.size());
+
+	// taller glyphs first packs more tightly
+	std::sort(kept.begin(), kept.end(), [](const Glyph* a, const Glyph* b) {
+		return a->y1 - a->y0 > b->y1 - b->y0;
+	});
+	for (Glyph* glyph : kept)
+		packGlyph(*glyph);
+
+	// everything moved, so the whole texture goes up
+	m_dirty.clear();
+	unsigned int dirty[] = { 0, 0, m_textureSize, m_textureSize };
+	m_dirty.insert(m_dirty.end(), dirty, dirty + 4);
+}
 
-		low = low > Q.y0 ? Q.y0 : low;
-		high = high < Q.y1 ? Q.y1 : high;
+void Font::Face::updateTexture() {
+	if (m_dirty.empty())
+		return;
 
-		str++;
+	for (size_t i = 0; i < m_dirty.size(); i += 4) {
+		unsigned int x = m_dirty[i], y = m_dirty[i + 1];
+		TextureUploader::uploadRegion(m_glHandle, 1, x, y, m_dirty[i + 2], m_dirty[i + 3],
+									  &m_pixels[y * m_textureSize + x], m_textureSize);
 	}
 
-	height = high - low;
-	width = Q.x1;
+	m_dirty.clear();
 }
 
-void Font::getStringRectangle(const char* str, float& x0, float& y0, float& x1, float& y1) {
+Font::Font(const char* trueTypeFontFile, unsigned short fontHeight)
+	: m_face(nullptr),
+	m_fontHeight(fontHeight),
+	m_scale(fontHeight / (float)FACE_SIZE),
+	m_runCacheEnabled(true),
+	m_runTick(0),
+	m_runHits(0),
+	m_runMisses(0) {
+
+	// fonts of the same typeface share their glyphs, whatever their height
+	m_face = Face::acquire(trueTypeFontFile);
+}
 
-	stbtt_aligned_quad Q = {};
-	y1 = 9999999, y0 = -9999999;
-	x0 = 9999999, x1 = -9999999;
-	float xPos = 0.0f;
-	float yPos = 0.0f;
+Font::~Font() {
+	m_face->release();
+}
 
-	while (*str != 0) {
-		stbtt_GetBakedQuad(
-			(stbtt_bakedchar*)m_glyphData,
-			m_textureWidth,
-			m_textureHeight,
-			(unsigned char)*str, &xPos, &yPos, &Q, 1);
+unsigned int Font::getTextureHandle() const {
+	return m_face->m_glHandle;
+}
+
+unsigned int Font::getResidentGlyphCount() const {
+	return m_face->m_residentCount;
+}
+
+unsigned int Font::getEvictionCount() const {
+	return m_face->m_evictionCount;
+}
+
+void Font::updateTexture() {
+	m_face->updateTexture();
+}
+
+int Font::nextCodepoint(const char*& str) {
+	const unsigned char* bytes = (const unsigned char*)str;
+
+	int length = 1, codepoint = bytes[0];
+	if ((bytes[0] & 0xe0) == 0xc0) {
+		length = 2;
+		codepoint = bytes[0] & 0x1f;
+	}
+	else if ((bytes[0] & 0xf0) == 0xe0) {
+		length = 3;
+		codepoint = bytes[0] & 0x0f;
+	}
+	else if ((bytes[0] & 0xf8) == 0xf0) {
+		length = 4;
+		codepoint = bytes[0] & 0x07;
+	}
+
+	// a sequence cut short by the end of the string or a stray byte is taken as the byte it started with
+	for (int i = 1; i < length; ++i) {
+		if ((bytes[i] & 0xc0) != 0x80) {
+			str++;
+			return bytes[0];
+		}
+		codepoint = (codepoint << 6) | (bytes[i] & 0x3f);
+	}
+
+	str += length;
+	return codepoint;
+}
+
+void Font::setRunCacheEnabled(bool enabled) {
+	m_runCacheEnabled = enabled;
+	if (enabled == false)
+		m_runs.clear();
+}
+
+const Font::Run& Font::getRun(const char* str, bool textured, bool& moved) {
+	moved = false;
+
+	Run* run = &m_uncachedRun;
+	if (m_runCacheEnabled == false) {
+		layoutRun(*run, str);
+	}
+	else {
+		unsigned long long key = ProgramCache::hash(str);
+		auto iter = m_runs.find(key);
+		if (iter != m_runs.end() &&
+			iter->second.text == str) {
+			run = &iter->second;
+			m_runHits++;
+		}
+		else {
+			if (iter == m_runs.end() &&
+				m_runs.size() >= MAX_RUNS) {
+				std::vector<unsigned int> ages;
+				ages.reserve(m_runs.size());
+				for (auto& pair : m_runs)
+					ages.push_back(pair.second.lastUsed);
+				std::nth_element(ages.begin(), ages.begin() + ages.size() / 2, ages.end());
+				unsigned int median = ages[ages.size() / 2];
+
+				for (auto pair = m_runs.begin(); pair != m_runs.end();) {
+					if (pair->second.lastUsed <= median)
+						pair = m_runs.erase(pair);
+					else
+						++pair;
+				}
+			}
+
+			// a colliding string takes the other's place
+			run = &m_runs[key];
+			layoutRun(*run, str);
+			m_runMisses++;
+		}
+		run->lastUsed = ++m_runTick;
+	}
+
+	if (textured == false)
+		return *run;
+
+	// the texture coords stay right until glyphs are moved, but the glyphs still count as used
+	if (run->generation == m_face->getGeneration()) {
+		m_face->touch(run->glyphs);
+		return *run;
+	}
 
-		y1 = y1 > Q.y0 ? Q.y0 : y1;
-		y0 = y0 < Q.y1 ? Q.y1 : y0;
+	moved = m_face->cacheGlyphs(run->glyphs) == false;
+
+	bool complete = true;
+	float textureSize = (float)m_face->m_textureSize;
+	for (size_t i = 0; i < run->glyphs.size(); ++i) {
+		const Glyph& glyph = *run->glyphs[i];
+		Quad& quad = run->quads[i];
+		quad.s0 = glyph.atlasX / textureSize;
+		quad.t0 = glyph.atlasY / textureSize;
+		quad.s1 = (glyph.atlasX + glyph.x1 - glyph.x0 + SDF_SPREAD * 2) / textureSize;
+		quad.t1 = (glyph.atlasY + glyph.y1 - glyph.y0 + SDF_SPREAD * 2) / textureSize;
+		complete &= glyph.resident;
+	}
 
-		x1 = x1 < Q.x1 ? Q.x1 : x1;
-		x0 = x0 > Q.x0 ? Q.x0 : x0;
+	// glyphs that didn't fit are tried again next time
+	run->generation = complete ? m_face->getGeneration() : 0;
+	return *run;
+}
 
-		str++;
+void Font::layoutRun(Run& run, const char* str) {
+	run.text = str;
+	run.glyphs.clear();
+	run.quads.clear();
+	run.width = 0;
+	run.x0 = run.y0 = 9999999;
+	run.x1 = run.y1 = -9999999;
+	run.generation = 0;
+	run.lastUsed = 0;
+
+	float x = 0;
+	while (*str != 0) {
+		Glyph& glyph = m_face->getGlyph(nextCodepoint(str));
+
+		// the outline's bounds at this font's height
+		float x0 = x + glyph.x0 * m_scale;
+		float x1 = x + glyph.x1 * m_scale;
+		float y0 = glyph.y0 * m_scale;
+		float y1 = glyph.y1 * m_scale;
+
+		run.width = x1;
+		run.x0 = std::min(run.x0, x0);
+		run.y0 = std::min(run.y0, y0);
+		run.x1 = std::max(run.x1, x1);
+		run.y1 = std::max(run.y1, y1);
+
+		// the quad covers the whole distance field, past the outline
+		if (glyph.x1 != glyph.x0 &&
+			glyph.y1 != glyph.y0) {
+			float spread = SDF_SPREAD * m_scale;
+
+			Quad quad = {};
+			quad.x0 = x0 - spread;
+			quad.y0 = y0 - spread;
+			quad.x1 = x1 + spread;
+			quad.y1 = y1 + spread;
+
+			run.glyphs.push_back(&glyph);
+			run.quads.push_back(quad);
+		}
+
+		x += glyph.advance * m_scale;
 	}
+}
 
-	y0 *= -1;
-	y1 *= -1;
+float Font::getStringWidth(const char* str) {
+	bool moved = false;
+	return getRun(str, false, moved).width;
+}
+
+float Font::getStringHeight(const char* str) {
+	bool moved = false;
+	const Run& run = getRun(str, false, moved);
+	return run.y1 - run.y0;
+}
+
+void Font::getStringSize(const char* str, float& width, float& height) {
+	bool moved = false;
+	const Run& run = getRun(str, false, moved);
+	height = run.y1 - run.y0;
+	width = run.width;
+}
+
+void Font::getStringRectangle(const char* str, float& x0, float& y0, float& x1, float& y1) {
+	bool moved = false;
+	const Run& run = getRun(str, false, moved);
+	x0 = run.x0;
+	x1 = run.x1;
+	y0 = -run.y1;
+	y1 = -run.y0;
 }
 
 } // namepace aie
\ No newline at end of file
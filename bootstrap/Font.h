@@ -1,8 +1,17 @@
 #pragma once
 
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 namespace aie {
 
-// a class that wraps up a True Type Font within an OpenGL texture
+// a class that wraps up a True Type Font within an OpenGL texture.
+// glyphs are stored as signed distance fields made at one size and scaled to the font height
+// when drawn, so every Font of the same typeface shares a texture whatever its height.
+// glyphs are added to it the first time they are drawn, and the least recently drawn
+// ones are cleared out when it fills up. the distance fields made are saved in ./fontcache
+// when the last font of a typeface is destroyed, and later runs map them rather than make them again
 class Font {
 
 	friend class Renderer2D;
@@ -12,8 +21,13 @@ public:
 	Font(const char* trueTypeFontFile, unsigned short fontHeight);
 	~Font();
 
-	// returns the OpenGL texture handle
-	unsigned int	getTextureHandle() const { return m_glHandle; }
+	Font(const Font&) = delete;
+	Font& operator = (const Font&) = delete;
+
+	// returns the OpenGL texture handle, shared with other fonts of the typeface
+	unsigned int	getTextureHandle() const;
+
+	unsigned short	getFontHeight() const { return m_fontHeight; }
 
 	// returns size of string using this font
 	float getStringWidth(const char* str);
@@ -25,11 +39,89 @@ public:
 	// returns a rectangle that fits the string, with x0y0 being bottom left, x1y1 top right
 	void getStringRectangle(const char* str, float& x0, float& y0, float& x1, float& y1);
 
-private:
+	// glyphs currently in the typeface's texture, and how many times it has been cleared out to make room
+	unsigned int getResidentGlyphCount() const;
+	unsigned int getEvictionCount() const;
+
+	// strings are laid out once and cached, so static text is measured and drawn without
+	// looking up its glyphs again. the cache can be turned off to compare against
+	void setRunCacheEnabled(bool enabled);
+	bool isRunCacheEnabled() const { return m_runCacheEnabled; }
+
+	// run cache lookups since the last reset
+	unsigned int getRunHits() const { return m_runHits; }
+	unsigned int getRunMisses() const { return m_runMisses; }
+	void resetRunStats() { m_runHits = 0; m_runMisses = 0; }
+
+	// returns the codepoint at the start of a utf-8 string and moves past it
+	static int nextCodepoint(const char*& str);
+
+protected:
+
+	// a glyph's rectangle on screen, y down from the baseline, and in the texture
+	struct Quad {
+		float x0, y0, x1, y1;
+		float s0, t0, s1, t1;
+	};
+
+	// glyph metrics are at the size the typeface's distance fields are made at
+	struct Glyph {
+		int				index;
+
+		// bounds of the glyph's outline relative to the pen, and how far the pen moves
+		int				x0, y0, x1, y1;
+		float			advance;
+
+		// where its distance field is in the texture, if it is. the field extends
+		// past the outline's bounds so that it can fall off outside the edge
+		bool			resident;
+		unsigned int	atlasX, atlasY;
+		unsigned int	lastUsed;
+	};
+
+	// the glyphs and texture shared by the fonts of a typeface
+	class Face;
+
+	// a string laid out from the origin
+	struct Run {
+		std::string			text;
+
+		// the glyphs with something to draw and their quads
+		std::vector<Glyph*>	glyphs;
+		std::vector<Quad>	quads;
+
+		// the right of the last glyph, and the bounds of them all, y down
+		float				width;
+		float				x0, y0, x1, y1;
+
+		// the texture generation the quads' texture coords are for, 0 if they aren't all set
+		unsigned int		generation;
+		unsigned int		lastUsed;
+	};
+
+	// the run for a string, laying it out if it isn't cached. if textured, its glyphs are put in
+	// the texture and the texture coords filled in, moved being set if other glyphs had to move
+	// to make room, which leaves quads from before the call pointing at the wrong ones
+	const Run& getRun(const char* str, bool textured, bool& moved);
+
+	void layoutRun(Run& run, const char* str);
+
+	// uploads the parts of the texture changed since the last call
+	void updateTexture();
+
+	Face*			m_face;
+	unsigned short	m_fontHeight;
+
+	// from the face's size to this font's
+	float			m_scale;
 
-	void*			m_glyphData;
-	unsigned int	m_glHandle, m_pixelBufferHandle;
-	unsigned short	m_textureWidth, m_textureHeight;
+	// runs keyed on the hash of their string, or the one run laid out each time with the cache off
+	std::unordered_map<unsigned long long, Run>	m_runs;
+	Run				m_uncachedRun;
+	bool			m_runCacheEnabled;
+	unsigned int	m_runTick;
+	unsigned int	m_runHits;
+	unsigned int	m_runMisses;
 };
 
 } // namespace aie
\ No newline at end of file
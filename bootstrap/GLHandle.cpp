@@ -0,0 +1,60 @@
+#include "gl_core_4_4.h"
+#include "GLHandle.h"
+#include "GLState.h"
+
+namespace aie {
+
+DeletionQueue* DeletionQueue::m_instance = nullptr;
+
+DeletionQueue::DeletionQueue()
+	: m_frame(0) {
+}
+
+DeletionQueue::~DeletionQueue() {
+	for (auto& entry : m_entries)
+		deleteObject(entry.type, entry.name);
+}
+
+void DeletionQueue::release(GLObject type, unsigned int name) {
+	if (m_instance == nullptr) {
+		deleteObject(type, name);
+		return;
+	}
+
+	Entry entry;
+	entry.type = type;
+	entry.name = name;
+	entry.frame = m_instance->m_frame;
+	m_instance->m_entries.push_back(entry);
+}
+
+void DeletionQueue::advanceFrame() {
+	m_frame++;
+
+	// entries are queued in frame order, so everything old enough is at the front
+	size_t count = 0;
+	while (count < m_entries.size() &&
+		   m_frame - m_entries[count].frame >= FRAME_DELAY) {
+		deleteObject(m_entries[count].type, m_entries[count].name);
+		count++;
+	}
+
+	m_entries.erase(m_entries.begin(), m_entries.begin() + count);
+}
+
+void DeletionQueue::deleteObject(GLObject type, unsigned int name) {
+
+	// the name can be handed out again, so it mustn't still be shadowed as bound
+	if (type == GLObject::VertexArray)
+		GLState::forgetVertexArray(name);
+
+	switch (type) {
+	case GLObject::Buffer:			glDeleteBuffers(1, &name);			break;
+	case GLObject::VertexArray:		glDeleteVertexArrays(1, &name);		break;
+	case GLObject::Texture:			glDeleteTextures(1, &name);			break;
+	case GLObject::Framebuffer:		glDeleteFramebuffers(1, &name);		break;
+	case GLObject::Renderbuffer:	glDeleteRenderbuffers(1, &name);	break;
+	};
+}
+
+} // namespace aie
\ No newline at end of file
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <vector>
+
+namespace aie {
+
+// the kinds of opengl object a handle can own
+enum class GLObject {
+	Buffer,
+	VertexArray,
+	Texture,
+	Framebuffer,
+	Renderbuffer,
+};
+
+// holds on to released opengl objects for a few frames so that objects the gpu may
+// still be using are deleted once it has finished with them, rather than stalling.
+// if no queue exists objects are deleted immediately
+class DeletionQueue {
+public:
+
+	static DeletionQueue* getInstance() { return m_instance; }
+
+	// queues the object for deletion, or deletes it now if there is no queue
+	static void release(GLObject type, unsigned int name);
+
+	// objects released this many frames ago are deleted
+	enum { FRAME_DELAY = 3 };
+
+protected:
+
+	// just giving the Application class access to the DeletionQueue singleton
+	friend class Application;
+
+	// singleton pointer
+	static DeletionQueue* m_instance;
+
+	// only want the Application class to be able to create / destroy
+	static void create()			{ m_instance = new DeletionQueue(); }
+	static void destroy()			{ delete m_instance; m_instance = nullptr; }
+
+	// should be called once by the application each frame after presenting
+	void advanceFrame();
+
+private:
+
+	// constructor private for singleton, destruction deletes everything still queued
+	DeletionQueue();
+	~DeletionQueue();
+
+	static void deleteObject(GLObject type, unsigned int name);
+
+	struct Entry {
+		GLObject		type;
+		unsigned int	name;
+		unsigned int	frame;
+	};
+
+	std::vector<Entry>	m_entries;
+	unsigned int		m_frame;
+};
+
+// move-only ownership of a single opengl object name, released through the deletion queue.
+// converts to the raw name so it can be passed straight to gl calls
+template <GLObject Type>
+class GLHandle {
+public:
+
+	GLHandle() : m_name(0) {}
+	explicit GLHandle(unsigned int name) : m_name(name) {}
+	~GLHandle() { reset(); }
+
+	GLHandle(const GLHandle&) = delete;
+	GLHandle& operator = (const GLHandle&) = delete;
+
+	GLHandle(GLHandle&& other) noexcept : m_name(other.m_name) { other.m_name = 0; }
+	GLHandle& operator = (GLHandle&& other) noexcept {
+		if (this != &other) {
+			reset();
+			m_name = other.m_name;
+			other.m_name = 0;
+		}
+		return *this;
+	}
+
+	operator unsigned int() const { return m_name; }
+	unsigned int get() const { return m_name; }
+
+	// releases the current object and returns somewhere for glGen* to write a new name
+	unsigned int* put() { reset(); return &m_name; }
+
+	// releases the current object, optionally taking ownership of another
+	void reset(unsigned int name = 0) {
+		if (m_name != 0)
+			DeletionQueue::release(Type, m_name);
+		m_name = name;
+	}
+
+private:
+
+	unsigned int	m_name;
+};
+
+typedef GLHandle<GLObject::Buffer>			BufferHandle;
+typedef GLHandle<GLObject::VertexArray>		VertexArrayHandle;
+typedef GLHandle<GLObject::Texture>			TextureHandle;
+typedef GLHandle<GLObject::Framebuffer>		FramebufferHandle;
+typedef GLHandle<GLObject::Renderbuffer>	RenderbufferHandle;
+
+} // namespace aie
\ No newline at end of file
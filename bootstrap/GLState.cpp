@@ -0,0 +1,37 @@
+#include "gl_core_4_4.h"
+#include "GLState.h"
+
+namespace aie {
+
+unsigned int GLState::sm_vertexArray = GLState::UNKNOWN;
+unsigned int GLState::sm_program = GLState::UNKNOWN;
+
+bool GLState::bindVertexArray(unsigned int vao) {
+	if (vao == sm_vertexArray)
+		return false;
+
+	glBindVertexArray(vao);
+	sm_vertexArray = vao;
+	return true;
+}
+
+bool GLState::useProgram(unsigned int program) {
+	if (program == sm_program)
+		return false;
+
+	glUseProgram(program);
+	sm_program = program;
+	return true;
+}
+
+void GLState::invalidate() {
+	sm_vertexArray = UNKNOWN;
+	sm_program = UNKNOWN;
+}
+
+void GLState::forgetVertexArray(unsigned int vao) {
+	if (vao == sm_vertexArray)
+		sm_vertexArray = 0;
+}
+
+} // namespace aie
@@ -0,0 +1,34 @@
+#pragma once
+
+namespace aie {
+
+// a cpu side copy of the bound vertex array and program, so redundant binds can be skipped and
+// the bindings checked without asking the driver. code that binds either goes through here, and
+// anything that binds them directly either restores the previous binding or calls invalidate() afterwards
+class GLState {
+public:
+
+	// binds the vertex array unless it already is, returning true if it had to be bound
+	static bool bindVertexArray(unsigned int vao);
+	static unsigned int getVertexArray() { return sm_vertexArray; }
+
+	// uses the program unless it already is, returning true if it had to be bound
+	static bool useProgram(unsigned int program);
+	static unsigned int getProgram() { return sm_program; }
+
+	// forgets what is bound, so the next bind always reaches gl. the application does this every frame
+	static void invalidate();
+
+	// deleting a bound vertex array unbinds it, and the name can then be reused by a new one
+	static void forgetVertexArray(unsigned int vao);
+
+private:
+
+	// UNKNOWN when the binding may have changed behind our back
+	enum : unsigned int { UNKNOWN = 0xffffffff };
+
+	static unsigned int	sm_vertexArray;
+	static unsigned int	sm_program;
+};
+
+} // namespace aie
@@ -1,8 +1,12 @@
 #include "Gizmos.h"
 #include "gl_core_4_4.h"
+#include "GLState.h"
+#include "ProgramCache.h"
+#include "RingBuffer.h"
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
 #include <iostream>
+#include <string.h>
 
 namespace aie {
 
@@ -37,101 +41,25 @@ Gizmos::Gizmos(unsigned int maxLines, unsigned int maxTris,
 					 in vec4 vColour; \
                      out vec4 FragColor; \
 					 void main()	{ FragColor = vColour; }";
-    
-    
-	unsigned int vs = glCreateShader(GL_VERTEX_SHADER);
-	unsigned int fs = glCreateShader(GL_FRAGMENT_SHADER);
-
-	glShaderSource(vs, 1, (const char**)&vsSource, 0);
-	glCompileShader(vs);
-
-	glShaderSource(fs, 1, (const char**)&fsSource, 0);
-	glCompileShader(fs);
-
-	m_shader = glCreateProgram();
-	glAttachShader(m_shader, vs);
-	glAttachShader(m_shader, fs);
-	glBindAttribLocation(m_shader, 0, "Position");
-	glBindAttribLocation(m_shader, 1, "Colour");
-	glLinkProgram(m_shader);
-    
-	int success = GL_FALSE;
-    glGetProgramiv(m_shader, GL_LINK_STATUS, &success);
-	if (success == GL_FALSE) {
-		int infoLogLength = 0;
-		glGetProgramiv(m_shader, GL_INFO_LOG_LENGTH, &infoLogLength);
-		char* infoLog = new char[infoLogLength + 1];
-        
-		glGetProgramInfoLog(m_shader, infoLogLength, 0, infoLog);
-		printf("Error: Failed to link Gizmo shader program!\n%s\n", infoLog);
-		delete[] infoLog;
-	}
 
-	glDeleteShader(vs);
-	glDeleteShader(fs);
+	const char* attributes[] = { "Position", "Colour" };
+	m_shader = ProgramCache::createProgram("Gizmo", vsSource, fsSource, attributes, 2);
     
-    // create VBOs
-	glGenBuffers( 1, &m_lineVBO );
-	glBindBuffer(GL_ARRAY_BUFFER, m_lineVBO);
-	glBufferData(GL_ARRAY_BUFFER, m_maxLines * sizeof(GizmoLine), m_lines, GL_DYNAMIC_DRAW);
-
-	glGenBuffers( 1, &m_triVBO );
-	glBindBuffer(GL_ARRAY_BUFFER, m_triVBO);
-	glBufferData(GL_ARRAY_BUFFER, m_maxTris * sizeof(GizmoTri), m_tris, GL_DYNAMIC_DRAW);
-
-	glGenBuffers( 1, &m_transparentTriVBO );
-	glBindBuffer(GL_ARRAY_BUFFER, m_transparentTriVBO);
-	glBufferData(GL_ARRAY_BUFFER, m_maxTris * sizeof(GizmoTri), m_transparentTris, GL_DYNAMIC_DRAW);
-
-	glGenBuffers( 1, &m_2DlineVBO );
-	glBindBuffer(GL_ARRAY_BUFFER, m_2DlineVBO);
-	glBufferData(GL_ARRAY_BUFFER, m_max2DLines * sizeof(GizmoLine), m_2Dlines, GL_DYNAMIC_DRAW);
-
-	glGenBuffers( 1, &m_2DtriVBO );
-	glBindBuffer(GL_ARRAY_BUFFER, m_2DtriVBO);
-	glBufferData(GL_ARRAY_BUFFER, m_max2DTris * sizeof(GizmoTri), m_2Dtris, GL_DYNAMIC_DRAW);
-
-	glGenVertexArrays(1, &m_lineVAO);
-	glBindVertexArray(m_lineVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, m_lineVBO);
+	// one ring streams every gizmo type, sized for three frames of full buffers
+	unsigned int frameSize = (m_maxLines + m_max2DLines) * sizeof(GizmoLine) +
+							 (m_maxTris * 2 + m_max2DTris) * sizeof(GizmoTri);
+	m_streamBuffer = new RingBuffer(frameSize * 3 + sizeof(GizmoVertex) * 5);
+
+	// draws select their part of the ring through the first vertex
+	glGenVertexArrays(1, &m_vao);
+	GLState::bindVertexArray(m_vao);
+	glBindBuffer(GL_ARRAY_BUFFER, m_streamBuffer->getHandle());
 	glEnableVertexAttribArray(0);
 	glEnableVertexAttribArray(1);
 	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), 0);
 	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), (void*)16);
 
-	glGenVertexArrays(1, &m_triVAO);
-	glBindVertexArray(m_triVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, m_triVBO);
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), 0);
-	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), (void*)16);
-
-	glGenVertexArrays(1, &m_transparentTriVAO);
-	glBindVertexArray(m_transparentTriVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, m_transparentTriVBO);
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), 0);
-	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), (void*)16);
-
-	glGenVertexArrays(1, &m_2DlineVAO);
-	glBindVertexArray(m_2DlineVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, m_2DlineVBO);
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), 0);
-	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), (void*)16);
-
-	glGenVertexArrays(1, &m_2DtriVAO);
-	glBindVertexArray(m_2DtriVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, m_2DtriVBO);
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), 0);
-	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), (void*)16);
-
-	glBindVertexArray(0);
+	GLState::bindVertexArray(0);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
@@ -139,18 +67,11 @@ Gizmos::~Gizmos() {
 	delete[] m_lines;
 	delete[] m_tris;
 	delete[] m_transparentTris;
-	glDeleteBuffers( 1, &m_lineVBO );
-	glDeleteBuffers( 1, &m_triVBO );
-	glDeleteBuffers( 1, &m_transparentTriVBO );
-	glDeleteVertexArrays( 1, &m_lineVAO );
-	glDeleteVertexArrays( 1, &m_triVAO );
-	glDeleteVertexArrays( 1, &m_transparentTriVAO );
 	delete[] m_2Dlines;
 	delete[] m_2Dtris;
-	glDeleteBuffers( 1, &m_2DlineVBO );
-	glDeleteBuffers( 1, &m_2DtriVBO );
-	glDeleteVertexArrays( 1, &m_2DlineVAO );
-	glDeleteVertexArrays( 1, &m_2DtriVAO );
+	GLState::forgetVertexArray(m_vao);
+	glDeleteVertexArrays( 1, &m_vao );
+	delete m_streamBuffer;
 	glDeleteProgram(m_shader);
 }
 
@@ -946,19 +867,11 @@ void Gizmos::draw(const glm::mat4& projectionView) {
 		glUniformMatrix4fv(projectionViewUniform, 1, false, glm::value_ptr(projectionView));
 
 		if (sm_singleton->m_lineCount > 0) {
-			glBindBuffer(GL_ARRAY_BUFFER, sm_singleton->m_lineVBO);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, sm_singleton->m_lineCount * sizeof(GizmoLine), sm_singleton->m_lines);
-
-			glBindVertexArray(sm_singleton->m_lineVAO);
-			glDrawArrays(GL_LINES, 0, sm_singleton->m_lineCount * 2);
+			drawStream(GL_LINES, sm_singleton->m_lines, sm_singleton->m_lineCount * 2);
 		}
 
 		if (sm_singleton->m_triCount > 0) {
-			glBindBuffer(GL_ARRAY_BUFFER, sm_singleton->m_triVBO);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, sm_singleton->m_triCount * sizeof(GizmoTri), sm_singleton->m_tris);
-
-			glBindVertexArray(sm_singleton->m_triVAO);
-			glDrawArrays(GL_TRIANGLES, 0, sm_singleton->m_triCount * 3);
+			drawStream(GL_TRIANGLES, sm_singleton->m_tris, sm_singleton->m_triCount * 3);
 		}
 		
 		if (sm_singleton->m_transparentTriCount > 0) {
@@ -977,11 +890,7 @@ void Gizmos::draw(const glm::mat4& projectionView) {
 			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 			glDepthMask(GL_FALSE);
 
-			glBindBuffer(GL_ARRAY_BUFFER, sm_singleton->m_transparentTriVBO);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, sm_singleton->m_transparentTriCount * sizeof(GizmoTri), sm_singleton->m_transparentTris);
-
-			glBindVertexArray(sm_singleton->m_transparentTriVAO);
-			glDrawArrays(GL_TRIANGLES, 0, sm_singleton->m_transparentTriCount * 3);
+			drawStream(GL_TRIANGLES, sm_singleton->m_transparentTris, sm_singleton->m_transparentTriCount * 3);
 
 			// reset state
 			glDepthMask(depthMask);
@@ -990,6 +899,9 @@ void Gizmos::draw(const glm::mat4& projectionView) {
 				glDisable(GL_BLEND);
 		}
 
+		// the ring can reuse this frame's space once these draws complete
+		sm_singleton->m_streamBuffer->fence();
+
 		glUseProgram(shader);
 	}
 }
@@ -1011,11 +923,7 @@ void Gizmos::draw2D(const glm::mat4& projection) {
 		glUniformMatrix4fv(projectionViewUniform, 1, false, glm::value_ptr(projection));
 
 		if (sm_singleton->m_2DlineCount > 0) {
-			glBindBuffer(GL_ARRAY_BUFFER, sm_singleton->m_2DlineVBO);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, sm_singleton->m_2DlineCount * sizeof(GizmoLine), sm_singleton->m_2Dlines);
-
-			glBindVertexArray(sm_singleton->m_2DlineVAO);
-			glDrawArrays(GL_LINES, 0, sm_singleton->m_2DlineCount * 2);
+			drawStream(GL_LINES, sm_singleton->m_2Dlines, sm_singleton->m_2DlineCount * 2);
 		}
 
 		if (sm_singleton->m_2DtriCount > 0) {
@@ -1035,11 +943,7 @@ void Gizmos::draw2D(const glm::mat4& projection) {
 
 			glDepthMask(GL_FALSE);
 
-			glBindBuffer(GL_ARRAY_BUFFER, sm_singleton->m_2DtriVBO);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, sm_singleton->m_2DtriCount * sizeof(GizmoTri), sm_singleton->m_2Dtris);
-
-			glBindVertexArray(sm_singleton->m_2DtriVAO);
-			glDrawArrays(GL_TRIANGLES, 0, sm_singleton->m_2DtriCount * 3);
+			drawStream(GL_TRIANGLES, sm_singleton->m_2Dtris, sm_singleton->m_2DtriCount * 3);
 
 			glDepthMask(depthMask);
 
@@ -1049,8 +953,20 @@ void Gizmos::draw2D(const glm::mat4& projection) {
 				glDisable(GL_BLEND);
 		}
 
+		// the ring can reuse this frame's space once these draws complete
+		sm_singleton->m_streamBuffer->fence();
+
 		glUseProgram(shader);
 	}
 }
 
+void Gizmos::drawStream(unsigned int primitive, const void* vertices, unsigned int vertexCount) {
+	unsigned int offset = 0;
+	void* data = sm_singleton->m_streamBuffer->allocate(vertexCount * sizeof(GizmoVertex), sizeof(GizmoVertex), offset);
+	memcpy(data, vertices, vertexCount * sizeof(GizmoVertex));
+
+	GLState::bindVertexArray(sm_singleton->m_vao);
+	glDrawArrays(primitive, offset / sizeof(GizmoVertex), vertexCount);
+}
+
 } // namespace aie
\ No newline at end of file
@@ -4,6 +4,8 @@
 
 namespace aie {
 
+class RingBuffer;
+
 // a singleton class for rendering immediate-mode 3-D primitives
 class Gizmos {
 public:
@@ -89,6 +91,9 @@ public:
 	static void		add2DAABB(const glm::vec2& center, const glm::vec2& extents, const glm::vec4& colour, const glm::mat4* transform = nullptr);	
 	static void		add2DAABBFilled(const glm::vec2& center, const glm::vec2& extents, const glm::vec4& colour, const glm::mat4* transform = nullptr);	
 	static void		add2DCircle(const glm::vec2& center, float radius, unsigned int segments, const glm::vec4& colour, const glm::mat4* transform = nullptr);
+
+	// the ring buffer that gizmo vertices are streamed through, for its stall statistics
+	static RingBuffer*	getStreamBuffer() { return sm_singleton != nullptr ? sm_singleton->m_streamBuffer : nullptr; }
 	
 private:
 
@@ -112,46 +117,38 @@ private:
 		GizmoVertex v2;
 	};
 
+	// copies vertices in to the ring buffer and draws them
+	static void		drawStream(unsigned int primitive, const void* vertices, unsigned int vertexCount);
+
 	unsigned int	m_shader;
 
+	// all vertices are streamed through the one ring buffer and vertex array
+	RingBuffer*		m_streamBuffer;
+	unsigned int	m_vao;
+
 	// line data
 	unsigned int	m_maxLines;
 	unsigned int	m_lineCount;
 	GizmoLine*		m_lines;
 
-	unsigned int	m_lineVAO;
-	unsigned int 	m_lineVBO;
-
 	// triangle data
 	unsigned int	m_maxTris;
 	unsigned int	m_triCount;
 	GizmoTri*		m_tris;
-
-	unsigned int	m_triVAO;
-	unsigned int 	m_triVBO;
 	
 	unsigned int	m_transparentTriCount;
 	GizmoTri*		m_transparentTris;
-
-	unsigned int	m_transparentTriVAO;
-	unsigned int 	m_transparentTriVBO;
 	
 	// 2D line data
 	unsigned int	m_max2DLines;
 	unsigned int	m_2DlineCount;
 	GizmoLine*		m_2Dlines;
 
-	unsigned int	m_2DlineVAO;
-	unsigned int 	m_2DlineVBO;
-
 	// 2D triangle data
 	unsigned int	m_max2DTris;
 	unsigned int	m_2DtriCount;
 	GizmoTri*		m_2Dtris;
 
-	unsigned int	m_2DtriVAO;
-	unsigned int 	m_2DtriVBO;
-
 	static Gizmos*	sm_singleton;
 };
 
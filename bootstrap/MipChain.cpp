@@ -0,0 +1,261 @@
+#include "MipChain.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <emmintrin.h>
+#include <thread>
+
+#define STB_IMAGE_RESIZE_IMPLEMENTATION
+#include <stb_image_resize.h>
+
+namespace aie {
+
+// precision of the linear to srgb table, enough that every srgb value has its own entry
+static const int SRGB_ENCODE_SIZE = 4096;
+
+// levels smaller than this many pixels aren't worth starting threads for
+static const unsigned int PARALLEL_PIXELS = 64 * 1024;
+
+struct SrgbTables {
+	float			decode[256];
+	float			identity[256];
+	unsigned char	encode[SRGB_ENCODE_SIZE];
+
+	SrgbTables() {
+		for (int i = 0; i < 256; ++i) {
+			float value = i / 255.0f;
+			decode[i] = value <= 0.04045f ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f);
+			identity[i] = value;
+		}
+		for (int i = 0; i < SRGB_ENCODE_SIZE; ++i) {
+			float value = i / (float)(SRGB_ENCODE_SIZE - 1);
+			value = value <= 0.0031308f ? value * 12.92f : 1.055f * powf(value, 1 / 2.4f) - 0.055f;
+			encode[i] = (unsigned char)(value * 255 + 0.5f);
+		}
+	}
+};
+
+static const SrgbTables& getSrgbTables() {
+	static SrgbTables tables;
+	return tables;
+}
+
+unsigned int MipChain::getLevelWidth(unsigned int level) const {
+	return std::max(m_width >> level, 1u);
+}
+
+unsigned int MipChain::getLevelHeight(unsigned int level) const {
+	return std::max(m_height >> level, 1u);
+}
+
+void MipChain::generate(const unsigned char* pixels, unsigned int width, unsigned int height,
+						unsigned int channels, bool srgb) {
+	assert(channels >= 1 && channels <= 4);
+
+	m_width = width;
+	m_height = height;
+	m_channels = channels;
+	m_srgb = srgb;
+
+	unsigned int levelCount = 1;
+	while ((width >> levelCount) > 0 || (height >> levelCount) > 0)
+		++levelCount;
+
+	m_levels.clear();
+	m_levels.resize(levelCount);
+	m_levels[0].assign(pixels, pixels + width * height * channels);
+
+	// tables are built before any threads use them
+	getSrgbTables();
+
+	unsigned int threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+	for (unsigned int level = 1; level < levelCount; ++level) {
+		unsigned int levelWidth = getLevelWidth(level);
+		unsigned int levelHeight = getLevelHeight(level);
+		m_levels[level].resize(levelWidth * levelHeight * channels);
+
+		if (threadCount == 1 ||
+			levelWidth * levelHeight < PARALLEL_PIXELS) {
+			downsample(level, 0, levelHeight);
+			continue;
+		}
+
+		// a band of rows per thread, this thread taking the last
+		std::vector<std::thread> threads;
+		unsigned int band = (levelHeight + threadCount - 1) / threadCount;
+		for (unsigned int first = 0; first + band < levelHeight; first += band)
+			threads.emplace_back(&MipChain::downsample, this, level, first, first + band);
+
+		downsample(level, (unsigned int)threads.size() * band, levelHeight);
+
+		for (auto& thread : threads)
+			thread.join();
+	}
+}
+
+// the texels of the level above that one output texel covers along an axis, and how much of each.
+// even sizes halve exactly, odd sizes cover two and a half texels, sharing the outer ones with their
+// neighbours, so that every texel of the level above counts for the same in the level below
+struct FilterTaps {
+	unsigned int	index[3];
+	float			weight[3];
+	unsigned int	count;
+};
+
+static FilterTaps getFilterTaps(unsigned int i, unsigned int sourceSize) {
+	FilterTaps taps;
+	if (sourceSize == 1) {
+		taps.index[0] = 0;
+		taps.weight[0] = 1;
+		taps.count = 1;
+	}
+	else if (sourceSize % 2 == 0) {
+		taps.index[0] = i * 2;
+		taps.index[1] = i * 2 + 1;
+		taps.weight[0] = taps.weight[1] = 0.5f;
+		taps.count = 2;
+	}
+	else {
+		unsigned int size = sourceSize / 2;
+		taps.index[0] = i * 2;
+		taps.index[1] = i * 2 + 1;
+		taps.index[2] = i * 2 + 2;
+		taps.weight[0] = (size - i) / (float)sourceSize;
+		taps.weight[1] = size / (float)sourceSize;
+		taps.weight[2] = (i + 1) / (float)sourceSize;
+		taps.count = 3;
+	}
+	return taps;
+}
+
+void MipChain::downsample(unsigned int level, unsigned int first, unsigned int last) {
+	const SrgbTables& tables = getSrgbTables();
+
+	unsigned int channels = m_channels;
+	unsigned int sourceWidth = getLevelWidth(level - 1);
+	unsigned int sourceHeight = getLevelHeight(level - 1);
+	unsigned int width = getLevelWidth(level);
+	const unsigned char* source = m_levels[level - 1].data();
+	unsigned char* destination = m_levels[level].data();
+
+	// which channels are stored as srgb, alpha never is
+	bool hasAlpha = channels == 2 || channels == 4;
+	bool isSrgb[4] = { false, false, false, false };
+	bool anySrgb = false;
+	const float* decode[4];
+	for (unsigned int c = 0; c < channels; ++c) {
+		isSrgb[c] = m_srgb && (hasAlpha == false || c != channels - 1);
+		decode[c] = isSrgb[c] ? tables.decode : tables.identity;
+		anySrgb = anySrgb || isSrgb[c];
+	}
+
+	// 4 channel images with nothing to decode are widened to floats and packed back to bytes
+	// 16 at a time, everything else goes through the tables a channel at a time
+	bool packed = channels == 4 && anySrgb == false;
+
+	// scales the filtered values to an index in the encode table, or straight to a byte
+	float scale[4] = { 255.0f, 255.0f, 255.0f, 255.0f };
+	for (unsigned int c = 0; c < channels; ++c)
+		scale[c] = isSrgb[c] ? SRGB_ENCODE_SIZE - 1.0f : 255.0f;
+	__m128 scaleLanes = _mm_loadu_ps(scale);
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128 byteToFloat = _mm_set1_ps(1 / 255.0f);
+	__m128i zero = _mm_setzero_si128();
+
+	// a texel is always four floats, whatever the channel count, so that it fills one register
+	std::vector<float> decoded(sourceWidth * 4);
+	std::vector<float> filtered(sourceWidth * 4);
+
+	std::vector<FilterTaps> columns(width);
+	for (unsigned int x = 0; x < width; ++x)
+		columns[x] = getFilterTaps(x, sourceWidth);
+
+	for (unsigned int y = first; y < last; ++y) {
+		FilterTaps rows = getFilterTaps(y, sourceHeight);
+
+		// filter down the rows first, across the whole width
+		for (unsigned int r = 0; r < rows.count; ++r) {
+			const unsigned char* row = source + rows.index[r] * sourceWidth * channels;
+
+			unsigned int x = 0;
+			if (packed) {
+				for (; x + 4 <= sourceWidth; x += 4) {
+					__m128i bytes = _mm_loadu_si128((const __m128i*)(row + x * 4));
+					__m128i low = _mm_unpacklo_epi8(bytes, zero);
+					__m128i high = _mm_unpackhi_epi8(bytes, zero);
+					_mm_storeu_ps(&decoded[(x + 0) * 4], _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero)), byteToFloat));
+					_mm_storeu_ps(&decoded[(x + 1) * 4], _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero)), byteToFloat));
+					_mm_storeu_ps(&decoded[(x + 2) * 4], _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero)), byteToFloat));
+					_mm_storeu_ps(&decoded[(x + 3) * 4], _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(high, zero)), byteToFloat));
+				}
+			}
+			for (; x < sourceWidth; ++x) {
+				float texel[4] = { 0, 0, 0, 0 };
+				for (unsigned int c = 0; c < channels; ++c)
+					texel[c] = decode[c][row[x * channels + c]];
+				memcpy(&decoded[x * 4], texel, sizeof(texel));
+			}
+
+			__m128 weight = _mm_set1_ps(rows.weight[r]);
+			if (r == 0) {
+				for (x = 0; x < sourceWidth; ++x)
+					_mm_storeu_ps(&filtered[x * 4], _mm_mul_ps(_mm_loadu_ps(&decoded[x * 4]), weight));
+			}
+			else {
+				for (x = 0; x < sourceWidth; ++x)
+					_mm_storeu_ps(&filtered[x * 4], _mm_add_ps(_mm_loadu_ps(&filtered[x * 4]),
+															   _mm_mul_ps(_mm_loadu_ps(&decoded[x * 4]), weight)));
+			}
+		}
+
+		// then across the columns, rounding each texel to its table index or byte
+		unsigned char* output = destination + y * width * channels;
+		for (unsigned int x = 0; x < width; ++x) {
+			const FilterTaps& taps = columns[x];
+			__m128 sum = _mm_mul_ps(_mm_loadu_ps(&filtered[taps.index[0] * 4]), _mm_set1_ps(taps.weight[0]));
+			for (unsigned int t = 1; t < taps.count; ++t)
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(&filtered[taps.index[t] * 4]), _mm_set1_ps(taps.weight[t])));
+			__m128i index = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(sum, one), scaleLanes));
+
+			if (packed) {
+				index = _mm_packs_epi32(index, index);
+				int bytes = _mm_cvtsi128_si32(_mm_packus_epi16(index, index));
+				memcpy(output + x * 4, &bytes, 4);
+			}
+			else {
+				int lanes[4];
+				_mm_storeu_si128((__m128i*)lanes, index);
+				for (unsigned int c = 0; c < channels; ++c)
+					output[x * channels + c] = isSrgb[c] ? tables.encode[lanes[c]] : (unsigned char)lanes[c];
+			}
+		}
+	}
+}
+
+int MipChain::validate() const {
+	if (m_levels.size() < 2)
+		return 0;
+
+	unsigned int width = getLevelWidth(1), height = getLevelHeight(1);
+	std::vector<unsigned char> expected(width * height * m_channels);
+
+	// alpha is flagged as premultiplied so that it isn't used to weight the colour, as it isn't here
+	bool hasAlpha = m_channels == 2 || m_channels == 4;
+	stbir_resize_uint8_generic(m_levels[0].data(), m_width, m_height, 0,
+							   expected.data(), width, height, 0,
+							   m_channels, hasAlpha ? m_channels - 1 : STBIR_ALPHA_CHANNEL_NONE,
+							   STBIR_FLAG_ALPHA_PREMULTIPLIED, STBIR_EDGE_CLAMP, STBIR_FILTER_BOX,
+							   m_srgb ? STBIR_COLORSPACE_SRGB : STBIR_COLORSPACE_LINEAR, nullptr);
+
+	int largest = 0;
+	const std::vector<unsigned char>& level = m_levels[1];
+	for (size_t i = 0; i < expected.size(); ++i)
+		largest = std::max(largest, abs((int)level[i] - (int)expected[i]));
+
+	return largest;
+}
+
+} // namespace aie
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+
+namespace aie {
+
+// a full chain of mips for an 8-bit image, made on the cpu so that the result is the same on every
+// driver and can be cached. colour is averaged in linear space rather than as stored, so that the
+// mips of srgb images don't darken. odd sizes are box filtered over the two and a half texels each
+// output texel covers, rather than dropping their last row and column. the filter runs a texel to an
+// sse register, and large levels are split across threads
+class MipChain {
+public:
+
+	MipChain() : m_width(0), m_height(0), m_channels(0), m_srgb(false) {}
+
+	// builds every level down to 1x1, level 0 being a copy of the pixels. alpha, the last channel
+	// of 2 and 4 channel images, is always filtered as stored, as is everything when srgb is false,
+	// such as for normal maps and other data that isn't a colour
+	void generate(const unsigned char* pixels, unsigned int width, unsigned int height,
+				  unsigned int channels, bool srgb);
+
+	unsigned int getLevelCount() const { return (unsigned int)m_levels.size(); }
+	unsigned int getLevelWidth(unsigned int level) const;
+	unsigned int getLevelHeight(unsigned int level) const;
+
+	const std::vector<unsigned char>& getLevel(unsigned int level) const { return m_levels[level]; }
+
+	// lets the levels be moved out once generated
+	std::vector<std::vector<unsigned char>>& getLevels() { return m_levels; }
+
+	// largest difference in any channel between level 1 and stb_image_resize's box filter of level 0,
+	// for checking the filter against
+	int validate() const;
+
+private:
+
+	// filters rows [first, last) of a level from the level above
+	void downsample(unsigned int level, unsigned int first, unsigned int last);
+
+	unsigned int	m_width;
+	unsigned int	m_height;
+	unsigned int	m_channels;
+	bool			m_srgb;
+
+	std::vector<std::vector<unsigned char>>	m_levels;
+};
+
+} // namespace aie
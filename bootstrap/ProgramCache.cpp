@@ -0,0 +1,178 @@
+#include "gl_core_4_4.h"
+#include "ProgramCache.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <direct.h>
+
+namespace aie {
+
+ProgramCache* ProgramCache::m_instance = nullptr;
+
+// written ahead of each binary, so stale or foreign files are caught before reaching the driver
+struct ProgramCacheHeader {
+	unsigned int		magic;
+	unsigned int		format;
+	unsigned int		length;
+	unsigned int		padding;
+	unsigned long long	key;
+};
+
+static const unsigned int PROGRAM_CACHE_MAGIC = 0x4e494250; // "PBIN"
+
+ProgramCache::ProgramCache(const char* directory)
+	: m_directory(directory),
+	m_driverKey(HASH_SEED),
+	m_hits(0),
+	m_misses(0) {
+
+	// binaries only work with the driver that made them
+	m_driverKey = hash((const char*)glGetString(GL_VENDOR), m_driverKey);
+	m_driverKey = hash((const char*)glGetString(GL_RENDERER), m_driverKey);
+	m_driverKey = hash((const char*)glGetString(GL_VERSION), m_driverKey);
+
+	_mkdir(m_directory.c_str());
+}
+
+unsigned long long ProgramCache::hash(const void* data, size_t size, unsigned long long seed) {
+
+	// 64-bit FNV-1a
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; ++i) {
+		seed ^= bytes[i];
+		seed *= 1099511628211ull;
+	}
+	return seed;
+}
+
+unsigned long long ProgramCache::hash(const char* string, unsigned long long seed) {
+
+	// include the terminator so that chained strings can't run together
+	return string != nullptr ? hash(string, strlen(string) + 1, seed) : seed;
+}
+
+std::string ProgramCache::getPath(unsigned long long key) const {
+	char name[32];
+	sprintf_s(name, "/%016llx.bin", key);
+	return m_directory + name;
+}
+
+bool ProgramCache::load(unsigned int program, unsigned long long key) {
+	if (m_instance == nullptr)
+		return false;
+
+	key = hash(&key, sizeof(key), m_instance->m_driverKey);
+
+	FILE* file = nullptr;
+	fopen_s(&file, m_instance->getPath(key).c_str(), "rb");
+
+	bool loaded = false;
+	if (file != nullptr) {
+		ProgramCacheHeader header = {};
+		if (fread(&header, sizeof(header), 1, file) == 1 &&
+			header.magic == PROGRAM_CACHE_MAGIC &&
+			header.key == key) {
+
+			std::vector<char> binary(header.length);
+			if (fread(binary.data(), 1, header.length, file) == header.length) {
+
+				// the driver can still refuse a binary, such as after an update that kept the version string
+				glProgramBinary(program, header.format, binary.data(), header.length);
+
+				int success = GL_FALSE;
+				glGetProgramiv(program, GL_LINK_STATUS, &success);
+				loaded = success == GL_TRUE;
+			}
+		}
+		fclose(file);
+	}
+
+	if (loaded)
+		m_instance->m_hits++;
+	else
+		m_instance->m_misses++;
+
+	return loaded;
+}
+
+void ProgramCache::store(unsigned int program, unsigned long long key) {
+	if (m_instance == nullptr)
+		return;
+
+	key = hash(&key, sizeof(key), m_instance->m_driverKey);
+
+	int length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	ProgramCacheHeader header = {};
+	header.magic = PROGRAM_CACHE_MAGIC;
+	header.length = (unsigned int)length;
+	header.key = key;
+
+	std::vector<char> binary(length);
+	glGetProgramBinary(program, length, nullptr, &header.format, binary.data());
+
+	FILE* file = nullptr;
+	fopen_s(&file, m_instance->getPath(key).c_str(), "wb");
+	if (file == nullptr)
+		return;
+
+	fwrite(&header, sizeof(header), 1, file);
+	fwrite(binary.data(), 1, binary.size(), file);
+	fclose(file);
+}
+
+unsigned int ProgramCache::createProgram(const char* name, const char* vertexSource, const char* fragmentSource,
+										 const char* const* attributes, unsigned int attributeCount) {
+
+	unsigned long long key = hash(vertexSource);
+	key = hash(fragmentSource, key);
+	for (unsigned int i = 0; i < attributeCount; ++i)
+		key = hash(attributes[i], key);
+
+	unsigned int program = glCreateProgram();
+	if (load(program, key))
+		return program;
+
+	unsigned int vs = glCreateShader(GL_VERTEX_SHADER);
+	unsigned int fs = glCreateShader(GL_FRAGMENT_SHADER);
+
+	glShaderSource(vs, 1, &vertexSource, 0);
+	glCompileShader(vs);
+
+	glShaderSource(fs, 1, &fragmentSource, 0);
+	glCompileShader(fs);
+
+	glAttachShader(program, vs);
+	glAttachShader(program, fs);
+	for (unsigned int i = 0; i < attributeCount; ++i)
+		glBindAttribLocation(program, i, attributes[i]);
+	glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(program);
+
+	int success = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (success == GL_FALSE) {
+		int infoLogLength = 0;
+		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &infoLogLength);
+		char* infoLog = new char[infoLogLength + 1];
+
+		glGetProgramInfoLog(program, infoLogLength, 0, infoLog);
+		printf("Error: Failed to link %s shader program!\n%s\n", name, infoLog);
+		delete[] infoLog;
+	}
+	else {
+		store(program, key);
+	}
+
+	glDetachShader(program, vs);
+	glDetachShader(program, fs);
+	glDeleteShader(vs);
+	glDeleteShader(fs);
+
+	return program;
+}
+
+} // namespace aie
\ No newline at end of file
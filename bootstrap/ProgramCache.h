@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+
+namespace aie {
+
+// saves linked program binaries to disk so later runs can skip compiling and linking.
+// binaries are keyed by a hash of everything that went in to the program plus the driver's
+// vendor, renderer and version, and anything the driver refuses is rebuilt from source.
+// if no cache exists programs are always built from source
+class ProgramCache {
+public:
+
+	static ProgramCache* getInstance() { return m_instance; }
+
+	// hashes data in to a key, pass a previous key as the seed to chain several inputs
+	static unsigned long long hash(const void* data, size_t size, unsigned long long seed = HASH_SEED);
+	static unsigned long long hash(const char* string, unsigned long long seed = HASH_SEED);
+
+	// loads a cached binary in to the program, returning false if there isn't a usable one
+	static bool load(unsigned int program, unsigned long long key);
+
+	// saves a linked program's binary. the program should have been linked with
+	// GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+	static void store(unsigned int program, unsigned long long key);
+
+	// creates a program from vertex and fragment sources, loading it from the cache if it can.
+	// attributes are bound to locations in the order given. link errors are printed using the name
+	static unsigned int createProgram(const char* name, const char* vertexSource, const char* fragmentSource,
+									  const char* const* attributes = nullptr, unsigned int attributeCount = 0);
+
+	// programs loaded from the cache, and programs built from source, since creation
+	unsigned int getHitCount() const { return m_hits; }
+	unsigned int getMissCount() const { return m_misses; }
+
+	static const unsigned long long HASH_SEED = 14695981039346656037ull;
+
+protected:
+
+	// just giving the Application class access to the ProgramCache singleton
+	friend class Application;
+
+	// singleton pointer
+	static ProgramCache* m_instance;
+
+	// only want the Application class to be able to create / destroy, once there is a context
+	static void create(const char* directory)	{ m_instance = new ProgramCache(directory); }
+	static void destroy()						{ delete m_instance; m_instance = nullptr; }
+
+private:
+
+	ProgramCache(const char* directory);
+	~ProgramCache() {}
+
+	std::string getPath(unsigned long long key) const;
+
+	std::string			m_directory;
+
+	// hash of the driver strings, mixed in to every key
+	unsigned long long	m_driverKey;
+
+	unsigned int		m_hits;
+	unsigned int		m_misses;
+};
+
+} // namespace aie
\ No newline at end of file
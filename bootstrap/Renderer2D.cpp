@@ -3,12 +3,34 @@
 #include "Renderer2D.h"
 #include "Texture.h"
 #include "Font.h"
+#include "GLState.h"
+#include "ProgramCache.h"
+#include "RingBuffer.h"
+#include "SpriteGrid.h"
+#include "TileLayer.h"
 #include <glm/ext.hpp>
-#include <stb_truetype.h>
+#include <string.h>
+#include <algorithm>
 
 namespace aie {
 
-Renderer2D::Renderer2D() {
+Renderer2D::Renderer2D(unsigned int maxSprites /* = 16384 */)
+	: m_maxSprites(std::max(maxSprites, (unsigned int)MIN_SPRITES)),
+	m_vertices(m_maxSprites * 4),
+	m_indices(m_maxSprites * 6),
+	m_drawCalls(0),
+	m_textureSwitches(0),
+	m_uploadedSize(0),
+	m_sortingEnabled(true),
+	m_textureSortingEnabled(false),
+	m_cullingEnabled(true),
+	m_culledCount(0),
+	m_visitedCount(0),
+	m_viewLeft(0), m_viewRight(0), m_viewBottom(0), m_viewTop(0),
+	m_instances(m_maxSprites),
+	m_currentInstance(0),
+	m_instanceVao(0),
+	m_instancingEnabled(true) {
 
 	setRenderColour(1,1,1,1);
 	setUVRect(0.0f, 0.0f, 1.0f, 1.0f);
@@ -25,13 +47,12 @@ Renderer2D::Renderer2D() {
 	m_renderBegun = false;
 
 	m_vao = -1;
-	m_vbo = -1;
-	m_ibo = -1;
+	m_streamBuffer = nullptr;
 
 	m_currentTexture = 0;
 
 	for (int i = 0; i < TEXTURE_STACK_SIZE; i++) {
-		m_textureStack[i] = nullptr;
+		m_textureStack[i] = 0;
 		m_fontTexture[i] = 0;
 	}
 
@@ -43,8 +64,9 @@ Renderer2D::Renderer2D() {
 						out vec2 vTexCoord; \
 						out float vTextureID; \
 						uniform mat4 projectionMatrix; \
+						uniform vec3 layerOffset; \
 						void main() { vColour = colour; vTexCoord = texcoord; vTextureID = position.w; \
-						gl_Position = projectionMatrix * vec4(position.x, position.y, position.z, 1.0f); }";
+						gl_Position = projectionMatrix * vec4(position.xyz + layerOffset, 1.0f); }";
 
 	char* fragmentShader = "#version 150\n \
 						in vec4 vColour; \
@@ -58,58 +80,65 @@ Renderer2D::Renderer2D() {
 							int id = int(vTextureID); \
 							if (id < TEXTURE_STACK_SIZE) { \
 								vec4 rgba = texture2D(textureStack[id], vTexCoord); \
-								if (isFontTexture[id] == 1) \
-									rgba = rgba.rrrr; \
+								if (isFontTexture[id] == 1) { \
+									float edge = max(fwidth(rgba.r), 0.0001) * 0.7; \
+									rgba = vec4(smoothstep(0.5 - edge, 0.5 + edge, rgba.r)); \
+								} \
 								fragColour = rgba * vColour; \
 							} else fragColour = vColour; \
 						if (fragColour.a < 0.001f) discard; }";
 	
-	unsigned int vs = glCreateShader(GL_VERTEX_SHADER);
-	unsigned int fs = glCreateShader(GL_FRAGMENT_SHADER);
-
-	glShaderSource(vs, 1, (const char**)&vertexShader, 0);
-	glCompileShader(vs);
-
-	glShaderSource(fs, 1, (const char**)&fragmentShader, 0);
-	glCompileShader(fs);
-
-	m_shader = glCreateProgram();
-	glAttachShader(m_shader, vs);
-	glAttachShader(m_shader, fs);
-	glBindAttribLocation(m_shader, 0, "position");
-	glBindAttribLocation(m_shader, 1, "colour");
-	glBindAttribLocation(m_shader, 2, "texcoord");
-	glLinkProgram(m_shader);
-
-	int success = GL_FALSE;
-	glGetProgramiv(m_shader, GL_LINK_STATUS, &success);
-	if (success == GL_FALSE) {
-		int infoLogLength = 0;
-		glGetProgramiv(m_shader, GL_INFO_LOG_LENGTH, &infoLogLength);
-		char* infoLog = new char[infoLogLength];
-
-		glGetProgramInfoLog(m_shader, infoLogLength, 0, infoLog);
-		printf("Error: Failed to link SpriteBatch shader program!\n%s\n", infoLog);
-		delete[] infoLog;
-	}
+	// sprites drawn instanced expand their quad from one record, corners being picked by the vertex id
+	char* instanceShader = "#version 150\n \
+						in vec4 position; \
+						in vec2 rotation; \
+						in vec4 texcoords; \
+						in vec2 origin; \
+						in vec4 colour; \
+						in float textureID; \
+						out vec4 vColour; \
+						out vec2 vTexCoord; \
+						out float vTextureID; \
+						uniform mat4 projectionMatrix; \
+						void main() { \
+							vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1); \
+							vec2 local = (corner - origin) * position.zw; \
+							float s = sin(rotation.x); float c = cos(rotation.x); \
+							local = vec2(local.x * c - local.y * s, local.x * s + local.y * c); \
+							vColour = colour; \
+							vTexCoord = vec2(mix(texcoords.x, texcoords.z, corner.x), mix(texcoords.w, texcoords.y, corner.y)); \
+							vTextureID = textureID; \
+							gl_Position = projectionMatrix * vec4(position.xy + local, rotation.y, 1.0f); }";
+	
+	const char* attributes[] = { "position", "colour", "texcoord" };
+	m_shader = ProgramCache::createProgram("SpriteBatch", vertexShader, fragmentShader, attributes, 3);
 
-	glUseProgram(m_shader);
+	const char* instanceAttributes[] = { "position", "rotation", "texcoords", "origin", "colour", "textureID" };
+	m_instanceShader = ProgramCache::createProgram("SpriteInstances", instanceShader, fragmentShader, instanceAttributes, 6);
 
 	// set texture locations
 	char buf[32];
-	for (int i = 0; i < TEXTURE_STACK_SIZE; ++i) {
-		sprintf_s(buf, "textureStack[%i]", i);
-		glUniform1i(glGetUniformLocation(m_shader, buf), i);
+	unsigned int programs[] = { m_shader, m_instanceShader };
+	for (unsigned int program : programs) {
+		GLState::useProgram(program);
+		for (int i = 0; i < TEXTURE_STACK_SIZE; ++i) {
+			sprintf_s(buf, "textureStack[%i]", i);
+			glUniform1i(glGetUniformLocation(program, buf), i);
+		}
 	}
 
-	glUseProgram(0);
+	// looked up once rather than every flush and frame
+	m_isFontTextureLocation = glGetUniformLocation(m_shader, "isFontTexture");
+	m_projectionMatrixLocation = glGetUniformLocation(m_shader, "projectionMatrix");
+	m_layerOffsetLocation = glGetUniformLocation(m_shader, "layerOffset");
+	m_instanceIsFontTextureLocation = glGetUniformLocation(m_instanceShader, "isFontTexture");
+	m_instanceProjectionMatrixLocation = glGetUniformLocation(m_instanceShader, "projectionMatrix");
 
-	glDeleteShader(vs);
-	glDeleteShader(fs);
+	GLState::useProgram(0);
 	
 	// pre calculate the indices... they will always be the same
 	int index = 0;
-	for (int i = 0; i<(MAX_SPRITES*6);) {
+	for (unsigned int i = 0; i < m_maxSprites * 6;) {
 		m_indices[i++] = (index + 0);
 		m_indices[i++] = (index + 1);
 		m_indices[i++] = (index + 2);
@@ -120,29 +149,49 @@ Renderer2D::Renderer2D() {
 		index += 4;
 	}
 	
-	// create the vao, vio and vbo
+	// vertices and indices are both streamed through the ring, each flush
+	// selecting its part with a base vertex and index offset
+	m_streamBuffer = new RingBuffer(m_maxSprites * (4 * sizeof(SBVertex) + 6 * sizeof(unsigned int)) * 3);
+
+	// create the vao
 	glGenVertexArrays(1, &m_vao);
-	glBindVertexArray(m_vao);
-	glGenBuffers(1, &m_vbo);
-	glGenBuffers(1, &m_ibo);
-	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, (MAX_SPRITES * 6) * sizeof(unsigned short), (void *)(&m_indices[0]), GL_STATIC_DRAW);
-	glBufferData(GL_ARRAY_BUFFER, (MAX_SPRITES * 4) * sizeof(SBVertex), m_vertices, GL_STATIC_DRAW);
+	GLState::bindVertexArray(m_vao);
+	glBindBuffer(GL_ARRAY_BUFFER, m_streamBuffer->getHandle());
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_streamBuffer->getHandle());
 	glEnableVertexAttribArray(0);
 	glEnableVertexAttribArray(1);
 	glEnableVertexAttribArray(2);
 	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(SBVertex), (char *)0);
 	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(SBVertex), (char *)16);
 	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(SBVertex), (char *)32);
-	glBindVertexArray(0);
+
+	// instances come from the same ring, each flush selecting its part with a base instance
+	glGenVertexArrays(1, &m_instanceVao);
+	GLState::bindVertexArray(m_instanceVao);
+	glBindBuffer(GL_ARRAY_BUFFER, m_streamBuffer->getHandle());
+	for (unsigned int i = 0; i < 6; ++i) {
+		glEnableVertexAttribArray(i);
+		glVertexAttribDivisor(i, 1);
+	}
+	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(SBInstance), (char *)0);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(SBInstance), (char *)16);
+	glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(SBInstance), (char *)24);
+	glVertexAttribPointer(3, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(SBInstance), (char *)40);
+	glVertexAttribPointer(4, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(SBInstance), (char *)44);
+	glVertexAttribPointer(5, 1, GL_FLOAT, GL_FALSE, sizeof(SBInstance), (char *)48);
+
+	GLState::bindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 Renderer2D::~Renderer2D() {
-	glDeleteBuffers(1, &m_vbo);
-	glDeleteBuffers(1, &m_ibo);
-	glDeleteBuffers(1, &m_vao);
+	delete m_streamBuffer;
+	GLState::forgetVertexArray(m_vao);
+	GLState::forgetVertexArray(m_instanceVao);
+	glDeleteVertexArrays(1, &m_vao);
+	glDeleteVertexArrays(1, &m_instanceVao);
 	glDeleteProgram(m_shader);
+	glDeleteProgram(m_instanceShader);
 	delete m_nullTexture;
 }
 
@@ -151,12 +200,21 @@ void Renderer2D::begin() {
 	m_currentIndex = 0;
 	m_currentVertex = 0;
 	m_currentTexture = 0;
+	m_drawCalls = 0;
+	m_textureSwitches = 0;
+	m_uploadedSize = 0;
+	m_currentInstance = 0;
+	m_commands.clear();
+	m_recorders.clear();
+	m_layers.clear();
+	m_culledCount = 0;
+	m_visitedCount = 0;
 
 	int width = 0, height = 0;
 	auto window = glfwGetCurrentContext();
 	glfwGetWindowSize(window, &width, &height);
 	
-	glUseProgram(m_shader);
+	GLState::useProgram(m_shader);
 
 	// scale the width/height based on cameraScale
 	float scaledWidth = (float)width * m_cameraScale;
@@ -172,8 +230,15 @@ void Renderer2D::begin() {
 	float bottom = midY - (scaledHeight * 0.5f);
 	float left = midX - (scaledWidth * 0.5f);
 
+	// kept for culling, as the camera can move before end()
+	m_viewLeft = left;
+	m_viewRight = right;
+	m_viewBottom = bottom;
+	m_viewTop = top;
+
 	auto projection = glm::ortho(left, right, bottom, top, 1.0f, -101.0f);
-	glUniformMatrix4fv(glGetUniformLocation(m_shader, "projectionMatrix"), 1, false, &projection[0][0]);
+	glUniformMatrix4fv(m_projectionMatrixLocation, 1, false, &projection[0][0]);
+	glProgramUniformMatrix4fv(m_instanceShader, m_instanceProjectionMatrixLocation, 1, false, &projection[0][0]);
 
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
@@ -185,348 +250,314 @@ void Renderer2D::end() {
 	if (m_renderBegun == false)
 		return;
 
-	flushBatch();
+	// the recorders' commands go after the renderer's own, in the order they were submitted. they are
+	// only merged here so that a flush part way through the frame can't draw them early
+	for (const SpriteRecorder* recorder : m_recorders)
+		m_commands.insert(m_commands.end(), recorder->m_commands.begin(), recorder->m_commands.end());
+	m_recorders.clear();
+
+	submitCommands();
 
-	glUseProgram(0);
+	GLState::useProgram(0);
 
 	m_renderBegun = false;
 }
 
-void Renderer2D::drawBox(float xPos, float yPos, float width, float height, float rotation, float depth) {
-	drawSprite(nullptr, xPos, yPos, width, height, rotation, depth);
+void Renderer2D::drawText(Font * font, const char* text, float xPos, float yPos, float depth) {
+
+	if (font == nullptr ||
+		font->getTextureHandle() == 0)
+		return;
+
+	// the string is laid out once and cached by the font, so static text only has its quads copied
+	bool moved = false;
+	const Font::Run& run = font->getRun(text, true, moved);
+
+	// glyphs moved to make room in the font's texture would leave quads already
+	// recorded pointing at the wrong ones, so those are drawn before the texture changes.
+	// submitted recorders hold no text, so they are left to be merged in end()
+	if (moved)
+		submitCommands();
+
+	font->updateTexture();
+
+	// font renders top to bottom, so we need to invert it
+	int w = 0, h = 0;
+	glfwGetWindowSize(glfwGetCurrentContext(), &w, &h);
+
+	// start on a whole pixel so that text drawn at the same position doesn't shimmer as it moves
+	float originX = floorf(xPos + 0.5f);
+	float originY = h - floorf(h - yPos + 0.5f);
+
+	bool complete = run.generation != 0;
+
+	for (size_t i = 0; i < run.quads.size(); ++i) {
+
+		// glyphs that didn't fit in the texture are left out
+		if (complete == false &&
+			run.glyphs[i]->resident == false)
+			continue;
+
+		const Font::Quad& Q = run.quads[i];
+		float x0 = originX + Q.x0, x1 = originX + Q.x1;
+		float y0 = originY - Q.y1, y1 = originY - Q.y0;
+
+		SpriteCommand& command = addCommand(SpriteCommand::SPRITE, font->getTextureHandle(), true, depth);
+		setSprite(command, x0, y0, x1 - x0, y1 - y0, 0.0f, 0.0f, 0.0f);
+		setTexCoords(command, Q.s0, Q.t0, Q.s1, Q.t1);
+	}
 }
 
-void Renderer2D::drawCircle(float xPos, float yPos, float radius, float depth) {
+void Renderer2D::submit(const SpriteRecorder& recorder) {
+	if (m_renderBegun)
+		m_recorders.push_back(&recorder);
+}
 
-	if (shouldFlush(33,96))
-		flushBatch();
-	unsigned int textureID = pushTexture(m_nullTexture);
+void Renderer2D::drawGrid(SpriteGrid& grid) {
+	if (m_renderBegun == false)
+		return;
 
-	int startIndex = m_currentVertex;
+	grid.visit(m_viewLeft, m_viewBottom, m_viewRight, m_viewTop, [this, &grid](unsigned int index) {
+		const SpriteCommand& command = grid.m_commands[index];
+		m_visitedCount++;
 
-	// centre vertex
-	m_vertices[m_currentVertex].pos[0] = xPos;
-	m_vertices[m_currentVertex].pos[1] = yPos;
-	m_vertices[m_currentVertex].pos[2] = depth;
-	m_vertices[m_currentVertex].pos[3] = (float)textureID;
-	m_vertices[m_currentVertex].color[0] = m_r;
-	m_vertices[m_currentVertex].color[1] = m_g;
-	m_vertices[m_currentVertex].color[2] = m_b;
-	m_vertices[m_currentVertex].color[3] = m_a;
-	m_vertices[m_currentVertex].texcoord[0] = 0;
-	m_vertices[m_currentVertex].texcoord[1] = 0;
-	m_currentVertex++;
+		if (m_cullingEnabled == false ||
+			isVisible(command))
+			m_commands.push_back(command);
+		else
+			m_culledCount++;
+	});
+}
 
-	float rotDelta = glm::pi<float>() * 2 / 32;
+void Renderer2D::drawTileLayer(TileLayer& layer) {
+	if (m_renderBegun == false ||
+		layer.m_tileset == nullptr ||
+		layer.m_chunks.empty())
+		return;
 
-	// 32 segment sphere
-	for (int i = 0; i < 32; ++i) {
+	// only the chunks the view overlaps are recorded, so a large layer costs no more than the screen it fills
+	float chunkWorldSize = layer.m_chunkSize * layer.m_tileWorldSize;
+	float chunkX0 = floorf((m_viewLeft - layer.m_x) / chunkWorldSize);
+	float chunkX1 = floorf((m_viewRight - layer.m_x) / chunkWorldSize);
+	float chunkY0 = floorf((m_viewBottom - layer.m_y) / chunkWorldSize);
+	float chunkY1 = floorf((m_viewTop - layer.m_y) / chunkWorldSize);
 
-		if (shouldFlush())
-			flushBatch();
+	if (chunkX1 < 0 || chunkX0 >= (float)layer.m_chunksX ||
+		chunkY1 < 0 || chunkY0 >= (float)layer.m_chunksY)
+		return;
 
-		m_vertices[m_currentVertex].pos[0] = glm::sin(rotDelta * i) * radius + xPos;
-		m_vertices[m_currentVertex].pos[1] = glm::cos(rotDelta * i) * radius + yPos;
-		m_vertices[m_currentVertex].pos[2] = depth;
-		m_vertices[m_currentVertex].pos[3] = (float)textureID;
-		m_vertices[m_currentVertex].color[0] = m_r;
-		m_vertices[m_currentVertex].color[1] = m_g;
-		m_vertices[m_currentVertex].color[2] = m_b;
-		m_vertices[m_currentVertex].color[3] = m_a;
-		m_vertices[m_currentVertex].texcoord[0] = 0.5f;
-		m_vertices[m_currentVertex].texcoord[1] = 0.5f;
-		m_currentVertex++;
-
-		if (i == (32-1)) {
-			m_indices[m_currentIndex++] = startIndex;
-			m_indices[m_currentIndex++] = startIndex + 1;
-			m_indices[m_currentIndex++] = m_currentVertex - 1;
-		}
-		else {
-			m_indices[m_currentIndex++] = startIndex;
-			m_indices[m_currentIndex++] = m_currentVertex;
-			m_indices[m_currentIndex++] = m_currentVertex - 1;
+	unsigned int x0 = (unsigned int)std::max(chunkX0, 0.0f), x1 = (unsigned int)std::min(chunkX1, (float)(layer.m_chunksX - 1));
+	unsigned int y0 = (unsigned int)std::max(chunkY0, 0.0f), y1 = (unsigned int)std::min(chunkY1, (float)(layer.m_chunksY - 1));
+
+	unsigned int layerIndex = (unsigned int)m_layers.size();
+	m_layers.push_back(&layer);
+
+	for (unsigned int y = y0; y <= y1; ++y) {
+		for (unsigned int x = x0; x <= x1; ++x) {
+			unsigned int chunkIndex = y * layer.m_chunksX + x;
+			const TileLayer::Chunk& chunk = layer.m_chunks[chunkIndex];
+
+			// chunks already built without any tiles have nothing to draw
+			if (chunk.dirty == false &&
+				chunk.indexCount == 0)
+				continue;
+
+			SpriteCommand& command = addCommand(SpriteCommand::CHUNK, layer.m_tileset->getHandle(), false, layer.m_depth);
+			command.corners[0] = (float)layerIndex;
+			command.corners[1] = (float)chunkIndex;
+			command.corners[2] = layer.m_x + x * chunkWorldSize;
+			command.corners[3] = layer.m_y + y * chunkWorldSize;
+			command.corners[4] = command.corners[2] + chunkWorldSize;
+			command.corners[5] = command.corners[3] + chunkWorldSize;
 		}
 	}
 }
 
-void Renderer2D::drawSprite(Texture * texture,
-							 float xPos, float yPos, 
-							 float width, float height, 
-							 float rotation, float depth, float xOrigin, float yOrigin) {
-	if (texture == nullptr)
-		texture = m_nullTexture;
+bool Renderer2D::isVisible(const SpriteCommand& command) const {
+	float x0, y0, x1, y1;
+	command.getBounds(x0, y0, x1, y1);
+	return x1 >= m_viewLeft && x0 <= m_viewRight &&
+		y1 >= m_viewBottom && y0 <= m_viewTop;
+}
 
-	if (shouldFlush())
-		flushBatch();
-	unsigned int textureID = pushTexture(texture);
-
-	if (width == 0.0f)
-		width = (float)texture->getWidth();
-	if (height == 0.0f)
-		height = (float)texture->getHeight();
-
-	float tlX = (0.0f - xOrigin) * width;		float tlY = (0.0f - yOrigin) * height;
-	float trX = (1.0f - xOrigin) * width;		float trY = (0.0f - yOrigin) * height;
-	float brX = (1.0f - xOrigin) * width;		float brY = (1.0f - yOrigin) * height;
-	float blX = (0.0f - xOrigin) * width;		float blY = (1.0f - yOrigin) * height;
-
-	if (rotation != 0.0f) {
-		float si = glm::sin(rotation); float co = glm::cos(rotation);
-		rotateAround(tlX, tlY, tlX, tlY, si, co);
-		rotateAround(trX, trY, trX, trY, si, co);
-		rotateAround(brX, brY, brX, brY, si, co);
-		rotateAround(blX, blY, blX, blY, si, co);
-	}
+// which batch a command is built in to, chunks being drawn from their own buffers
+static int getBatchPath(const SpriteCommand& command, bool instancing) {
+	if (command.type == SpriteCommand::CHUNK)
+		return 2;
+	return instancing && command.type == SpriteCommand::SPRITE ? 1 : 0;
+}
 
-	int index = m_currentVertex;
+void Renderer2D::submitCommands() {
 
-	m_vertices[m_currentVertex].pos[0] = xPos + tlX;
-	m_vertices[m_currentVertex].pos[1] = yPos + tlY;
-	m_vertices[m_currentVertex].pos[2] = depth;
-	m_vertices[m_currentVertex].pos[3] = (float)textureID;
-	m_vertices[m_currentVertex].color[0] = m_r;
-	m_vertices[m_currentVertex].color[1] = m_g;
-	m_vertices[m_currentVertex].color[2] = m_b;
-	m_vertices[m_currentVertex].color[3] = m_a;
-	m_vertices[m_currentVertex].texcoord[0] = m_uvX;
-	m_vertices[m_currentVertex].texcoord[1] = m_uvY + m_uvH;
-	m_currentVertex++;
-
-	m_vertices[m_currentVertex].pos[0] = xPos + trX;
-	m_vertices[m_currentVertex].pos[1] = yPos + trY;
-	m_vertices[m_currentVertex].pos[2] = depth;
-	m_vertices[m_currentVertex].pos[3] = (float)textureID;
-	m_vertices[m_currentVertex].color[0] = m_r;
-	m_vertices[m_currentVertex].color[1] = m_g;
-	m_vertices[m_currentVertex].color[2] = m_b;
-	m_vertices[m_currentVertex].color[3] = m_a;
-	m_vertices[m_currentVertex].texcoord[0] = m_uvX + m_uvW;
-	m_vertices[m_currentVertex].texcoord[1] = m_uvY + m_uvH;
-	m_currentVertex++;
-
-	m_vertices[m_currentVertex].pos[0] = xPos + brX;
-	m_vertices[m_currentVertex].pos[1] = yPos + brY;
-	m_vertices[m_currentVertex].pos[2] = depth;
-	m_vertices[m_currentVertex].pos[3] = (float)textureID;
-	m_vertices[m_currentVertex].color[0] = m_r;
-	m_vertices[m_currentVertex].color[1] = m_g;
-	m_vertices[m_currentVertex].color[2] = m_b;
-	m_vertices[m_currentVertex].color[3] = m_a;
-	m_vertices[m_currentVertex].texcoord[0] = m_uvX + m_uvW;
-	m_vertices[m_currentVertex].texcoord[1] = m_uvY;
-	m_currentVertex++;
-
-	m_vertices[m_currentVertex].pos[0] = xPos + blX;
-	m_vertices[m_currentVertex].pos[1] = yPos + blY;
-	m_vertices[m_currentVertex].pos[2] = depth;
-	m_vertices[m_currentVertex].pos[3] = (float)textureID;
-	m_vertices[m_currentVertex].color[0] = m_r;
-	m_vertices[m_currentVertex].color[1] = m_g;
-	m_vertices[m_currentVertex].color[2] = m_b;
-	m_vertices[m_currentVertex].color[3] = m_a;
-	m_vertices[m_currentVertex].texcoord[0] = m_uvX;
-	m_vertices[m_currentVertex].texcoord[1] = m_uvY;
-	m_currentVertex++;
+	if (m_commands.empty())
+		return;
 
-	m_indices[m_currentIndex++] = (index + 0);
-	m_indices[m_currentIndex++] = (index + 2);
-	m_indices[m_currentIndex++] = (index + 3);
+	// anything entirely outside the view is dropped before it is sorted or built
+	m_order.clear();
+	m_order.reserve(m_commands.size());
+	for (unsigned int i = 0; i < m_commands.size(); ++i) {
+		if (m_cullingEnabled == false ||
+			isVisible(m_commands[i]))
+			m_order.push_back(i);
+	}
+	m_culledCount += (unsigned int)(m_commands.size() - m_order.size());
+
+	// furthest first so that blending layers correctly. if asked, each depth is then grouped by how it
+	// is built, as the instanced and vertex batches share the texture stack and switching between them
+	// flushes, then by texture so each one is only bound once. equal keys keep the order they were drawn in
+	if (m_sortingEnabled) {
+		const std::vector<SpriteCommand>& commands = m_commands;
+		bool byTexture = m_textureSortingEnabled;
+		bool instancing = m_instancingEnabled;
+		std::stable_sort(m_order.begin(), m_order.end(), [&commands, byTexture, instancing](unsigned int a, unsigned int b) {
+			const SpriteCommand& A = commands[a];
+			const SpriteCommand& B = commands[b];
+			if (A.depth != B.depth || byTexture == false)
+				return A.depth > B.depth;
+			int pathA = getBatchPath(A, instancing), pathB = getBatchPath(B, instancing);
+			if (pathA != pathB)
+				return pathA < pathB;
+			return A.texture < B.texture;
+		});
+	}
 
-	m_indices[m_currentIndex++] = (index + 0);
-	m_indices[m_currentIndex++] = (index + 1);
-	m_indices[m_currentIndex++] = (index + 2);
+	for (unsigned int index : m_order)
+		buildCommand(m_commands[index]);
+
+	m_commands.clear();
+
+	flushBatch();
 }
 
-void Renderer2D::drawSpriteTransformed3x3(Texture * texture,
-										   float * transformMat3x3, 
-										   float width, float height, float depth,
-										   float xOrigin, float yOrigin) {
-	if (texture == nullptr)
-		texture = m_nullTexture;
+void Renderer2D::buildCommand(const SpriteCommand& command) {
 
-	if (shouldFlush())
+	if (command.type == SpriteCommand::CHUNK) {
+		drawChunk(command);
+		return;
+	}
+
+	// the instanced and vertex batches share the texture stack, so only one is built at a time
+	bool instanced = m_instancingEnabled && command.type == SpriteCommand::SPRITE;
+	if (instanced ? m_currentVertex > 0 : m_currentInstance > 0)
 		flushBatch();
 
-	unsigned int textureID = pushTexture(texture);
-
-	if (width == 0.0f)
-		width = (float)texture->getWidth();
-	if (height == 0.0f)
-		height = (float)texture->getHeight();
-
-	float tlX = (0.0f - xOrigin) * width;		float tlY = (0.0f - yOrigin) * height;
-	float trX = (1.0f - xOrigin) * width;		float trY = (0.0f - yOrigin) * height;
-	float brX = (1.0f - xOrigin) * width;		float brY = (1.0f - yOrigin) * height;
-	float blX = (0.0f - xOrigin) * width;		float blY = (1.0f - yOrigin) * height;
-
-	// transform the points by the matrix
-	// 0 3 6
-	// 1 4 7
-	// 2 5 8
-	float x, y;
-	x = tlX; y = tlY;
-	tlX = x * transformMat3x3[0] + y * transformMat3x3[3] + transformMat3x3[6];
-	tlY = x * transformMat3x3[1] + y * transformMat3x3[4] + transformMat3x3[7];
-	x = trX; y = trY;
-	trX = x * transformMat3x3[0] + y * transformMat3x3[3] + transformMat3x3[6];
-	trY = x * transformMat3x3[1] + y * transformMat3x3[4] + transformMat3x3[7];
-	x = brX; y = brY;
-	brX = x * transformMat3x3[0] + y * transformMat3x3[3] + transformMat3x3[6];
-	brY = x * transformMat3x3[1] + y * transformMat3x3[4] + transformMat3x3[7];
-	x = blX; y = blY;
-	blX = x * transformMat3x3[0] + y * transformMat3x3[3] + transformMat3x3[6];
-	blY = x * transformMat3x3[1] + y * transformMat3x3[4] + transformMat3x3[7];	
+	if (instanced) {
+		if (m_currentInstance >= (int)m_maxSprites)
+			flushBatch();
+	}
+	else if (command.type == SpriteCommand::CIRCLE) {
+		if (shouldFlush(33, 96))
+			flushBatch();
+	}
+	else if (shouldFlush(4, 6)) {
+		flushBatch();
+	}
+
+	unsigned int textureID = pushTexture(command.texture != 0 ? command.texture : m_nullTexture->getHandle(), command.isFont != 0);
+
+	if (instanced) {
+		SBInstance& instance = m_instances[m_currentInstance++];
+		instance.position[0] = command.corners[0];
+		instance.position[1] = command.corners[1];
+		instance.size[0] = command.corners[2];
+		instance.size[1] = command.corners[3];
+		instance.rotation = command.corners[4];
+		instance.depth = command.depth;
+		memcpy(instance.texcoords, command.texcoords, sizeof(instance.texcoords));
+		instance.origin[0] = (unsigned short)(glm::clamp(command.corners[5], 0.0f, 1.0f) * 65535.0f + 0.5f);
+		instance.origin[1] = (unsigned short)(glm::clamp(command.corners[6], 0.0f, 1.0f) * 65535.0f + 0.5f);
+		instance.colour[0] = (unsigned char)(command.colour >> 24);
+		instance.colour[1] = (unsigned char)(command.colour >> 16);
+		instance.colour[2] = (unsigned char)(command.colour >> 8);
+		instance.colour[3] = (unsigned char)command.colour;
+		instance.textureID = (float)textureID;
+		return;
+	}
+
+	// everything but the position and texture coords is the same for every vertex
+	SBVertex vertex = {};
+	vertex.pos[2] = command.depth;
+	vertex.pos[3] = (float)textureID;
+	vertex.color[0] = ((command.colour >> 24) & 0xff) / 255.0f;
+	vertex.color[1] = ((command.colour >> 16) & 0xff) / 255.0f;
+	vertex.color[2] = ((command.colour >> 8) & 0xff) / 255.0f;
+	vertex.color[3] = (command.colour & 0xff) / 255.0f;
 
 	int index = m_currentVertex;
-	
-	m_vertices[m_currentVertex].pos[0] = tlX;
-	m_vertices[m_currentVertex].pos[1] = tlY;
-	m_vertices[m_currentVertex].pos[2] = depth;
-	m_vertices[m_currentVertex].pos[3] = (float)textureID;
-	m_vertices[m_currentVertex].color[0] = m_r;
-	m_vertices[m_currentVertex].color[1] = m_g;
-	m_vertices[m_currentVertex].color[2] = m_b;
-	m_vertices[m_currentVertex].color[3] = m_a;
-	m_vertices[m_currentVertex].texcoord[0] = m_uvX;
-	m_vertices[m_currentVertex].texcoord[1] = m_uvY + m_uvH;
-	m_currentVertex++;
-
-	m_vertices[m_currentVertex].pos[0] = trX;
-	m_vertices[m_currentVertex].pos[1] = trY;
-	m_vertices[m_currentVertex].pos[2] = depth;
-	m_vertices[m_currentVertex].pos[3] = (float)textureID;
-	m_vertices[m_currentVertex].color[0] = m_r;
-	m_vertices[m_currentVertex].color[1] = m_g;
-	m_vertices[m_currentVertex].color[2] = m_b;
-	m_vertices[m_currentVertex].color[3] = m_a;
-	m_vertices[m_currentVertex].texcoord[0] = m_uvX + m_uvW;
-	m_vertices[m_currentVertex].texcoord[1] = m_uvY + m_uvH;
-	m_currentVertex++;
-
-	m_vertices[m_currentVertex].pos[0] = brX;
-	m_vertices[m_currentVertex].pos[1] = brY;
-	m_vertices[m_currentVertex].pos[2] = depth;
-	m_vertices[m_currentVertex].pos[3] = (float)textureID;
-	m_vertices[m_currentVertex].color[0] = m_r;
-	m_vertices[m_currentVertex].color[1] = m_g;
-	m_vertices[m_currentVertex].color[2] = m_b;
-	m_vertices[m_currentVertex].color[3] = m_a;
-	m_vertices[m_currentVertex].texcoord[0] = m_uvX + m_uvW;
-	m_vertices[m_currentVertex].texcoord[1] = m_uvY;
-	m_currentVertex++;
-
-	m_vertices[m_currentVertex].pos[0] = blX;
-	m_vertices[m_currentVertex].pos[1] = blY;
-	m_vertices[m_currentVertex].pos[2] = depth;
-	m_vertices[m_currentVertex].pos[3] = (float)textureID;
-	m_vertices[m_currentVertex].color[0] = m_r;
-	m_vertices[m_currentVertex].color[1] = m_g;
-	m_vertices[m_currentVertex].color[2] = m_b;
-	m_vertices[m_currentVertex].color[3] = m_a;
-	m_vertices[m_currentVertex].texcoord[0] = m_uvX;
-	m_vertices[m_currentVertex].texcoord[1] = m_uvY;
-	m_currentVertex++;
 
-	m_indices[m_currentIndex++] = (index + 0);
-	m_indices[m_currentIndex++] = (index + 2);
-	m_indices[m_currentIndex++] = (index + 3);
+	if (command.type == SpriteCommand::CIRCLE) {
+		float xPos = command.corners[0];
+		float yPos = command.corners[1];
+		float radius = command.corners[2];
+
+		// centre vertex
+		SBVertex* vertices = &m_vertices[m_currentVertex];
+		vertices[0] = vertex;
+		vertices[0].pos[0] = xPos;
+		vertices[0].pos[1] = yPos;
+
+		float rotDelta = glm::pi<float>() * 2 / 32;
+
+		// 32 segment sphere
+		for (int i = 0; i < 32; ++i) {
+			vertices[i + 1] = vertex;
+			vertices[i + 1].pos[0] = glm::sin(rotDelta * i) * radius + xPos;
+			vertices[i + 1].pos[1] = glm::cos(rotDelta * i) * radius + yPos;
+			vertices[i + 1].texcoord[0] = 0.5f;
+			vertices[i + 1].texcoord[1] = 0.5f;
+
+			m_indices[m_currentIndex++] = index;
+			m_indices[m_currentIndex++] = i == (32 - 1) ? index + 1 : index + i + 2;
+			m_indices[m_currentIndex++] = index + i + 1;
+		}
+		m_currentVertex += 33;
+		return;
+	}
 
-	m_indices[m_currentIndex++] = (index + 0);
-	m_indices[m_currentIndex++] = (index + 1);
-	m_indices[m_currentIndex++] = (index + 2);
-}
+	// corners go top left, top right, bottom right, bottom left, with v flipped
+	float points[8];
+	if (command.type == SpriteCommand::SPRITE) {
+		float xPos = command.corners[0], yPos = command.corners[1];
+		float width = command.corners[2], height = command.corners[3];
+		float rotation = command.corners[4];
+		float xOrigin = command.corners[5], yOrigin = command.corners[6];
+
+		float tlX = (0.0f - xOrigin) * width;		float tlY = (0.0f - yOrigin) * height;
+		float trX = (1.0f - xOrigin) * width;		float trY = (0.0f - yOrigin) * height;
+		float brX = (1.0f - xOrigin) * width;		float brY = (1.0f - yOrigin) * height;
+		float blX = (0.0f - xOrigin) * width;		float blY = (1.0f - yOrigin) * height;
+
+		if (rotation != 0.0f) {
+			float si = glm::sin(rotation); float co = glm::cos(rotation);
+			rotateAround(tlX, tlY, tlX, tlY, si, co);
+			rotateAround(trX, trY, trX, trY, si, co);
+			rotateAround(brX, brY, brX, brY, si, co);
+			rotateAround(blX, blY, blX, blY, si, co);
+		}
+
+		points[0] = xPos + tlX;	points[1] = yPos + tlY;
+		points[2] = xPos + trX;	points[3] = yPos + trY;
+		points[4] = xPos + brX;	points[5] = yPos + brY;
+		points[6] = xPos + blX;	points[7] = yPos + blY;
+	}
+	else {
+		memcpy(points, command.corners, sizeof(points));
+	}
 
-void Renderer2D::drawSpriteTransformed4x4(Texture * texture,
-										   float * transformMat4x4, 
-										   float width, float height, float depth,
-										   float xOrigin, float yOrigin) {
-	if (texture == nullptr)
-		texture = m_nullTexture;
+	SBVertex* corners = &m_vertices[m_currentVertex];
+	corners[0] = corners[1] = corners[2] = corners[3] = vertex;
 
-	if (shouldFlush())
-		flushBatch();
-	unsigned int textureID = pushTexture(texture);
-
-	if (width == 0.0f)
-		width = (float)texture->getWidth();
-	if (height == 0.0f)
-		height = (float)texture->getHeight();
-
-	float tlX = (0.0f - xOrigin) * width;		float tlY = (0.0f - yOrigin) * height;
-	float trX = (1.0f - xOrigin) * width;		float trY = (0.0f - yOrigin) * height;
-	float brX = (1.0f - xOrigin) * width;		float brY = (1.0f - yOrigin) * height;
-	float blX = (0.0f - xOrigin) * width;		float blY = (1.0f - yOrigin) * height;
-
-	// transform the points by the matrix
-	// 0 4 8  12
-	// 1 5 9  13
-	// 2 6 10 14
-	// 3 7 11 15
-	float x, y;
-	x = tlX; y = tlY;
-	tlX = x * transformMat4x4[0] + y * transformMat4x4[4] + transformMat4x4[12];
-	tlY = x * transformMat4x4[1] + y * transformMat4x4[5] + transformMat4x4[13];
-	x = trX; y = trY;
-	trX = x * transformMat4x4[0] + y * transformMat4x4[4] + transformMat4x4[12];
-	trY = x * transformMat4x4[1] + y * transformMat4x4[5] + transformMat4x4[13];
-	x = brX; y = brY;
-	brX = x * transformMat4x4[0] + y * transformMat4x4[4] + transformMat4x4[12];
-	brY = x * transformMat4x4[1] + y * transformMat4x4[5] + transformMat4x4[13];
-	x = blX; y = blY;
-	blX = x * transformMat4x4[0] + y * transformMat4x4[4] + transformMat4x4[12];
-	blY = x * transformMat4x4[1] + y * transformMat4x4[5] + transformMat4x4[13];
+	corners[0].pos[0] = points[0];	corners[0].pos[1] = points[1];
+	corners[1].pos[0] = points[2];	corners[1].pos[1] = points[3];
+	corners[2].pos[0] = points[4];	corners[2].pos[1] = points[5];
+	corners[3].pos[0] = points[6];	corners[3].pos[1] = points[7];
 
-	int index = m_currentVertex;
+	corners[0].texcoord[0] = command.texcoords[0];	corners[0].texcoord[1] = command.texcoords[3];
+	corners[1].texcoord[0] = command.texcoords[2];	corners[1].texcoord[1] = command.texcoords[3];
+	corners[2].texcoord[0] = command.texcoords[2];	corners[2].texcoord[1] = command.texcoords[1];
+	corners[3].texcoord[0] = command.texcoords[0];	corners[3].texcoord[1] = command.texcoords[1];
+	m_currentVertex += 4;
 
-	m_vertices[m_currentVertex].pos[0] = tlX;
-	m_vertices[m_currentVertex].pos[1] = tlY;
-	m_vertices[m_currentVertex].pos[2] = depth;
-	m_vertices[m_currentVertex].pos[3] = (float)textureID;
-	m_vertices[m_currentVertex].color[0] = m_r;
-	m_vertices[m_currentVertex].color[1] = m_g;
-	m_vertices[m_currentVertex].color[2] = m_b;
-	m_vertices[m_currentVertex].color[3] = m_a;
-	m_vertices[m_currentVertex].texcoord[0] = m_uvX;
-	m_vertices[m_currentVertex].texcoord[1] = m_uvY + m_uvH;
-	m_currentVertex++;
-
-	m_vertices[m_currentVertex].pos[0] = trX;
-	m_vertices[m_currentVertex].pos[1] = trY;
-	m_vertices[m_currentVertex].pos[2] = depth;
-	m_vertices[m_currentVertex].pos[3] = (float)textureID;
-	m_vertices[m_currentVertex].color[0] = m_r;
-	m_vertices[m_currentVertex].color[1] = m_g;
-	m_vertices[m_currentVertex].color[2] = m_b;
-	m_vertices[m_currentVertex].color[3] = m_a;
-	m_vertices[m_currentVertex].texcoord[0] = m_uvX + m_uvW;
-	m_vertices[m_currentVertex].texcoord[1] = m_uvY + m_uvH;
-	m_currentVertex++;
-
-	m_vertices[m_currentVertex].pos[0] = brX;
-	m_vertices[m_currentVertex].pos[1] = brY;
-	m_vertices[m_currentVertex].pos[2] = depth;
-	m_vertices[m_currentVertex].pos[3] = (float)textureID;
-	m_vertices[m_currentVertex].color[0] = m_r;
-	m_vertices[m_currentVertex].color[1] = m_g;
-	m_vertices[m_currentVertex].color[2] = m_b;
-	m_vertices[m_currentVertex].color[3] = m_a;
-	m_vertices[m_currentVertex].texcoord[0] = m_uvX + m_uvW;
-	m_vertices[m_currentVertex].texcoord[1] = m_uvY;
-	m_currentVertex++;
-
-	m_vertices[m_currentVertex].pos[0] = blX;
-	m_vertices[m_currentVertex].pos[1] = blY;
-	m_vertices[m_currentVertex].pos[2] = depth;
-	m_vertices[m_currentVertex].pos[3] = (float)textureID;
-	m_vertices[m_currentVertex].color[0] = m_r;
-	m_vertices[m_currentVertex].color[1] = m_g;
-	m_vertices[m_currentVertex].color[2] = m_b;
-	m_vertices[m_currentVertex].color[3] = m_a;
-	m_vertices[m_currentVertex].texcoord[0] = m_uvX;
-	m_vertices[m_currentVertex].texcoord[1] = m_uvY;
-	m_currentVertex++;
-	
 	m_indices[m_currentIndex++] = (index + 0);
 	m_indices[m_currentIndex++] = (index + 2);
 	m_indices[m_currentIndex++] = (index + 3);
@@ -536,172 +567,208 @@ void Renderer2D::drawSpriteTransformed4x4(Texture * texture,
 	m_indices[m_currentIndex++] = (index + 2);
 }
 
-void Renderer2D::drawLine(float x1, float y1, float x2, float y2, float thickness, float depth) {
+void Renderer2D::drawChunk(const SpriteCommand& command) {
+	TileLayer& layer = *m_layers[(unsigned int)command.corners[0]];
+	unsigned int chunkIndex = (unsigned int)command.corners[1];
 
-	float xDiff = x2 - x1;
-	float yDiff = y2 - y1;
-	float len = glm::sqrt(xDiff * xDiff + yDiff * yDiff);
-	float xDir = xDiff / len;
-	float yDir = yDiff / len;
+	if (layer.m_chunks[chunkIndex].dirty)
+		buildChunk(layer, chunkIndex);
 
-	float rot = glm::atan(yDir, xDir);
+	const TileLayer::Chunk& chunk = layer.m_chunks[chunkIndex];
+	if (chunk.indexCount == 0)
+		return;
 
-	float uvX = m_uvX;
-	float uvY = m_uvY;
-	float uvW = m_uvW;
-	float uvH = m_uvH;
+	// the chunk draws from its own buffers, so whatever was batched before it is drawn first
+	flushBatch();
 
-	setUVRect(0.0f, 0.0f, 1.0f, 1.0f);
+	int depthFunc = GL_LESS;
+	glGetIntegerv(GL_DEPTH_FUNC, &depthFunc);
+	glDepthFunc(GL_LEQUAL);
 
-	drawSprite(m_nullTexture, x1, y1, len, thickness, rot, depth, 0.0f, 0.5f);
+	// the flush left the texture stack empty, so the tileset takes the first unit
+	glUniform1iv(m_isFontTextureLocation, TEXTURE_STACK_SIZE, m_fontTexture);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, command.texture);
+	m_textureSwitches++;
 
-	setUVRect(uvX, uvY, uvW, uvH);
-}
+	// chunks are built relative to the layer, which is placed here so that moving it rebuilds nothing
+	glUniform3f(m_layerOffsetLocation, layer.m_x, layer.m_y, layer.m_depth);
 
-void Renderer2D::drawText(Font * font, const char* text, float xPos, float yPos, float depth) {
+	GLState::bindVertexArray(chunk.vao);
+	glDrawElements(GL_TRIANGLES, chunk.indexCount, GL_UNSIGNED_INT, 0);
+	GLState::bindVertexArray(0);
+	m_drawCalls++;
 
-	if (font == nullptr ||
-		font->m_glHandle == 0)
-		return;
+	glUniform3f(m_layerOffsetLocation, 0, 0, 0);
 
-	stbtt_aligned_quad Q = {};
+	glDepthFunc(depthFunc);
+}
 
-	if (shouldFlush() || m_currentTexture >= TEXTURE_STACK_SIZE - 1)
-		flushBatch();
+void Renderer2D::buildChunk(TileLayer& layer, unsigned int chunkIndex) {
+	TileLayer::Chunk& chunk = layer.m_chunks[chunkIndex];
 
-	glActiveTexture(GL_TEXTURE0 + m_currentTexture++);
-	glBindTexture(GL_TEXTURE_2D, font->getTextureHandle());
-	glActiveTexture(GL_TEXTURE0);
-	m_fontTexture[m_currentTexture - 1] = 1;
+	unsigned int startX = (chunkIndex % layer.m_chunksX) * layer.m_chunkSize;
+	unsigned int startY = (chunkIndex / layer.m_chunksX) * layer.m_chunkSize;
+	unsigned int endX = std::min(startX + layer.m_chunkSize, layer.m_columns);
+	unsigned int endY = std::min(startY + layer.m_chunkSize, layer.m_rows);
 
-	// font renders top to bottom, so we need to invert it
-	int w = 0, h = 0;
-	glfwGetWindowSize(glfwGetCurrentContext(), &w, &h);
+	// a tileset still loading has no size to cut tiles from yet, so the chunk waits for it
+	Texture* tileset = layer.m_tileset;
+	if (tileset->getWidth() == 0 ||
+		tileset->getHeight() == 0)
+		return;
 
-	yPos = h - yPos;
+	// tiles are numbered across the tileset's rows, from the top
+	unsigned int tilesPerRow = std::max(tileset->getWidth() / layer.m_tileSize, 1u);
+	float tileU = layer.m_tileSize / (float)tileset->getWidth();
+	float tileV = layer.m_tileSize / (float)tileset->getHeight();
+	float size = layer.m_tileWorldSize;
+
+	// untinted, from the first texture unit, and relative to the layer's position and depth
+	SBVertex vertex = {};
+	vertex.color[0] = vertex.color[1] = vertex.color[2] = vertex.color[3] = 1.0f;
+
+	m_chunkVertices.clear();
+	m_chunkIndices.clear();
+
+	for (unsigned int y = startY; y < endY; ++y) {
+		for (unsigned int x = startX; x < endX; ++x) {
+			int tile = layer.m_tiles[y * layer.m_columns + x];
+			if (tile < 0)
+				continue;
+
+			float u0 = (tile % tilesPerRow) * tileU, u1 = u0 + tileU;
+			float v0 = (tile / tilesPerRow) * tileV, v1 = v0 + tileV;
+			float x0 = x * size, x1 = x0 + size;
+			float y0 = y * size, y1 = y0 + size;
+
+			unsigned int index = (unsigned int)m_chunkVertices.size();
+			m_chunkVertices.resize(index + 4, vertex);
+
+			SBVertex* corners = &m_chunkVertices[index];
+			corners[0].pos[0] = x0;	corners[0].pos[1] = y0;	corners[0].texcoord[0] = u0;	corners[0].texcoord[1] = v1;
+			corners[1].pos[0] = x1;	corners[1].pos[1] = y0;	corners[1].texcoord[0] = u1;	corners[1].texcoord[1] = v1;
+			corners[2].pos[0] = x1;	corners[2].pos[1] = y1;	corners[2].texcoord[0] = u1;	corners[2].texcoord[1] = v0;
+			corners[3].pos[0] = x0;	corners[3].pos[1] = y1;	corners[3].texcoord[0] = u0;	corners[3].texcoord[1] = v0;
+
+			unsigned int indices[6] = { index + 0, index + 2, index + 3, index + 0, index + 1, index + 2 };
+			m_chunkIndices.insert(m_chunkIndices.end(), indices, indices + 6);
+		}
+	}
 
-	while (*text != 0) {
+	// buffers are made the first time a chunk is built, with the same layout as the batch
+	if (chunk.vao == 0) {
+		glGenVertexArrays(1, &chunk.vao);
+		glGenBuffers(1, &chunk.vbo);
+		glGenBuffers(1, &chunk.ibo);
+
+		GLState::bindVertexArray(chunk.vao);
+		glBindBuffer(GL_ARRAY_BUFFER, chunk.vbo);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, chunk.ibo);
+		glEnableVertexAttribArray(0);
+		glEnableVertexAttribArray(1);
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(SBVertex), (char *)0);
+		glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(SBVertex), (char *)16);
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(SBVertex), (char *)32);
+	}
+	else {
+		GLState::bindVertexArray(chunk.vao);
+		glBindBuffer(GL_ARRAY_BUFFER, chunk.vbo);
+	}
 
-		if (shouldFlush() || m_currentTexture >= TEXTURE_STACK_SIZE - 1) {
-				flushBatch();
+	// the data is respecified rather than updated, so a rebuild never waits on the gpu drawing the old one
+	glBufferData(GL_ARRAY_BUFFER, m_chunkVertices.size() * sizeof(SBVertex), m_chunkVertices.data(), GL_STATIC_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_chunkIndices.size() * sizeof(unsigned int), m_chunkIndices.data(), GL_STATIC_DRAW);
+	m_uploadedSize += (unsigned int)(m_chunkVertices.size() * sizeof(SBVertex) + m_chunkIndices.size() * sizeof(unsigned int));
 
-			glActiveTexture(GL_TEXTURE0 + m_currentTexture++);
-			glBindTexture(GL_TEXTURE_2D, font->getTextureHandle());
-			glActiveTexture(GL_TEXTURE0);
-			m_fontTexture[m_currentTexture - 1] = 1;
-		}
+	GLState::bindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-		stbtt_GetBakedQuad((stbtt_bakedchar*)font->m_glyphData, font->m_textureWidth, font->m_textureHeight, (unsigned char)*text, &xPos, &yPos, &Q, 1);
-
-		int index = m_currentVertex;
-
-		m_vertices[m_currentVertex].pos[0] = Q.x0;
-		m_vertices[m_currentVertex].pos[1] = h - Q.y1;
-		m_vertices[m_currentVertex].pos[2] = depth;
-		m_vertices[m_currentVertex].pos[3] = (float)m_currentTexture - 1;
-		m_vertices[m_currentVertex].color[0] = m_r;
-		m_vertices[m_currentVertex].color[1] = m_g;
-		m_vertices[m_currentVertex].color[2] = m_b;
-		m_vertices[m_currentVertex].color[3] = m_a;
-		m_vertices[m_currentVertex].texcoord[0] = Q.s0;
-		m_vertices[m_currentVertex].texcoord[1] = Q.t1;
-		m_currentVertex++;
-		m_vertices[m_currentVertex].pos[0] = Q.x1;
-		m_vertices[m_currentVertex].pos[1] = h - Q.y1;
-		m_vertices[m_currentVertex].pos[2] = depth;
-		m_vertices[m_currentVertex].pos[3] = (float)m_currentTexture - 1;
-		m_vertices[m_currentVertex].color[0] = m_r;
-		m_vertices[m_currentVertex].color[1] = m_g;
-		m_vertices[m_currentVertex].color[2] = m_b;
-		m_vertices[m_currentVertex].color[3] = m_a;
-		m_vertices[m_currentVertex].texcoord[0] = Q.s1;
-		m_vertices[m_currentVertex].texcoord[1] = Q.t1;
-		m_currentVertex++;
-		m_vertices[m_currentVertex].pos[0] = Q.x1;
-		m_vertices[m_currentVertex].pos[1] = h - Q.y0;
-		m_vertices[m_currentVertex].pos[2] = depth;
-		m_vertices[m_currentVertex].pos[3] = (float)m_currentTexture - 1;
-		m_vertices[m_currentVertex].color[0] = m_r;
-		m_vertices[m_currentVertex].color[1] = m_g;
-		m_vertices[m_currentVertex].color[2] = m_b;
-		m_vertices[m_currentVertex].color[3] = m_a;
-		m_vertices[m_currentVertex].texcoord[0] = Q.s1;
-		m_vertices[m_currentVertex].texcoord[1] = Q.t0;
-		m_currentVertex++;
-		m_vertices[m_currentVertex].pos[0] = Q.x0;
-		m_vertices[m_currentVertex].pos[1] = h - Q.y0;
-		m_vertices[m_currentVertex].pos[2] = depth;
-		m_vertices[m_currentVertex].pos[3] = (float)m_currentTexture - 1;
-		m_vertices[m_currentVertex].color[0] = m_r;
-		m_vertices[m_currentVertex].color[1] = m_g;
-		m_vertices[m_currentVertex].color[2] = m_b;
-		m_vertices[m_currentVertex].color[3] = m_a;
-		m_vertices[m_currentVertex].texcoord[0] = Q.s0;
-		m_vertices[m_currentVertex].texcoord[1] = Q.t0;
-		m_currentVertex++;
-		
-		m_indices[m_currentIndex++] = (index + 0);
-		m_indices[m_currentIndex++] = (index + 2);
-		m_indices[m_currentIndex++] = (index + 3);
-
-		m_indices[m_currentIndex++] = (index + 0);
-		m_indices[m_currentIndex++] = (index + 1);
-		m_indices[m_currentIndex++] = (index + 2);
-
-		text++;
-	}
+	chunk.indexCount = (unsigned int)m_chunkIndices.size();
+	chunk.dirty = false;
+	layer.m_rebuildCount++;
 }
 
 bool Renderer2D::shouldFlush(int additionalVertices, int additionalIndices) {
-	return (m_currentVertex + additionalVertices) >= (MAX_SPRITES * 4) || 
-		(m_currentIndex + additionalIndices) >= (MAX_SPRITES * 6);
+	return (m_currentVertex + additionalVertices) > (int)(m_maxSprites * 4) ||
+		(m_currentIndex + additionalIndices) > (int)(m_maxSprites * 6);
 }
 
 void Renderer2D::flushBatch() {
 
 	// dont render anything
-	if (m_currentVertex == 0 || m_currentIndex == 0 || m_renderBegun == false)
-		return; char buf[32];
-
-	for (int i = 0; i < TEXTURE_STACK_SIZE; ++i) {
-		sprintf_s(buf, "isFontTexture[%i]", i);
-		glUniform1i(glGetUniformLocation(m_shader, buf), m_fontTexture[i]);
-	}
+	if ((m_currentIndex == 0 && m_currentInstance == 0) || m_renderBegun == false)
+		return;
 
 	int depthFunc = GL_LESS;
 	glGetIntegerv(GL_DEPTH_FUNC, &depthFunc);
 	glDepthFunc(GL_LEQUAL);
 
-	glBindVertexArray(m_vao);
-	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
+	// write the batch straight in to the mapped ring, indices stay relative to the batch
+	if (m_currentIndex > 0) {
+		glUniform1iv(m_isFontTextureLocation, TEXTURE_STACK_SIZE, m_fontTexture);
+
+		unsigned int vertexOffset = 0, indexOffset = 0;
+		void* vertices = m_streamBuffer->allocate(m_currentVertex * sizeof(SBVertex), sizeof(SBVertex), vertexOffset);
+		memcpy(vertices, m_vertices.data(), m_currentVertex * sizeof(SBVertex));
+		void* indices = m_streamBuffer->allocate(m_currentIndex * sizeof(unsigned int), sizeof(unsigned int), indexOffset);
+		memcpy(indices, m_indices.data(), m_currentIndex * sizeof(unsigned int));
+		m_uploadedSize += m_currentVertex * sizeof(SBVertex) + m_currentIndex * sizeof(unsigned int);
 
-	glBufferSubData(GL_ARRAY_BUFFER, 0, m_currentVertex * sizeof(SBVertex), m_vertices);
-	glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, m_currentIndex * sizeof(unsigned short), m_indices);
+		GLState::bindVertexArray(m_vao);
 
-	glDrawElements(GL_TRIANGLES, m_currentIndex, GL_UNSIGNED_SHORT, 0);
+		glDrawElementsBaseVertex(GL_TRIANGLES, m_currentIndex, GL_UNSIGNED_INT, (void*)(size_t)indexOffset, vertexOffset / sizeof(SBVertex));
+		m_drawCalls++;
+	}
+
+	// a strip of four vertices per instance, the vertex shader placing each corner
+	if (m_currentInstance > 0) {
+		GLState::useProgram(m_instanceShader);
+		glUniform1iv(m_instanceIsFontTextureLocation, TEXTURE_STACK_SIZE, m_fontTexture);
+
+		unsigned int instanceOffset = 0;
+		void* instances = m_streamBuffer->allocate(m_currentInstance * sizeof(SBInstance), sizeof(SBInstance), instanceOffset);
+		memcpy(instances, m_instances.data(), m_currentInstance * sizeof(SBInstance));
+		m_uploadedSize += m_currentInstance * sizeof(SBInstance);
 
-	glBindVertexArray(0);
+		GLState::bindVertexArray(m_instanceVao);
+
+		glDrawArraysInstancedBaseInstance(GL_TRIANGLE_STRIP, 0, 4, m_currentInstance, instanceOffset / sizeof(SBInstance));
+		m_drawCalls++;
+
+		GLState::useProgram(m_shader);
+	}
+
+	GLState::bindVertexArray(0);
+
+	m_streamBuffer->fence();
 
 	glDepthFunc(depthFunc);
 
 	// clear the active textures
 	for (unsigned int i = 0; i < m_currentTexture; i++) {
-		m_textureStack[i] = nullptr;
+		m_textureStack[i] = 0;
 		m_fontTexture[i] = 0;
 	}
 
-	// reset vertex, index and texture count
+	// reset vertex, index, instance and texture count
 	m_currentIndex = 0;
 	m_currentVertex = 0;
+	m_currentInstance = 0;
 	m_currentTexture = 0;
 }
 
-unsigned int Renderer2D::pushTexture(Texture* texture) {
+unsigned int Renderer2D::pushTexture(unsigned int texture, bool isFont) {
+
+	// sprites from the same atlas page tend to follow each other, so try the last texture first
+	if (m_currentTexture > 0 &&
+		m_textureStack[m_currentTexture - 1] == texture)
+		return m_currentTexture - 1;
 
 	// check if the texture is already in use
 	// if so, return as we dont need to add it to our list of active txtures again
-	for (unsigned int i = 0; i <= m_currentTexture; i++) {
+	for (unsigned int i = 0; i < m_currentTexture; i++) {
 		if (m_textureStack[i] == texture)
 			return i;
 	}
@@ -712,39 +779,16 @@ unsigned int Renderer2D::pushTexture(Texture* texture) {
 
 	// add the texture to our active texture list
 	m_textureStack[m_currentTexture] = texture;
+	m_fontTexture[m_currentTexture] = isFont ? 1 : 0;
+	m_textureSwitches++;
 
 	glActiveTexture(GL_TEXTURE0 + m_currentTexture);
-	glBindTexture(GL_TEXTURE_2D, texture->getHandle());
+	glBindTexture(GL_TEXTURE_2D, texture);
 	glActiveTexture(GL_TEXTURE0);
 
 	// return what the current texture was and increment
 	return m_currentTexture++;
 }
 
-void Renderer2D::setRenderColour(float r, float g, float b, float a) {
-	m_r = r;
-	m_g = g;
-	m_b = b;
-	m_a = a;
-}
-
-void Renderer2D::setRenderColour(unsigned int colour) {
-	m_r = ((colour & 0xFF000000) >> 24) / 255.0f;
-	m_g = ((colour & 0x00FF0000) >> 16) / 255.0f;
-	m_b = ((colour & 0x0000FF00) >> 8) / 255.0f;
-	m_a = ((colour & 0x000000FF) >> 0) / 255.0f;
-}
-
-void Renderer2D::setUVRect(float uvX, float uvY, float uvW, float uvH) {
-	m_uvX = uvX;
-	m_uvY = uvY;
-	m_uvW = uvW;
-	m_uvH = uvH;
-}
-
-void Renderer2D::rotateAround(float inX, float inY, float& outX, float& outY, float sin, float cos) {
-	outX = inX * cos - inY * sin;
-	outY = inX * sin + inY * cos;
-}
 
 } // namespace aie
\ No newline at end of file
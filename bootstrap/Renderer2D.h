@@ -1,61 +1,110 @@
 #pragma once
 
+#include "SpriteRecorder.h"
+#include <vector>
+
 namespace aie {
 
 class Texture;
 class Font;
-
-// a class for rendering 2D sprites and font
-class Renderer2D {
+class RingBuffer;
+class SpriteGrid;
+class TileLayer;
+
+// a class for rendering 2D sprites and font. draws are recorded as commands and only
+// built in to vertices by end(), sorted by depth, and by texture within a depth if asked,
+// so that submission order needn't decide how often the batch is flushed. the drawing methods it shares with
+// SpriteRecorder only record, so other threads can record in to their own recorders
+class Renderer2D : public SpriteRecorder {
 public:
 
-	Renderer2D();
+	// a circle's 33 vertices and 96 indices take the room of 16 sprites, so smaller batches are raised to it
+	enum { MIN_SPRITES = 16 };
+
+	// sprites that fit in a batch before it has to be drawn, at least MIN_SPRITES. the stream ring
+	// holds three batches, so the gpu can still be drawing earlier ones while the next is written
+	Renderer2D(unsigned int maxSprites = 16384);
 	virtual ~Renderer2D();
 
 	// all draw calls must occur between a begin / end pair
 	virtual void begin();
 	virtual void end();
 
-	// simple shape rendering
-	virtual void drawBox(float xPos, float yPos, float width, float height, float rotation = 0.0f, float depth = 0.0f);
-	virtual void drawCircle(float xPos, float yPos, float radius, float depth = 0.0f);
-
-	// if texture is nullptr then it renders a coloured sprite
-	// depth is in the range [0,100] with lower being closer to the viewer
-	virtual void drawSprite(Texture* texture, float xPos, float yPos, float width = 0.0f, float height = 0.0f, float rotation = 0.0f, float depth = 0.0f, float xOrigin = 0.5f, float yOrigin = 0.5f);
-	virtual void drawSpriteTransformed3x3(Texture* texture, float* transformMat3x3, float width = 0.0f, float height = 0.0f, float depth = 0.0f, float xOrigin = 0.5f, float yOrigin = 0.5f);
-	virtual void drawSpriteTransformed4x4(Texture* texture, float* transformMat4x4, float width = 0.0f, float height = 0.0f, float depth = 0.0f, float xOrigin = 0.5f, float yOrigin = 0.5f);
-
-	// draws a simple coloured line with a given thickness
-	// depth is in the range [0,100] with lower being closer to the viewer
-	virtual void drawLine(float x1, float y1, float x2, float y2, float thickness = 1.0f, float depth = 0.0f );
-
 	// draws simple text on the screen horizontally
 	// depth is in the range [0,100] with lower being closer to the viewer
 	virtual void drawText(Font* font, const char* text, float xPos, float yPos, float depth = 0.0f);
 
-	// sets the tint colour for all subsequent draw calls
-	void setRenderColour(float r, float g, float b, float a = 1.0f);
-	void setRenderColour(unsigned int colour);
+	// adds a recorder's commands to the frame. they are merged with the renderer's own in end(),
+	// in the order recorders were submitted, so the result doesn't depend on which thread finished
+	// first. call between begin() and end(), once the recorder is finished with, and leave it
+	// unchanged until end()
+	void submit(const SpriteRecorder& recorder);
+
+	// adds the grid's sprites that are in view, visiting only the cells the view overlaps
+	void drawGrid(SpriteGrid& grid);
 
-	// can be used to set the texture coordinates of sprites using textures
-	// for all subsequent drawSprite calls
-	void setUVRect(float uvX, float uvY, float uvW, float uvH);
+	// draws the layer's chunks that are in view, each with one draw call from its own buffers.
+	// chunks whose tiles changed are rebuilt first. the layer must outlive end()
+	void drawTileLayer(TileLayer& layer);
 
 	// specify the camera position
 	void setCameraPos(float x, float y) { m_cameraX = x; m_cameraY = y; }
 	void getCameraPos(float& x, float& y) const { x = m_cameraX; y = m_cameraY; }
 
+	// the ring buffer that sprite batches are streamed through, for its stall statistics
+	RingBuffer* getStreamBuffer() const { return m_streamBuffer; }
+
+	unsigned int getMaxSprites() const { return m_maxSprites; }
+
+	// draw calls made, and textures bound in to the batch, since begin()
+	unsigned int getDrawCallCount() const { return m_drawCalls; }
+	unsigned int getTextureSwitchCount() const { return m_textureSwitches; }
+
+	// with sorting off, commands are built in the order they were drawn
+	void setSortingEnabled(bool enabled) { m_sortingEnabled = enabled; }
+	bool isSortingEnabled() const { return m_sortingEnabled; }
+
+	// also sorts commands of the same depth by whether they are instanced and then by texture, so each
+	// texture is bound once per depth and the instanced and vertex batches don't flush each other.
+	// overlapping sprites of the same depth may then be drawn out of order, so it is off by default
+	// and only suits scenes that give overlapping sprites their own depths
+	void setTextureSortingEnabled(bool enabled) { m_textureSortingEnabled = enabled; }
+	bool isTextureSortingEnabled() const { return m_textureSortingEnabled; }
+
+	// sprites and text are uploaded as one record each and expanded in to quads by the vertex
+	// shader. with instancing off they are built in to four vertices on the cpu like everything else
+	void setInstancingEnabled(bool enabled) { m_instancingEnabled = enabled; }
+	bool isInstancingEnabled() const { return m_instancingEnabled; }
+
+	// bytes streamed to the gpu since begin()
+	unsigned int getUploadedSize() const { return m_uploadedSize; }
+
+	// commands entirely outside the view at begin() are dropped rather than built
+	void setCullingEnabled(bool enabled) { m_cullingEnabled = enabled; }
+	bool isCullingEnabled() const { return m_cullingEnabled; }
+
+	// commands dropped for being out of view, and grid sprites visited, since begin()
+	unsigned int getCulledCount() const { return m_culledCount; }
+	unsigned int getVisitedCount() const { return m_visitedCount; }
+
 	// specify the camera scale/zoom
 	void  setCameraScale(float scale) { m_cameraScale = scale; }
 	float getCameraScale() { return m_cameraScale; }
 
 protected:
 
+	// culls and sorts the renderer's own commands recorded so far, builds them and draws them.
+	// end() merges the submitted recorders in first
+	void submitCommands();
+	bool isVisible(const SpriteCommand& command) const;
+	void buildCommand(const SpriteCommand& command);
+	void drawChunk(const SpriteCommand& command);
+	void buildChunk(TileLayer& layer, unsigned int chunkIndex);
+
 	// helper methods used during drawing
 	bool shouldFlush(int additionalVertices = 0, int additionalIndices = 0);
 	void flushBatch();
-	unsigned int pushTexture(Texture* texture);
+	unsigned int pushTexture(unsigned int texture, bool isFont);
 
 	// indicates in the middle of a begin/end pair
 	bool				m_renderBegun;
@@ -69,35 +118,76 @@ protected:
 	// texture handling
 	enum { TEXTURE_STACK_SIZE = 16 };
 	Texture*			m_nullTexture;
-	Texture*			m_textureStack[TEXTURE_STACK_SIZE];
+	unsigned int		m_textureStack[TEXTURE_STACK_SIZE];
 	int					m_fontTexture[TEXTURE_STACK_SIZE];
 	unsigned int		m_currentTexture;
 
-	// texture coordinate information
-	float				m_uvX, m_uvY, m_uvW, m_uvH;
-
-	// represents colour in red, green, blue and alpha 0.0-1.0 range
-	float				m_r, m_g, m_b, m_a;
-
 	// sprite handling
-	enum { MAX_SPRITES = 512 };
 	struct SBVertex {
 		float pos[4];
 		float color[4];
 		float texcoord[2];
 	};
 
-	// data used for opengl to draw the sprites (with padding)
-	SBVertex			m_vertices[MAX_SPRITES * 4];
-	unsigned short		m_indices[MAX_SPRITES * 6];
-	int					m_currentVertex, m_currentIndex;
-	unsigned int		m_vao, m_vbo, m_ibo;
+	// data used for opengl to draw the sprites, sized for the batch capacity.
+	// indices are 32-bit so that a batch isn't limited to 16k sprites
+	unsigned int				m_maxSprites;
+	std::vector<SBVertex>		m_vertices;
+	std::vector<unsigned int>	m_indices;
+	int							m_currentVertex, m_currentIndex;
+	unsigned int				m_vao;
+	unsigned int				m_drawCalls;
+	unsigned int				m_textureSwitches;
+	unsigned int				m_uploadedSize;
+
+	// recorders submitted since begin(), and the order commands are built in
+	std::vector<const SpriteRecorder*>	m_recorders;
+	std::vector<unsigned int>	m_order;
+	bool						m_sortingEnabled;
+	bool						m_textureSortingEnabled;
+
+	// the view's bounds at begin(), for culling
+	bool						m_cullingEnabled;
+	unsigned int				m_culledCount;
+	unsigned int				m_visitedCount;
+	float						m_viewLeft, m_viewRight, m_viewBottom, m_viewTop;
+
+	// tile layers drawn since begin(), which chunk commands refer to by index
+	std::vector<TileLayer*>		m_layers;
+	std::vector<SBVertex>		m_chunkVertices;
+	std::vector<unsigned int>	m_chunkIndices;
+
+	// a sprite drawn instanced, under a third the size of the four vertices and six indices it replaces
+	struct SBInstance {
+		float			position[2];
+		float			size[2];
+		float			rotation;
+		float			depth;
+		float			texcoords[4];
+		unsigned short	origin[2];
+		unsigned char	colour[4];
+		float			textureID;
+	};
+
+	std::vector<SBInstance>		m_instances;
+	int							m_currentInstance;
+	unsigned int				m_instanceVao;
+	bool						m_instancingEnabled;
+
+	// batches are copied in to a persistently mapped ring rather than a fixed buffer,
+	// so a flush never waits for the gpu to finish drawing the previous one
+	RingBuffer*			m_streamBuffer;
 
 	// shader used to render sprites
 	unsigned int		m_shader;
-
-	// helper method used to rotate sprites around a pivot
-	void	rotateAround(float inX, float inY, float& outX, float& outY, float sin, float cos);
+	int					m_isFontTextureLocation;
+	int					m_projectionMatrixLocation;
+	int					m_layerOffsetLocation;
+
+	// shader used to expand instanced sprites
+	unsigned int		m_instanceShader;
+	int					m_instanceIsFontTextureLocation;
+	int					m_instanceProjectionMatrixLocation;
 
 	// data used for a virtual camera
 	float	m_projectionMatrix[16];
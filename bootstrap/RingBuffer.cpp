@@ -0,0 +1,109 @@
+#include "gl_core_4_4.h"
+#include "RingBuffer.h"
+#include <GLFW/glfw3.h>
+#include <assert.h>
+#include <stdio.h>
+
+namespace aie {
+
+RingBuffer::RingBuffer(unsigned int size)
+	: m_glHandle(0),
+	m_size(size),
+	m_mapped(nullptr),
+	m_head(0),
+	m_used(0),
+	m_pending(0),
+	m_stallCount(0),
+	m_stallTime(0) {
+
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	glGenBuffers(1, &m_glHandle);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_glHandle);
+	glBufferStorage(GL_COPY_WRITE_BUFFER, m_size, nullptr, flags);
+	m_mapped = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, m_size, flags);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	if (m_mapped == nullptr)
+		printf("Error: Failed to map streaming ring buffer!\n");
+}
+
+RingBuffer::~RingBuffer() {
+	for (auto& region : m_regions)
+		glDeleteSync(region.sync);
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_glHandle);
+	glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	glDeleteBuffers(1, &m_glHandle);
+}
+
+void* RingBuffer::allocate(unsigned int size, unsigned int alignment, unsigned int& offset) {
+	assert(size <= m_size && "Allocation larger than the ring buffer");
+
+	// alignment doesn't need to be a power of two, vertex strides are used directly
+	offset = (m_head + alignment - 1) / alignment * alignment;
+
+	// skip the end of the buffer if it won't fit, the skipped bytes are still in use until fenced
+	if (offset + size > m_size)
+		offset = 0;
+
+	unsigned int required = (offset >= m_head ? offset - m_head : m_size - m_head) + size;
+
+	while (m_size - m_used < required) {
+
+		// everything has been retired, so start again from the beginning
+		if (m_used == 0) {
+			offset = 0;
+			required = size;
+			break;
+		}
+
+		// wrapped on to our own unfenced writes, guard them so we can wait on them
+		if (m_regions.empty())
+			fence();
+
+		retire();
+	}
+
+	m_head = offset + size;
+	m_used += required;
+	m_pending += required;
+
+	return m_mapped + offset;
+}
+
+void RingBuffer::fence() {
+	if (m_pending == 0)
+		return;
+
+	Region region;
+	region.sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	region.size = m_pending;
+	m_regions.push_back(region);
+
+	m_pending = 0;
+}
+
+void RingBuffer::retire() {
+	Region region = m_regions.front();
+	m_regions.pop_front();
+
+	// only count it as a stall if the gpu hadn't already finished with the region
+	GLenum result = glClientWaitSync(region.sync, 0, 0);
+	if (result == GL_TIMEOUT_EXPIRED) {
+		double start = glfwGetTime();
+
+		do {
+			result = glClientWaitSync(region.sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		} while (result == GL_TIMEOUT_EXPIRED);
+
+		m_stallCount++;
+		m_stallTime += float((glfwGetTime() - start) * 1000.0);
+	}
+
+	glDeleteSync(region.sync);
+	m_used -= region.size;
+}
+
+} // namespace aie
\ No newline at end of file
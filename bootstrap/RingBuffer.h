@@ -0,0 +1,60 @@
+#pragma once
+
+#include <deque>
+
+typedef struct __GLsync *GLsync;
+
+namespace aie {
+
+// a persistently and coherently mapped buffer for streaming per-frame data to the gpu.
+// writes go straight in to the mapping, and each fence guards everything written since
+// the previous one, so space is only waited on if the gpu is still reading it.
+// size it to hold around three frames of data so writes never have to wait
+class RingBuffer {
+public:
+
+	RingBuffer(unsigned int size);
+	~RingBuffer();
+
+	// reserves space in the ring, waiting on the gpu if it has wrapped around on to data still in use.
+	// returns where to write, with offset set to the same position within the buffer
+	void* allocate(unsigned int size, unsigned int alignment, unsigned int& offset);
+
+	// guards everything allocated since the last fence, call once the draws that read it are issued
+	void fence();
+
+	// returns the opengl buffer handle
+	unsigned int getHandle() const { return m_glHandle; }
+	unsigned int getSize() const { return m_size; }
+
+	// number of allocations that had to wait on the gpu, and how long they waited in milliseconds
+	unsigned int getStallCount() const { return m_stallCount; }
+	float getStallTime() const { return m_stallTime; }
+	void resetStats() { m_stallCount = 0; m_stallTime = 0; }
+
+protected:
+
+	// waits for the oldest fenced region and returns its space to the ring
+	void retire();
+
+	struct Region {
+		GLsync			sync;
+		unsigned int	size;
+	};
+
+	unsigned int		m_glHandle;
+	unsigned int		m_size;
+	unsigned char*		m_mapped;
+
+	// next write position, bytes in use by the gpu or not yet fenced, and bytes not yet fenced
+	unsigned int		m_head;
+	unsigned int		m_used;
+	unsigned int		m_pending;
+
+	std::deque<Region>	m_regions;
+
+	unsigned int		m_stallCount;
+	float				m_stallTime;
+};
+
+} // namespace aie
\ No newline at end of file
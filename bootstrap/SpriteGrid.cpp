@@ -0,0 +1,40 @@
+#include "SpriteGrid.h"
+#include <algorithm>
+
+namespace aie {
+
+SpriteGrid::SpriteGrid(float cellSize /* = 512.0f */)
+	: m_cellSize(cellSize),
+	m_indexedCount(0),
+	m_visit(0) {
+}
+
+void SpriteGrid::clear() {
+	SpriteRecorder::clear();
+
+	m_cells.clear();
+	m_visits.clear();
+	m_indexedCount = 0;
+}
+
+void SpriteGrid::index() {
+	if (m_indexedCount == m_commands.size())
+		return;
+
+	m_visits.resize(m_commands.size(), m_visit);
+
+	for (unsigned int i = m_indexedCount; i < m_commands.size(); ++i) {
+		float x0, y0, x1, y1;
+		m_commands[i].getBounds(x0, y0, x1, y1);
+
+		int cellX0 = (int)floorf(x0 / m_cellSize), cellX1 = (int)floorf(x1 / m_cellSize);
+		int cellY0 = (int)floorf(y0 / m_cellSize), cellY1 = (int)floorf(y1 / m_cellSize);
+		for (int y = cellY0; y <= cellY1; ++y)
+			for (int x = cellX0; x <= cellX1; ++x)
+				m_cells[getKey(x, y)].push_back(i);
+	}
+
+	m_indexedCount = (unsigned int)m_commands.size();
+}
+
+} // namespace aie
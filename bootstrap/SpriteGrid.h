@@ -0,0 +1,90 @@
+#pragma once
+
+#include "SpriteRecorder.h"
+#include <cmath>
+#include <unordered_map>
+#include <vector>
+
+namespace aie {
+
+// a recorder for sprites that don't move, such as the scenery of a large world. they are
+// recorded once and kept in a spatial hash of square cells, so Renderer2D::drawGrid() only
+// visits the cells the view overlaps rather than every sprite. sprites overlapping several
+// cells are listed in each, and visited once
+class SpriteGrid : public SpriteRecorder {
+public:
+
+	SpriteGrid(float cellSize = 512.0f);
+	virtual ~SpriteGrid() {}
+
+	// forgets every sprite in the grid
+	virtual void clear();
+
+	float getCellSize() const { return m_cellSize; }
+	unsigned int getCellCount() const { return (unsigned int)m_cells.size(); }
+
+protected:
+
+	friend class Renderer2D;
+
+	// calls the visitor with the index of each command whose cells overlap the rectangle
+	template <typename Visitor>
+	void visit(float x0, float y0, float x1, float y1, Visitor visitor);
+
+	// adds commands recorded since the last call to the cells they overlap
+	void index();
+
+	static unsigned long long getKey(int x, int y) {
+		return ((unsigned long long)(unsigned int)x << 32) | (unsigned int)y;
+	}
+
+	float			m_cellSize;
+
+	// command indices by cell, and the commands added to them so far
+	std::unordered_map<unsigned long long, std::vector<unsigned int>>	m_cells;
+	unsigned int	m_indexedCount;
+
+	// the visit each command was last seen on, so one in several cells is only visited once
+	std::vector<unsigned int>	m_visits;
+	unsigned int	m_visit;
+};
+
+template <typename Visitor>
+void SpriteGrid::visit(float x0, float y0, float x1, float y1, Visitor visitor) {
+	index();
+
+	++m_visit;
+
+	auto visitCell = [&](const std::vector<unsigned int>& cell) {
+		for (unsigned int index : cell) {
+			if (m_visits[index] != m_visit) {
+				m_visits[index] = m_visit;
+				visitor(index);
+			}
+		}
+	};
+
+	float cellX0 = floorf(x0 / m_cellSize), cellX1 = floorf(x1 / m_cellSize);
+	float cellY0 = floorf(y0 / m_cellSize), cellY1 = floorf(y1 / m_cellSize);
+
+	// zoomed far enough out, walking the cells that exist is cheaper than looking up every one in view
+	if ((cellX1 - cellX0 + 1) * (cellY1 - cellY0 + 1) > (float)m_cells.size()) {
+		for (auto& cell : m_cells) {
+			int x = (int)(cell.first >> 32), y = (int)(unsigned int)cell.first;
+			if (x >= cellX0 && x <= cellX1 &&
+				y >= cellY0 && y <= cellY1)
+				visitCell(cell.second);
+		}
+		return;
+	}
+
+	for (int y = (int)cellY0; y <= (int)cellY1; ++y) {
+		for (int x = (int)cellX0; x <= (int)cellX1; ++x) {
+			auto cell = m_cells.find(getKey(x, y));
+			if (cell != m_cells.end())
+				visitCell(cell->second);
+		}
+	}
+}
+
+} // namespace aie
\ No newline at end of file
@@ -0,0 +1,264 @@
+#include "SpriteRecorder.h"
+#include "Texture.h"
+#include "TextureAtlas.h"
+#include <glm/ext.hpp>
+
+namespace aie {
+
+void SpriteCommand::getBounds(float& x0, float& y0, float& x1, float& y1) const {
+	if (type == CIRCLE) {
+		x0 = corners[0] - corners[2];	y0 = corners[1] - corners[2];
+		x1 = corners[0] + corners[2];	y1 = corners[1] + corners[2];
+	}
+	else if (type == SPRITE) {
+		float width = corners[2], height = corners[3];
+		float left = -corners[5] * width, right = (1.0f - corners[5]) * width;
+		float bottom = -corners[6] * height, top = (1.0f - corners[6]) * height;
+
+		if (corners[4] != 0.0f) {
+			float reachX = glm::max(glm::abs(left), glm::abs(right));
+			float reachY = glm::max(glm::abs(bottom), glm::abs(top));
+			float radius = glm::sqrt(reachX * reachX + reachY * reachY);
+			left = bottom = -radius;
+			right = top = radius;
+		}
+
+		x0 = corners[0] + glm::min(left, right);	y0 = corners[1] + glm::min(bottom, top);
+		x1 = corners[0] + glm::max(left, right);	y1 = corners[1] + glm::max(bottom, top);
+	}
+	else if (type == CHUNK) {
+		x0 = corners[2];	y0 = corners[3];
+		x1 = corners[4];	y1 = corners[5];
+	}
+	else {
+		x0 = x1 = corners[0];
+		y0 = y1 = corners[1];
+		for (int i = 2; i < 8; i += 2) {
+			x0 = glm::min(x0, corners[i]);	y0 = glm::min(y0, corners[i + 1]);
+			x1 = glm::max(x1, corners[i]);	y1 = glm::max(y1, corners[i + 1]);
+		}
+	}
+}
+
+SpriteRecorder::SpriteRecorder() {
+	setRenderColour(1, 1, 1, 1);
+	setUVRect(0.0f, 0.0f, 1.0f, 1.0f);
+}
+
+void SpriteRecorder::clear() {
+	m_commands.clear();
+	setRenderColour(1, 1, 1, 1);
+	setUVRect(0.0f, 0.0f, 1.0f, 1.0f);
+}
+
+void SpriteRecorder::drawBox(float xPos, float yPos, float width, float height, float rotation, float depth) {
+	drawSprite(nullptr, xPos, yPos, width, height, rotation, depth);
+}
+
+void SpriteRecorder::drawCircle(float xPos, float yPos, float radius, float depth) {
+
+	SpriteCommand& command = addCommand(SpriteCommand::CIRCLE, 0, false, depth);
+	command.corners[0] = xPos;
+	command.corners[1] = yPos;
+	command.corners[2] = radius;
+}
+
+void SpriteRecorder::drawSprite(Texture * texture,
+							 float xPos, float yPos, 
+							 float width, float height, 
+							 float rotation, float depth, float xOrigin, float yOrigin) {
+	// with no texture it is coloured, as if it were a 1x1 white texture
+	if (width == 0.0f)
+		width = texture != nullptr ? (float)texture->getWidth() : 1.0f;
+	if (height == 0.0f)
+		height = texture != nullptr ? (float)texture->getHeight() : 1.0f;
+
+	// the corners are worked out when the command is built, or by the gpu if it is instanced
+	SpriteCommand& command = addCommand(SpriteCommand::SPRITE, texture != nullptr ? texture->getHandle() : 0, false, depth);
+	setSprite(command, xPos, yPos, width, height, rotation, xOrigin, yOrigin);
+	setTexCoords(command, m_uvX, m_uvY, m_uvX + m_uvW, m_uvY + m_uvH);
+}
+
+void SpriteRecorder::drawSprite(const TextureRegion& region,
+							 float xPos, float yPos,
+							 float width, float height,
+							 float rotation, float depth, float xOrigin, float yOrigin) {
+	if (width == 0.0f)
+		width = (float)region.width;
+	if (height == 0.0f)
+		height = (float)region.height;
+
+	float uvX = m_uvX;
+	float uvY = m_uvY;
+	float uvW = m_uvW;
+	float uvH = m_uvH;
+
+	setUVRect(region.uvX + uvX * region.uvW, region.uvY + uvY * region.uvH, uvW * region.uvW, uvH * region.uvH);
+
+	drawSprite(region.texture, xPos, yPos, width, height, rotation, depth, xOrigin, yOrigin);
+
+	setUVRect(uvX, uvY, uvW, uvH);
+}
+
+void SpriteRecorder::drawSpriteTransformed3x3(Texture * texture,
+										   float * transformMat3x3, 
+										   float width, float height, float depth,
+										   float xOrigin, float yOrigin) {
+	// with no texture it is coloured, as if it were a 1x1 white texture
+	if (width == 0.0f)
+		width = texture != nullptr ? (float)texture->getWidth() : 1.0f;
+	if (height == 0.0f)
+		height = texture != nullptr ? (float)texture->getHeight() : 1.0f;
+
+	float tlX = (0.0f - xOrigin) * width;		float tlY = (0.0f - yOrigin) * height;
+	float trX = (1.0f - xOrigin) * width;		float trY = (0.0f - yOrigin) * height;
+	float brX = (1.0f - xOrigin) * width;		float brY = (1.0f - yOrigin) * height;
+	float blX = (0.0f - xOrigin) * width;		float blY = (1.0f - yOrigin) * height;
+
+	// transform the points by the matrix
+	// 0 3 6
+	// 1 4 7
+	// 2 5 8
+	float x, y;
+	x = tlX; y = tlY;
+	tlX = x * transformMat3x3[0] + y * transformMat3x3[3] + transformMat3x3[6];
+	tlY = x * transformMat3x3[1] + y * transformMat3x3[4] + transformMat3x3[7];
+	x = trX; y = trY;
+	trX = x * transformMat3x3[0] + y * transformMat3x3[3] + transformMat3x3[6];
+	trY = x * transformMat3x3[1] + y * transformMat3x3[4] + transformMat3x3[7];
+	x = brX; y = brY;
+	brX = x * transformMat3x3[0] + y * transformMat3x3[3] + transformMat3x3[6];
+	brY = x * transformMat3x3[1] + y * transformMat3x3[4] + transformMat3x3[7];
+	x = blX; y = blY;
+	blX = x * transformMat3x3[0] + y * transformMat3x3[3] + transformMat3x3[6];
+	blY = x * transformMat3x3[1] + y * transformMat3x3[4] + transformMat3x3[7];	
+
+	SpriteCommand& command = addCommand(SpriteCommand::QUAD, texture != nullptr ? texture->getHandle() : 0, false, depth);
+	setCorners(command, tlX, tlY, trX, trY, brX, brY, blX, blY);
+	setTexCoords(command, m_uvX, m_uvY, m_uvX + m_uvW, m_uvY + m_uvH);
+}
+
+void SpriteRecorder::drawSpriteTransformed4x4(Texture * texture,
+										   float * transformMat4x4, 
+										   float width, float height, float depth,
+										   float xOrigin, float yOrigin) {
+	// with no texture it is coloured, as if it were a 1x1 white texture
+	if (width == 0.0f)
+		width = texture != nullptr ? (float)texture->getWidth() : 1.0f;
+	if (height == 0.0f)
+		height = texture != nullptr ? (float)texture->getHeight() : 1.0f;
+
+	float tlX = (0.0f - xOrigin) * width;		float tlY = (0.0f - yOrigin) * height;
+	float trX = (1.0f - xOrigin) * width;		float trY = (0.0f - yOrigin) * height;
+	float brX = (1.0f - xOrigin) * width;		float brY = (1.0f - yOrigin) * height;
+	float blX = (0.0f - xOrigin) * width;		float blY = (1.0f - yOrigin) * height;
+
+	// transform the points by the matrix
+	// 0 4 8  12
+	// 1 5 9  13
+	// 2 6 10 14
+	// 3 7 11 15
+	float x, y;
+	x = tlX; y = tlY;
+	tlX = x * transformMat4x4[0] + y * transformMat4x4[4] + transformMat4x4[12];
+	tlY = x * transformMat4x4[1] + y * transformMat4x4[5] + transformMat4x4[13];
+	x = trX; y = trY;
+	trX = x * transformMat4x4[0] + y * transformMat4x4[4] + transformMat4x4[12];
+	trY = x * transformMat4x4[1] + y * transformMat4x4[5] + transformMat4x4[13];
+	x = brX; y = brY;
+	brX = x * transformMat4x4[0] + y * transformMat4x4[4] + transformMat4x4[12];
+	brY = x * transformMat4x4[1] + y * transformMat4x4[5] + transformMat4x4[13];
+	x = blX; y = blY;
+	blX = x * transformMat4x4[0] + y * transformMat4x4[4] + transformMat4x4[12];
+	blY = x * transformMat4x4[1] + y * transformMat4x4[5] + transformMat4x4[13];
+
+	SpriteCommand& command = addCommand(SpriteCommand::QUAD, texture != nullptr ? texture->getHandle() : 0, false, depth);
+	setCorners(command, tlX, tlY, trX, trY, brX, brY, blX, blY);
+	setTexCoords(command, m_uvX, m_uvY, m_uvX + m_uvW, m_uvY + m_uvH);
+}
+
+void SpriteRecorder::drawLine(float x1, float y1, float x2, float y2, float thickness, float depth) {
+
+	float xDiff = x2 - x1;
+	float yDiff = y2 - y1;
+	float len = glm::sqrt(xDiff * xDiff + yDiff * yDiff);
+	float xDir = xDiff / len;
+	float yDir = yDiff / len;
+
+	float rot = glm::atan(yDir, xDir);
+
+	float uvX = m_uvX;
+	float uvY = m_uvY;
+	float uvW = m_uvW;
+	float uvH = m_uvH;
+
+	setUVRect(0.0f, 0.0f, 1.0f, 1.0f);
+
+	drawSprite(nullptr, x1, y1, len, thickness, rot, depth, 0.0f, 0.5f);
+
+	setUVRect(uvX, uvY, uvW, uvH);
+}
+
+SpriteCommand& SpriteRecorder::addCommand(unsigned char type, unsigned int texture, bool isFont, float depth) {
+	m_commands.emplace_back();
+
+	SpriteCommand& command = m_commands.back();
+	command.type = type;
+	command.isFont = isFont ? 1 : 0;
+	command.texture = texture;
+	command.depth = depth;
+	command.colour = ((unsigned int)(glm::clamp(m_r, 0.0f, 1.0f) * 255.0f + 0.5f) << 24) |
+		((unsigned int)(glm::clamp(m_g, 0.0f, 1.0f) * 255.0f + 0.5f) << 16) |
+		((unsigned int)(glm::clamp(m_b, 0.0f, 1.0f) * 255.0f + 0.5f) << 8) |
+		((unsigned int)(glm::clamp(m_a, 0.0f, 1.0f) * 255.0f + 0.5f));
+	return command;
+}
+
+void SpriteRecorder::setCorners(SpriteCommand& command, float tlX, float tlY, float trX, float trY, float brX, float brY, float blX, float blY) {
+	command.corners[0] = tlX;	command.corners[1] = tlY;
+	command.corners[2] = trX;	command.corners[3] = trY;
+	command.corners[4] = brX;	command.corners[5] = brY;
+	command.corners[6] = blX;	command.corners[7] = blY;
+}
+
+void SpriteRecorder::setSprite(SpriteCommand& command, float xPos, float yPos, float width, float height, float rotation, float xOrigin, float yOrigin) {
+	command.corners[0] = xPos;		command.corners[1] = yPos;
+	command.corners[2] = width;		command.corners[3] = height;
+	command.corners[4] = rotation;
+	command.corners[5] = xOrigin;	command.corners[6] = yOrigin;
+}
+
+void SpriteRecorder::setTexCoords(SpriteCommand& command, float u0, float v0, float u1, float v1) {
+	command.texcoords[0] = u0;
+	command.texcoords[1] = v0;
+	command.texcoords[2] = u1;
+	command.texcoords[3] = v1;
+}
+
+void SpriteRecorder::setRenderColour(float r, float g, float b, float a) {
+	m_r = r;
+	m_g = g;
+	m_b = b;
+	m_a = a;
+}
+
+void SpriteRecorder::setRenderColour(unsigned int colour) {
+	m_r = ((colour & 0xFF000000) >> 24) / 255.0f;
+	m_g = ((colour & 0x00FF0000) >> 16) / 255.0f;
+	m_b = ((colour & 0x0000FF00) >> 8) / 255.0f;
+	m_a = ((colour & 0x000000FF) >> 0) / 255.0f;
+}
+
+void SpriteRecorder::setUVRect(float uvX, float uvY, float uvW, float uvH) {
+	m_uvX = uvX;
+	m_uvY = uvY;
+	m_uvW = uvW;
+	m_uvH = uvH;
+}
+
+void SpriteRecorder::rotateAround(float inX, float inY, float& outX, float& outY, float sin, float cos) {
+	outX = inX * cos - inY * sin;
+	outY = inX * sin + inY * cos;
+}
+
+} // namespace aie
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <vector>
+
+namespace aie {
+
+class Texture;
+struct TextureRegion;
+
+// a recorded draw, with the render colour and texture coords it was made with
+struct SpriteCommand {
+	enum { QUAD, SPRITE, CIRCLE, CHUNK };
+
+	unsigned char	type;
+	unsigned char	isFont;
+
+	// the texture's opengl handle, 0 for untextured
+	unsigned int	texture;
+	float			depth;
+
+	// rgba8
+	unsigned int	colour;
+
+	// a quad's corners, top left, top right, bottom right and bottom left, a sprite's
+	// position, size, rotation and origin, a circle's centre and radius, or a tile layer
+	// chunk's layer, chunk index and bounds
+	float			corners[8];
+	float			texcoords[4];
+
+	// the rectangle the command could draw in to, which for rotated sprites is
+	// the square around the circle their corners turn on
+	void getBounds(float& x0, float& y0, float& x1, float& y1) const;
+};
+
+// records sprite draws as commands without making any gl calls, so that a worker thread can
+// fill one while others fill their own. Renderer2D::submit() hands a recorder's commands
+// to the renderer, which builds them along with its own in end()
+class SpriteRecorder {
+public:
+
+	SpriteRecorder();
+	virtual ~SpriteRecorder() {}
+
+	// simple shape rendering
+	virtual void drawBox(float xPos, float yPos, float width, float height, float rotation = 0.0f, float depth = 0.0f);
+	virtual void drawCircle(float xPos, float yPos, float radius, float depth = 0.0f);
+
+	// if texture is nullptr then it renders a coloured sprite
+	// depth is in the range [0,100] with lower being closer to the viewer
+	virtual void drawSprite(Texture* texture, float xPos, float yPos, float width = 0.0f, float height = 0.0f, float rotation = 0.0f, float depth = 0.0f, float xOrigin = 0.5f, float yOrigin = 0.5f);
+
+	// draws an image packed in a TextureAtlas, at its own size if width and height are 0.
+	// the uv rect is within the region, so setUVRect() can still pick out frames of it
+	virtual void drawSprite(const TextureRegion& region, float xPos, float yPos, float width = 0.0f, float height = 0.0f, float rotation = 0.0f, float depth = 0.0f, float xOrigin = 0.5f, float yOrigin = 0.5f);
+
+	virtual void drawSpriteTransformed3x3(Texture* texture, float* transformMat3x3, float width = 0.0f, float height = 0.0f, float depth = 0.0f, float xOrigin = 0.5f, float yOrigin = 0.5f);
+	virtual void drawSpriteTransformed4x4(Texture* texture, float* transformMat4x4, float width = 0.0f, float height = 0.0f, float depth = 0.0f, float xOrigin = 0.5f, float yOrigin = 0.5f);
+
+	// draws a simple coloured line with a given thickness
+	// depth is in the range [0,100] with lower being closer to the viewer
+	virtual void drawLine(float x1, float y1, float x2, float y2, float thickness = 1.0f, float depth = 0.0f );
+
+	// sets the tint colour for all subsequent draw calls
+	void setRenderColour(float r, float g, float b, float a = 1.0f);
+	void setRenderColour(unsigned int colour);
+
+	// can be used to set the texture coordinates of sprites using textures
+	// for all subsequent drawSprite calls
+	void setUVRect(float uvX, float uvY, float uvW, float uvH);
+
+	// forgets the recorded commands and resets the colour and uv rect
+	virtual void clear();
+
+	unsigned int getCommandCount() const { return (unsigned int)m_commands.size(); }
+
+protected:
+
+	friend class Renderer2D;
+
+	SpriteCommand& addCommand(unsigned char type, unsigned int texture, bool isFont, float depth);
+	void setCorners(SpriteCommand& command, float tlX, float tlY, float trX, float trY, float brX, float brY, float blX, float blY);
+	void setSprite(SpriteCommand& command, float xPos, float yPos, float width, float height, float rotation, float xOrigin, float yOrigin);
+	void setTexCoords(SpriteCommand& command, float u0, float v0, float u1, float v1);
+
+	// helper method used to rotate sprites around a pivot
+	static void rotateAround(float inX, float inY, float& outX, float& outY, float sin, float cos);
+
+	// texture coordinate information
+	float				m_uvX, m_uvY, m_uvW, m_uvH;
+
+	// represents colour in red, green, blue and alpha 0.0-1.0 range
+	float				m_r, m_g, m_b, m_a;
+
+	std::vector<SpriteCommand>	m_commands;
+};
+
+} // namespace aie
\ No newline at end of file
@@ -1,18 +1,222 @@
 #include "gl_core_4_4.h"
 #include "Texture.h"
+#include "MipChain.h"
+#include "ProgramCache.h"
+#include "TextureUploader.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <direct.h>
+#include <sys/stat.h>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+#define STB_DXT_IMPLEMENTATION
+#include <stb_dxt.h>
+
+// from EXT_texture_compression_s3tc, which the core 4.4 loader doesn't know about
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
 namespace aie {
 
+static const char* TEXTURE_CACHE_DIRECTORY = "./texturecache";
+
+// written ahead of the mips in the cache, each mip follows as its size then its pixels or blocks
+struct TextureCacheHeader {
+	unsigned int		magic;
+	unsigned int		format;
+	unsigned int		width;
+	unsigned int		height;
+	unsigned int		levels;
+	unsigned int		padding;
+	unsigned long long	key;
+};
+
+static const unsigned int TEXTURE_CACHE_MAGIC = 0x58455443; // "CTEX"
+
+// bump when the mips or compression change, so that old cache files are rebuilt
+static const unsigned int TEXTURE_CACHE_VERSION = 2;
+
+// the same image is cached separately for each way it can be loaded
+enum eTextureCacheMode : unsigned int {
+	CACHE_UNCOMPRESSED = 0,
+	CACHE_COMPRESSED,
+	CACHE_COMPRESSED_NORMALS,
+	CACHE_UNCOMPRESSED_DATA,
+	CACHE_COMPRESSED_DATA,
+};
+
+// the cache is keyed on the file's name, size and modification time, so an edited
+// image is rebuilt without having to be read. fails if there is no such file
+static bool makeCacheKey(const char* filename, eTextureCacheMode mode, unsigned long long& key) {
+	struct _stat64 info;
+	if (_stat64(filename, &info) != 0 ||
+		(info.st_mode & S_IFREG) == 0)
+		return false;
+
+	key = ProgramCache::hash(filename);
+	key = ProgramCache::hash(&info.st_size, sizeof(info.st_size), key);
+	key = ProgramCache::hash(&info.st_mtime, sizeof(info.st_mtime), key);
+	key = ProgramCache::hash(&mode, sizeof(mode), key);
+	key = ProgramCache::hash(&TEXTURE_CACHE_VERSION, sizeof(TEXTURE_CACHE_VERSION), key);
+	return true;
+}
+
+static void getCachePath(unsigned long long key, char (&path)[64]) {
+	sprintf_s(path, "%s/%016llx.tex", TEXTURE_CACHE_DIRECTORY, key);
+}
+
+static bool readCacheHeader(unsigned long long key, TextureCacheHeader& header) {
+	char path[64];
+	getCachePath(key, path);
+
+	FILE* file = nullptr;
+	fopen_s(&file, path, "rb");
+	if (file == nullptr)
+		return false;
+
+	bool valid = fread(&header, sizeof(header), 1, file) == 1 &&
+		header.magic == TEXTURE_CACHE_MAGIC &&
+		header.key == key;
+	fclose(file);
+	return valid;
+}
+
+// levels before the first are skipped over and left empty
+static bool readCache(unsigned long long key, TextureCacheHeader& header, std::vector<std::vector<unsigned char>>& levels,
+					  unsigned int firstLevel = 0) {
+	char path[64];
+	getCachePath(key, path);
+
+	FILE* file = nullptr;
+	fopen_s(&file, path, "rb");
+	if (file == nullptr)
+		return false;
+
+	levels.clear();
+	if (fread(&header, sizeof(header), 1, file) == 1 &&
+		header.magic == TEXTURE_CACHE_MAGIC &&
+		header.key == key) {
+
+		levels.resize(header.levels);
+		for (unsigned int index = 0; index < header.levels; ++index) {
+			std::vector<unsigned char>& level = levels[index];
+
+			unsigned int size = 0;
+			if (fread(&size, sizeof(size), 1, file) != 1)
+				break;
+			if (index < firstLevel) {
+				fseek(file, size, SEEK_CUR);
+				continue;
+			}
+			level.resize(size);
+			if (fread(level.data(), 1, size, file) != size) {
+				level.clear();
+				break;
+			}
+		}
+
+		// a truncated file is treated as a miss
+		if (levels.empty() == false && levels.back().empty())
+			levels.clear();
+	}
+	fclose(file);
+
+	return levels.empty() == false;
+}
+
+static void writeCache(const TextureCacheHeader& header, const std::vector<std::vector<unsigned char>>& levels) {
+	char path[64];
+	getCachePath(header.key, path);
+
+	_mkdir(TEXTURE_CACHE_DIRECTORY);
+
+	FILE* file = nullptr;
+	fopen_s(&file, path, "wb");
+	if (file == nullptr)
+		return;
+
+	fwrite(&header, sizeof(header), 1, file);
+	for (auto& level : levels) {
+		unsigned int size = (unsigned int)level.size();
+		fwrite(&size, sizeof(size), 1, file);
+		fwrite(level.data(), 1, size, file);
+	}
+	fclose(file);
+}
+
+// debug builds check the mip filter against stb_image_resize, which should agree to within rounding
+static void checkMips(const MipChain& mips, const char* filename) {
+#ifdef _DEBUG
+	int difference = mips.validate();
+	if (difference > 1)
+		printf("Mips for [%s] differ from stb_image_resize by up to %d!\n", filename, difference);
+#endif
+}
+
+// compresses an rgba image in to 4x4 blocks, repeating edge pixels for mips smaller than a block
+static void compressImage(const unsigned char* pixels, unsigned int width, unsigned int height,
+						  Texture::Format format, std::vector<unsigned char>& blocks) {
+	unsigned int blockSize = format == Texture::BC1 ? 8 : 16;
+	unsigned int blocksWide = (width + 3) / 4, blocksHigh = (height + 3) / 4;
+	blocks.resize(blocksWide * blocksHigh * blockSize);
+
+	unsigned char* output = blocks.data();
+	unsigned char block[64], channel[64], scratch[16];
+	for (unsigned int by = 0; by < blocksHigh; ++by) {
+		for (unsigned int bx = 0; bx < blocksWide; ++bx) {
+			for (unsigned int y = 0; y < 4; ++y) {
+				unsigned int sy = std::min(by * 4 + y, height - 1);
+				for (unsigned int x = 0; x < 4; ++x) {
+					unsigned int sx = std::min(bx * 4 + x, width - 1);
+					memcpy(&block[(y * 4 + x) * 4], &pixels[(sy * width + sx) * 4], 4);
+				}
+			}
+
+			if (format == Texture::BC5) {
+
+				// BC5 is two BC4 blocks, which are laid out the same as a DXT5 alpha block,
+				// so compress each channel as alpha and keep just that half
+				for (unsigned int c = 0; c < 2; ++c) {
+					for (unsigned int i = 0; i < 16; ++i) {
+						channel[i * 4 + 0] = channel[i * 4 + 1] = channel[i * 4 + 2] = 0;
+						channel[i * 4 + 3] = block[i * 4 + c];
+					}
+					stb_compress_dxt_block(scratch, channel, 1, STB_DXT_HIGHQUAL);
+					memcpy(output + c * 8, scratch, 8);
+				}
+			}
+			else {
+				stb_compress_dxt_block(output, block, format == Texture::BC3 ? 1 : 0, STB_DXT_HIGHQUAL);
+			}
+			output += blockSize;
+		}
+	}
+}
+
 Texture::Texture() 
 	: m_filename("none"),
 	m_width(0),
 	m_height(0),
 	m_glHandle(0),
 	m_format(0),
-	m_loadedPixels(nullptr) {
+	m_loadedPixels(nullptr),
+	m_memorySize(0),
+	m_levelCount(0),
+	m_residentLevel(0),
+	m_minResidentLevel(0),
+	m_maxResidentLevel(0),
+	m_cacheKey(0),
+	m_uploadID(0),
+	m_loadFailed(false) {
 }
 
 Texture::Texture(const char * filename)
@@ -21,7 +225,15 @@ Texture::Texture(const char * filename)
 	m_height(0),
 	m_glHandle(0),
 	m_format(0),
-	m_loadedPixels(nullptr) {
+	m_loadedPixels(nullptr),
+	m_memorySize(0),
+	m_levelCount(0),
+	m_residentLevel(0),
+	m_minResidentLevel(0),
+	m_maxResidentLevel(0),
+	m_cacheKey(0),
+	m_uploadID(0),
+	m_loadFailed(false) {
 
 	load(filename);
 }
@@ -31,82 +243,436 @@ Texture::Texture(unsigned int width, unsigned int height, Format format, unsigne
 	m_width(width),
 	m_height(height),
 	m_format(format),
-	m_loadedPixels(nullptr) {
+	m_loadedPixels(nullptr),
+	m_memorySize(0),
+	m_levelCount(0),
+	m_residentLevel(0),
+	m_minResidentLevel(0),
+	m_maxResidentLevel(0),
+	m_cacheKey(0),
+	m_uploadID(0),
+	m_loadFailed(false) {
 
 	create(width, height, format, pixels);
 }
 
 Texture::~Texture() {
-	if (m_glHandle != 0)
-		glDeleteTextures(1, &m_glHandle);
+	cancelUpload();
 	if (m_loadedPixels != nullptr)
 		stbi_image_free(m_loadedPixels);
 }
 
-bool Texture::load(const char* filename) {
+Texture::Texture(Texture&& other) noexcept
+	: m_filename(std::move(other.m_filename)),
+	m_width(other.m_width),
+	m_height(other.m_height),
+	m_glHandle(std::move(other.m_glHandle)),
+	m_format(other.m_format),
+	m_loadedPixels(other.m_loadedPixels),
+	m_memorySize(other.m_memorySize),
+	m_levelCount(other.m_levelCount),
+	m_residentLevel(other.m_residentLevel),
+	m_minResidentLevel(other.m_minResidentLevel),
+	m_maxResidentLevel(other.m_maxResidentLevel),
+	m_cacheKey(other.m_cacheKey),
+	m_uploadID(other.m_uploadID),
+	m_loadFailed(other.m_loadFailed) {
 
-	if (m_glHandle != 0) {
-		glDeleteTextures(1, &m_glHandle);
-		m_glHandle = 0;
-		m_width = 0;
-		m_height = 0;
-		m_filename = "none";
+	// an upload still in flight carries on in to this texture
+	if (m_uploadID != 0 &&
+		TextureUploader::getInstance() != nullptr)
+		TextureUploader::getInstance()->retarget(m_uploadID, this);
+
+	other.m_filename = "none";
+	other.m_width = 0;
+	other.m_height = 0;
+	other.m_format = 0;
+	other.m_loadedPixels = nullptr;
+	other.m_memorySize = 0;
+	other.m_levelCount = 0;
+	other.m_residentLevel = 0;
+	other.m_minResidentLevel = 0;
+	other.m_maxResidentLevel = 0;
+	other.m_cacheKey = 0;
+	other.m_uploadID = 0;
+	other.m_loadFailed = false;
+}
+
+Texture& Texture::operator = (Texture&& other) noexcept {
+	if (this != &other) {
+		cancelUpload();
+		if (m_loadedPixels != nullptr)
+			stbi_image_free(m_loadedPixels);
+
+		m_filename = std::move(other.m_filename);
+		m_width = other.m_width;
+		m_height = other.m_height;
+		m_glHandle = std::move(other.m_glHandle);
+		m_format = other.m_format;
+		m_loadedPixels = other.m_loadedPixels;
+		m_memorySize = other.m_memorySize;
+		m_levelCount = other.m_levelCount;
+		m_residentLevel = other.m_residentLevel;
+		m_minResidentLevel = other.m_minResidentLevel;
+		m_maxResidentLevel = other.m_maxResidentLevel;
+		m_cacheKey = other.m_cacheKey;
+		m_uploadID = other.m_uploadID;
+		m_loadFailed = other.m_loadFailed;
+
+		if (m_uploadID != 0 &&
+			TextureUploader::getInstance() != nullptr)
+			TextureUploader::getInstance()->retarget(m_uploadID, this);
+
+		other.m_filename = "none";
+		other.m_width = 0;
+		other.m_height = 0;
+		other.m_format = 0;
+		other.m_loadedPixels = nullptr;
+		other.m_memorySize = 0;
+		other.m_levelCount = 0;
+		other.m_residentLevel = 0;
+		other.m_minResidentLevel = 0;
+		other.m_maxResidentLevel = 0;
+		other.m_cacheKey = 0;
+		other.m_uploadID = 0;
+		other.m_loadFailed = false;
 	}
+	return *this;
+}
 
-	int x = 0, y = 0, comp = 0;
-	m_loadedPixels = stbi_load(filename, &x, &y, &comp, STBI_default);
+bool Texture::decode(const char* filename, Content content, unsigned int& format, unsigned int& width,
+					 unsigned int& height, std::vector<std::vector<unsigned char>>& levels) {
 
-	if (m_loadedPixels != nullptr) {
-		glGenTextures(1, &m_glHandle);
-		glBindTexture(GL_TEXTURE_2D, m_glHandle);
-		switch (comp) {
-		case STBI_grey:
-			m_format = RED;
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, x, y,
-						 0, GL_RED, GL_UNSIGNED_BYTE, m_loadedPixels);
-			break;
-		case STBI_grey_alpha:
-			m_format = RG;
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RG, x, y,
-						 0, GL_RG, GL_UNSIGNED_BYTE, m_loadedPixels);
-			break;
-		case STBI_rgb:
-			m_format = RGB;
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, x, y,
-						 0, GL_RGB, GL_UNSIGNED_BYTE, m_loadedPixels);
-			break;
-		case STBI_rgb_alpha:
-			m_format = RGBA;
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, x, y,
-						 0, GL_RGBA, GL_UNSIGNED_BYTE, m_loadedPixels);
-			break;
-		default:	break;
-		};
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glGenerateMipmap(GL_TEXTURE_2D);
-		glBindTexture(GL_TEXTURE_2D, 0);
-		m_width = (unsigned int)x;
-		m_height = (unsigned int)y;
-		m_filename = filename;
+	unsigned long long key = 0;
+	if (makeCacheKey(filename, content == COLOUR ? CACHE_UNCOMPRESSED : CACHE_UNCOMPRESSED_DATA, key) == false)
+		return false;
+
+	TextureCacheHeader header = {};
+	if (readCache(key, header, levels) == false) {
+		int x = 0, y = 0, comp = 0;
+		unsigned char* pixels = stbi_load(filename, &x, &y, &comp, STBI_default);
+		if (pixels == nullptr)
+			return false;
+
+		MipChain mips;
+		mips.generate(pixels, x, y, comp, content == COLOUR);
+		stbi_image_free(pixels);
+		checkMips(mips, filename);
+
+		header.magic = TEXTURE_CACHE_MAGIC;
+		header.format = (unsigned int)comp; // formats match stb's component counts
+		header.width = (unsigned int)x;
+		header.height = (unsigned int)y;
+		header.levels = mips.getLevelCount();
+		header.key = key;
+
+		levels.swap(mips.getLevels());
+		writeCache(header, levels);
+	}
+
+	format = header.format;
+	width = header.width;
+	height = header.height;
+	return true;
+}
+
+bool Texture::load(const char* filename, Content content /* = COLOUR */) {
+
+	TextureUploader* uploader = TextureUploader::getInstance();
+	if (uploader != nullptr) {
+		struct _stat64 info;
+		if (_stat64(filename, &info) != 0 ||
+			(info.st_mode & S_IFREG) == 0)
+			return false;
+
+		uploader->load(this, filename, content);
 		return true;
 	}
-	return false;
+
+	m_loadFailed = false;
+
+	unsigned int format = 0, width = 0, height = 0;
+	std::vector<std::vector<unsigned char>> levels;
+	if (decode(filename, content, format, width, height, levels) == false)
+		return false;
+
+	upload(format, width, height, levels);
+
+	// keep the base level, as the decoded pixels were kept before
+	m_loadedPixels = (unsigned char*)malloc(levels[0].size());
+	memcpy(m_loadedPixels, levels[0].data(), levels[0].size());
+
+	m_filename = filename;
+	return true;
+}
+
+bool Texture::loadCompressed(const char* filename, Content content /* = COLOUR */, unsigned int maxSize /* = 0 */) {
+
+	// anything still arriving would land on top of the compressed levels
+	cancelUpload();
+
+	eTextureCacheMode mode = content == NORMALS ? CACHE_COMPRESSED_NORMALS :
+							 content == DATA ? CACHE_COMPRESSED_DATA : CACHE_COMPRESSED;
+
+	unsigned long long key = 0;
+	if (makeCacheKey(filename, mode, key) == false)
+		return false;
+
+	TextureCacheHeader header = {};
+	std::vector<std::vector<unsigned char>> levels;
+
+	// the dimensions are needed to know which levels fit, so peek at the header first
+	unsigned int firstLevel = 0;
+	if (maxSize > 0 &&
+		readCacheHeader(key, header)) {
+		while (firstLevel + 1 < header.levels &&
+			   std::max(header.width >> firstLevel, header.height >> firstLevel) > maxSize)
+			++firstLevel;
+	}
+
+	if (readCache(key, header, levels, firstLevel) == false) {
+		int x = 0, y = 0, comp = 0;
+		unsigned char* pixels = stbi_load(filename, &x, &y, &comp, STBI_rgb_alpha);
+		if (pixels == nullptr)
+			return false;
+
+		// the base level has to be made of whole blocks
+		if (x % 4 != 0 || y % 4 != 0) {
+			stbi_image_free(pixels);
+			return load(filename, content);
+		}
+
+		MipChain mips;
+		mips.generate(pixels, x, y, 4, content == COLOUR);
+		stbi_image_free(pixels);
+		checkMips(mips, filename);
+
+		header.magic = TEXTURE_CACHE_MAGIC;
+		header.format = content == NORMALS ? BC5 : (comp == STBI_grey_alpha || comp == STBI_rgb_alpha) ? BC3 : BC1;
+		header.width = (unsigned int)x;
+		header.height = (unsigned int)y;
+		header.levels = mips.getLevelCount();
+		header.key = key;
+
+		levels.resize(header.levels);
+		for (unsigned int level = 0; level < header.levels; ++level)
+			compressImage(mips.getLevel(level).data(), mips.getLevelWidth(level), mips.getLevelHeight(level),
+						  (Format)header.format, levels[level]);
+
+		writeCache(header, levels);
+
+		while (maxSize > 0 &&
+			   firstLevel + 1 < header.levels &&
+			   std::max(header.width >> firstLevel, header.height >> firstLevel) > maxSize)
+			++firstLevel;
+	}
+
+	upload(header.format, header.width, header.height, levels, firstLevel);
+
+	m_cacheKey = key;
+	m_minResidentLevel = 0;
+	m_maxResidentLevel = firstLevel;
+
+	m_filename = filename;
+	return true;
+}
+
+void Texture::upload(unsigned int format, unsigned int width, unsigned int height,
+					 const std::vector<std::vector<unsigned char>>& levels, unsigned int firstLevel /* = 0 */) {
+
+	initialise(format, width, height, (unsigned int)levels.size(), firstLevel);
+	uploadLevels(firstLevel, m_levelCount, levels, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void Texture::initialise(unsigned int format, unsigned int width, unsigned int height,
+						 unsigned int levelCount, unsigned int firstLevel /* = 0 */) {
+
+	if (m_glHandle != 0)
+		m_glHandle.reset();
+	if (m_loadedPixels != nullptr) {
+		stbi_image_free(m_loadedPixels);
+		m_loadedPixels = nullptr;
+	}
+
+	m_width = width;
+	m_height = height;
+	m_format = format;
+	m_levelCount = levelCount;
+	m_residentLevel = firstLevel;
+	m_minResidentLevel = 0;
+	m_maxResidentLevel = firstLevel;
+	m_cacheKey = 0;
+
+	allocateStorage(firstLevel);
+}
+
+// the gl formats for a texture format
+static void getGLFormat(unsigned int format, unsigned int& internalFormat, unsigned int& pixelFormat, bool& compressed) {
+	internalFormat = GL_RGBA8;
+	pixelFormat = GL_RGBA;
+	compressed = false;
+	switch (format) {
+	case Texture::RED:	internalFormat = GL_R8;		pixelFormat = GL_RED;	break;
+	case Texture::RG:	internalFormat = GL_RG8;	pixelFormat = GL_RG;	break;
+	case Texture::RGB:	internalFormat = GL_RGB8;	pixelFormat = GL_RGB;	break;
+	case Texture::BC1:	internalFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;	compressed = true;	break;
+	case Texture::BC3:	internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;	compressed = true;	break;
+	case Texture::BC5:	internalFormat = GL_COMPRESSED_RG_RGTC2;			compressed = true;	break;
+	default:	break;
+	};
+}
+
+void Texture::allocateStorage(unsigned int firstLevel) {
+	unsigned int internalFormat = 0, pixelFormat = 0;
+	bool compressed = false;
+	getGLFormat(m_format, internalFormat, pixelFormat, compressed);
+
+	glGenTextures(1, m_glHandle.put());
+	glBindTexture(GL_TEXTURE_2D, m_glHandle);
+
+	// every resident level is allocated up front, rather than the driver guessing as each arrives
+	glTexStorage2D(GL_TEXTURE_2D, (int)(m_levelCount - firstLevel), internalFormat,
+				   std::max(m_width >> firstLevel, 1u), std::max(m_height >> firstLevel, 1u));
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+
+	m_memorySize = 0;
+	for (unsigned int level = firstLevel; level < m_levelCount; ++level)
+		m_memorySize += getLevelSize(level);
+}
+
+void Texture::uploadLevels(unsigned int first, unsigned int last,
+						   const std::vector<std::vector<unsigned char>>& levels, unsigned int levelsFirst) {
+
+	// rows of small rgb mips aren't 4 byte aligned
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	for (unsigned int level = first; level < last; ++level) {
+		const std::vector<unsigned char>& pixels = levels[level - levelsFirst];
+		uploadRows(level, 0, getLevelRows(level), pixels.data(), (unsigned int)pixels.size());
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+void Texture::uploadRows(unsigned int level, unsigned int firstRow, unsigned int rowCount,
+						 const void* pixels, unsigned int size) {
+	unsigned int internalFormat = 0, pixelFormat = 0;
+	bool compressed = false;
+	getGLFormat(m_format, internalFormat, pixelFormat, compressed);
+
+	unsigned int levelWidth = std::max(m_width >> level, 1u);
+	unsigned int levelHeight = std::max(m_height >> level, 1u);
+
+	// storage starts at the resident level
+	if (compressed) {
+		unsigned int y = firstRow * 4;
+		unsigned int height = std::min(rowCount * 4, levelHeight - y);
+		glCompressedTexSubImage2D(GL_TEXTURE_2D, level - m_residentLevel, 0, y, levelWidth, height, internalFormat,
+								  (int)size, pixels);
+	}
+	else {
+		glTexSubImage2D(GL_TEXTURE_2D, level - m_residentLevel, 0, firstRow, levelWidth, rowCount, pixelFormat,
+						GL_UNSIGNED_BYTE, pixels);
+	}
+}
+
+unsigned int Texture::getLevelRows(unsigned int level) const {
+	unsigned int height = std::max(m_height >> level, 1u);
+	return m_format >= BC1 ? (height + 3) / 4 : height;
+}
+
+unsigned int Texture::getLevelSize(unsigned int level) const {
+	unsigned int width = std::max(m_width >> level, 1u);
+	unsigned int height = std::max(m_height >> level, 1u);
+
+	switch (m_format) {
+	case BC1:	return ((width + 3) / 4) * ((height + 3) / 4) * 8;
+	case BC3:
+	case BC5:	return ((width + 3) / 4) * ((height + 3) / 4) * 16;
+
+	// drivers pad rgb out to rgba
+	case RGB:	return width * height * 4;
+	default:	return width * height * m_format;
+	};
+}
+
+void Texture::setResidentLevelRange(unsigned int minLevel, unsigned int maxLevel) {
+	assert(minLevel <= maxLevel);
+	m_minResidentLevel = std::min(minLevel, m_levelCount > 0 ? m_levelCount - 1 : 0);
+	m_maxResidentLevel = std::min(maxLevel, m_levelCount > 0 ? m_levelCount - 1 : 0);
+}
+
+bool Texture::readCachedLevels(unsigned long long key, unsigned int first, unsigned int last,
+							   std::vector<std::vector<unsigned char>>& levels) {
+	TextureCacheHeader header = {};
+	std::vector<std::vector<unsigned char>> cached;
+	if (readCache(key, header, cached, first) == false ||
+		last > header.levels)
+		return false;
+
+	levels.resize(last - first);
+	for (unsigned int level = first; level < last; ++level)
+		levels[level - first].swap(cached[level]);
+	return true;
+}
+
+void Texture::setResidentLevel(unsigned int level, const std::vector<std::vector<unsigned char>>& levels) {
+	assert(m_levelCount > 0 && level < m_levelCount);
+	if (level == m_residentLevel)
+		return;
+
+	assert(level > m_residentLevel || levels.size() == m_residentLevel - level);
+
+	// the old texture is kept until its levels are copied across, then released through the deletion queue
+	TextureHandle previous = std::move(m_glHandle);
+	unsigned int previousLevel = m_residentLevel;
+
+	allocateStorage(level);
+
+	// copy the levels both textures hold, these are whole levels so compressed blocks line up
+	for (unsigned int copy = std::max(level, previousLevel); copy < m_levelCount; ++copy) {
+		unsigned int width = std::max(m_width >> copy, 1u);
+		unsigned int height = std::max(m_height >> copy, 1u);
+		glCopyImageSubData(previous, GL_TEXTURE_2D, copy - previousLevel, 0, 0, 0,
+						   m_glHandle, GL_TEXTURE_2D, copy - level, 0, 0, 0,
+						   width, height, 1);
+	}
+
+	m_residentLevel = level;
+	if (level < previousLevel)
+		uploadLevels(level, previousLevel, levels, level);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
 }
 
 void Texture::create(unsigned int width, unsigned int height, Format format, unsigned char* pixels) {
 
+	cancelUpload();
+	m_loadFailed = false;
+
 	if (m_glHandle != 0) {
-		glDeleteTextures(1, &m_glHandle);
-		m_glHandle = 0;
+		m_glHandle.reset();
 		m_filename = "none";
 	}
 
 	m_width = width;
 	m_height = height;
 	m_format = format;
+	m_memorySize = width * height * (format == RGB ? 4 : format);
+	m_levelCount = 1;
+	m_residentLevel = 0;
+	m_minResidentLevel = 0;
+	m_maxResidentLevel = 0;
+	m_cacheKey = 0;
 
-	glGenTextures(1, &m_glHandle);
+	// the storage is made now, so the handle can be used straight away, and the pixels follow
+	TextureUploader* uploader = TextureUploader::getInstance();
+	unsigned char* initialPixels = uploader != nullptr ? nullptr : pixels;
+
+	glGenTextures(1, m_glHandle.put());
 	glBindTexture(GL_TEXTURE_2D, m_glHandle);
 
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -117,20 +683,30 @@ void Texture::create(unsigned int width, unsigned int height, Format format, uns
 
 	switch (m_format) {
 	case RED:
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, m_width, m_height, 0, GL_RED, GL_UNSIGNED_BYTE, pixels);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, m_width, m_height, 0, GL_RED, GL_UNSIGNED_BYTE, initialPixels);
 		break;
 	case RG:
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RG, m_width, m_height, 0, GL_RG, GL_UNSIGNED_BYTE, pixels);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RG, m_width, m_height, 0, GL_RG, GL_UNSIGNED_BYTE, initialPixels);
 		break;
 	case RGB:
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, m_width, m_height, 0, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, m_width, m_height, 0, GL_RGB, GL_UNSIGNED_BYTE, initialPixels);
 		break;
 	case RGBA:
 	default:
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_width, m_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_width, m_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, initialPixels);
 	};
 
 	glBindTexture(GL_TEXTURE_2D, 0);
+
+	if (initialPixels != pixels)
+		uploader->upload(this, pixels, m_width * m_height * m_format);
+}
+
+void Texture::cancelUpload() {
+	if (m_uploadID != 0 &&
+		TextureUploader::getInstance() != nullptr)
+		TextureUploader::getInstance()->cancel(this);
+	m_uploadID = 0;
 }
 
 void Texture::bind(unsigned int slot) const {
@@ -1,9 +1,13 @@
 #pragma once
 
+#include "GLHandle.h"
 #include <string>
+#include <vector>
 
 namespace aie {
 
+class TextureUploader;
+
 // a class for wrapping up an opengl texture image
 class Texture {
 public:
@@ -12,7 +16,21 @@ public:
 		RED	= 1,
 		RG,
 		RGB,
-		RGBA
+		RGBA,
+
+		// block compressed, from loadCompressed()
+		BC1,	// rgb
+		BC3,	// rgba
+		BC5,	// rg, for normal maps
+	};
+
+	// what an image holds, which decides how its mips are filtered. colours are stored gamma
+	// encoded so are averaged in linear space, while data such as specular, alpha or height maps
+	// is averaged as stored. normal maps are also compressed to just x and y
+	enum Content : unsigned int {
+		COLOUR = 0,
+		DATA,
+		NORMALS,
 	};
 
 	Texture();
@@ -20,12 +38,36 @@ public:
 	Texture(unsigned int width, unsigned int height, Format format, unsigned char* pixels = nullptr);
 	virtual ~Texture();
 
-	// load a jpg, bmp, png or tga
-	bool load(const char* filename);
+	// textures can be moved but not copied, as only one can own the opengl texture
+	Texture(const Texture&) = delete;
+	Texture& operator = (const Texture&) = delete;
+	Texture(Texture&& other) noexcept;
+	Texture& operator = (Texture&& other) noexcept;
 
-	// creates a texture that can be filled in with pixels
+	// load a jpg, bmp, png or tga. mips are made on the cpu, gamma correct for colour images, and
+	// cached on disk along with the image, so later loads skip decoding it. if the Application has
+	// made a TextureUploader the image is decoded on its threads and streamed in over the following
+	// frames, the texture keeping what it had until then, and only fails straight away if there is
+	// no such file. isLoading() and hasLoadFailed() tell how it went
+	bool load(const char* filename, Content content = COLOUR);
+
+	// loads the image block compressed with all of its mips, BC1 for rgb, BC3 with alpha and BC5 for
+	// normal maps, which keep only x and y. cached like load(), and falls back to it for images that
+	// aren't a multiple of 4 in size. compressed textures don't keep their pixels.
+	// if a maximum size is given only the mips that fit in it are loaded, and a TextureStreamer
+	// can bring in the rest from the cache as they are needed
+	bool loadCompressed(const char* filename, Content content = COLOUR, unsigned int maxSize = 0);
+
+	// creates a texture that can be filled in with pixels. the storage is made straight away, while any
+	// pixels given are copied and go up through the TextureUploader if there is one
 	void create(unsigned int width, unsigned int height, Format format, unsigned char* pixels = nullptr);
 
+	// true until an image or pixels queued on the TextureUploader are all on the gpu
+	bool isLoading() const { return m_uploadID != 0; }
+
+	// true if the last image queued on the TextureUploader couldn't be decoded
+	bool hasLoadFailed() const { return m_loadFailed; }
+
 	// returns the filename or "none" if not loaded from a file
 	const std::string& getFilename() const { return m_filename; }
 
@@ -40,14 +82,91 @@ public:
 	unsigned int getFormat() const { return m_format; }
 	const unsigned char* getPixels() const { return m_loadedPixels; }
 
+	// bytes the texture takes in video memory, including mips
+	unsigned int getMemorySize() const { return m_memorySize; }
+
+	// mips in the full chain, and the most detailed one currently in video memory
+	unsigned int getLevelCount() const { return m_levelCount; }
+	unsigned int getResidentLevel() const { return m_residentLevel; }
+
+	// bytes a single mip of the full chain takes
+	unsigned int getLevelSize(unsigned int level) const;
+
+	// limits the levels a TextureStreamer keeps resident. the minimum is the most detailed
+	// level it may stream in, the maximum the least detailed it may drop down to.
+	// loadCompressed() sets them to the whole chain and to the level it loaded
+	void setResidentLevelRange(unsigned int minLevel, unsigned int maxLevel);
+	unsigned int getMinResidentLevel() const { return m_minResidentLevel; }
+	unsigned int getMaxResidentLevel() const { return m_maxResidentLevel; }
+
+	// identifies the texture's mips in the cache, or 0 if it can't be streamed
+	unsigned long long getCacheKey() const { return m_cacheKey; }
+
+	// reads levels [first, last) from the cache. doesn't touch any texture, so is safe to call from any thread
+	static bool readCachedLevels(unsigned long long key, unsigned int first, unsigned int last,
+								 std::vector<std::vector<unsigned char>>& levels);
+
+	// makes the level the most detailed one resident, either adding the more detailed levels given,
+	// as read by readCachedLevels() from the level up to the resident one, or dropping levels.
+	// the texture is reallocated, so its handle changes
+	void setResidentLevel(unsigned int level, const std::vector<std::vector<unsigned char>>& levels);
+
 protected:
 
+	friend class TextureUploader;
+
+	// drops anything queued for the texture on the TextureUploader
+	void cancelUpload();
+
+	// reads the image and its mips from the cache, or decodes it and fills in the cache.
+	// doesn't touch any texture or opengl, so is safe to call from any thread
+	static bool decode(const char* filename, Content content, unsigned int& format, unsigned int& width,
+					   unsigned int& height, std::vector<std::vector<unsigned char>>& levels);
+
+	// releases the texture and creates immutable storage for the mips from the first level down,
+	// leaving it bound for the levels to be uploaded
+	void initialise(unsigned int format, unsigned int width, unsigned int height,
+					unsigned int levelCount, unsigned int firstLevel = 0);
+
+	// uploads rows of a level in to the bound storage, or rows of blocks for compressed formats.
+	// pixels is an offset in to the buffer if one is bound to GL_PIXEL_UNPACK_BUFFER
+	void uploadRows(unsigned int level, unsigned int firstRow, unsigned int rowCount,
+					const void* pixels, unsigned int size);
+
+	// the rows uploadRows() takes for a level, a row of blocks for compressed formats
+	unsigned int getLevelRows(unsigned int level) const;
+
+	// creates immutable storage for the mips from the first level down and uploads them,
+	// the levels are in the format's layout and those before the first are ignored
+	void upload(unsigned int format, unsigned int width, unsigned int height,
+				const std::vector<std::vector<unsigned char>>& levels, unsigned int firstLevel = 0);
+
+	// creates and binds storage for the levels from the first down
+	void allocateStorage(unsigned int firstLevel);
+
+	// uploads levels [first, last) in to the bound storage, which starts at the resident level.
+	// levels[0] holds level levelsFirst of the chain
+	void uploadLevels(unsigned int first, unsigned int last,
+					  const std::vector<std::vector<unsigned char>>& levels, unsigned int levelsFirst);
+
 	std::string		m_filename;
 	unsigned int	m_width;
 	unsigned int	m_height;
-	unsigned int	m_glHandle;
+	TextureHandle	m_glHandle;
 	unsigned int	m_format;
 	unsigned char*	m_loadedPixels;
+	unsigned int	m_memorySize;
+
+	unsigned int	m_levelCount;
+	unsigned int	m_residentLevel;
+	unsigned int	m_minResidentLevel;
+	unsigned int	m_maxResidentLevel;
+
+	unsigned long long	m_cacheKey;
+
+	// the TextureUploader's current upload in to the texture, 0 if there isn't one
+	unsigned int	m_uploadID;
+	bool			m_loadFailed;
 };
 
 } // namespace aie
\ No newline at end of file
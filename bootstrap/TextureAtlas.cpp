@@ -0,0 +1,124 @@
+#include "gl_core_4_4.h"
+#include "TextureAtlas.h"
+#include "Texture.h"
+#include "TextureUploader.h"
+#include <algorithm>
+#include <cstring>
+#include <stb_image.h>
+
+#define STBRP_STATIC
+#define STB_RECT_PACK_IMPLEMENTATION
+#include <stb_rect_pack.h>
+
+namespace aie {
+
+TextureAtlas::TextureAtlas(unsigned int pageWidth /* = 2048 */, unsigned int pageHeight /* = 2048 */, unsigned int padding /* = 2 */)
+	: m_pageWidth(pageWidth),
+	m_pageHeight(pageHeight),
+	m_padding(padding) {
+}
+
+TextureAtlas::~TextureAtlas() {
+}
+
+const TextureRegion* TextureAtlas::add(const char* filename) {
+	const TextureRegion* region = find(filename);
+	if (region != nullptr)
+		return region;
+
+	int x = 0, y = 0, comp = 0;
+	unsigned char* pixels = stbi_load(filename, &x, &y, &comp, STBI_rgb_alpha);
+	if (pixels == nullptr)
+		return nullptr;
+
+	region = add(filename, pixels, x, y);
+	stbi_image_free(pixels);
+	return region;
+}
+
+const TextureRegion* TextureAtlas::add(const char* name, const unsigned char* pixels, unsigned int width, unsigned int height) {
+	unsigned int paddedWidth = width + m_padding * 2;
+	unsigned int paddedHeight = height + m_padding * 2;
+
+	Page* page = nullptr;
+	unsigned int x = 0, y = 0;
+	if (pack(paddedWidth, paddedHeight, page, x, y) == false)
+		return nullptr;
+
+	// extrude the edges out in to the padding, clamping each texel back inside the image
+	std::vector<unsigned char> padded(paddedWidth * paddedHeight * 4);
+	for (unsigned int row = 0; row < paddedHeight; ++row) {
+		unsigned int sourceRow = (unsigned int)std::min(std::max((int)row - (int)m_padding, 0), (int)height - 1);
+		for (unsigned int column = 0; column < paddedWidth; ++column) {
+			unsigned int sourceColumn = (unsigned int)std::min(std::max((int)column - (int)m_padding, 0), (int)width - 1);
+			memcpy(&padded[(row * paddedWidth + column) * 4], &pixels[(sourceRow * width + sourceColumn) * 4], 4);
+		}
+	}
+
+	TextureUploader::uploadRegion(page->texture->getHandle(), 4, x, y, paddedWidth, paddedHeight, padded.data(), paddedWidth);
+
+	TextureRegion region;
+	region.texture = page->texture.get();
+	region.uvX = (x + m_padding) / (float)m_pageWidth;
+	region.uvY = (y + m_padding) / (float)m_pageHeight;
+	region.uvW = width / (float)m_pageWidth;
+	region.uvH = height / (float)m_pageHeight;
+	region.width = width;
+	region.height = height;
+
+	m_regions.push_back(region);
+	m_names[name] = &m_regions.back();
+	return &m_regions.back();
+}
+
+const TextureRegion* TextureAtlas::find(const char* name) const {
+	auto iter = m_names.find(name);
+	return iter != m_names.end() ? iter->second : nullptr;
+}
+
+bool TextureAtlas::pack(unsigned int width, unsigned int height, Page*& page, unsigned int& x, unsigned int& y) {
+	if (width > m_pageWidth ||
+		height > m_pageHeight)
+		return false;
+
+	stbrp_rect rect = {};
+	rect.w = (stbrp_coord)width;
+	rect.h = (stbrp_coord)height;
+
+	// earlier pages are tried first so that they fill up before a new one is bound
+	for (auto& existing : m_pages) {
+		stbrp_pack_rects(existing->context.get(), &rect, 1);
+		if (rect.was_packed) {
+			page = existing.get();
+			x = rect.x;
+			y = rect.y;
+			return true;
+		}
+	}
+
+	std::unique_ptr<Page> created(new Page());
+	created->texture.reset(new Texture(m_pageWidth, m_pageHeight, Texture::RGBA));
+	created->context.reset(new stbrp_context());
+	created->nodes.resize(m_pageWidth);
+	stbrp_init_target(created->context.get(), m_pageWidth, m_pageHeight, created->nodes.data(), (int)created->nodes.size());
+
+	// sprites are often scaled, which the padding is there for
+	glBindTexture(GL_TEXTURE_2D, created->texture->getHandle());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	stbrp_pack_rects(created->context.get(), &rect, 1);
+	if (rect.was_packed == 0)
+		return false;
+
+	page = created.get();
+	x = rect.x;
+	y = rect.y;
+	m_pages.push_back(std::move(created));
+	return true;
+}
+
+} // namespace aie
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct stbrp_context;
+struct stbrp_node;
+
+namespace aie {
+
+class Texture;
+
+// where an image was packed in a TextureAtlas, with its texture coordinates in the page
+struct TextureRegion {
+	Texture*		texture;
+	float			uvX, uvY, uvW, uvH;
+	unsigned int	width, height;
+};
+
+// packs many small sprite images in to a few large textures, so that a Renderer2D batch drawing them
+// binds one texture per page rather than one per sprite and never has to flush for running out of
+// texture slots. each image is surrounded by a copy of its edge pixels so filtering doesn't bleed
+// in its neighbours
+class TextureAtlas {
+public:
+
+	TextureAtlas(unsigned int pageWidth = 2048, unsigned int pageHeight = 2048, unsigned int padding = 2);
+	~TextureAtlas();
+
+	TextureAtlas(const TextureAtlas&) = delete;
+	TextureAtlas& operator = (const TextureAtlas&) = delete;
+
+	// loads an image in to the atlas, or returns the region it was already packed in to.
+	// returns nullptr if it can't be loaded or won't fit on a page
+	const TextureRegion* add(const char* filename);
+
+	// packs rgba pixels in to the atlas, under a name that find() can look up
+	const TextureRegion* add(const char* name, const unsigned char* pixels, unsigned int width, unsigned int height);
+
+	// the region an image was packed in to, or nullptr if it hasn't been
+	const TextureRegion* find(const char* name) const;
+
+	unsigned int getPageCount() const { return (unsigned int)m_pages.size(); }
+	unsigned int getRegionCount() const { return (unsigned int)m_regions.size(); }
+
+private:
+
+	struct Page {
+		std::unique_ptr<Texture>		texture;
+		std::unique_ptr<stbrp_context>	context;
+		std::vector<stbrp_node>			nodes;
+	};
+
+	// packs a rectangle of the size on to a page, starting a new page if none have room
+	bool pack(unsigned int width, unsigned int height, Page*& page, unsigned int& x, unsigned int& y);
+
+	unsigned int	m_pageWidth;
+	unsigned int	m_pageHeight;
+	unsigned int	m_padding;
+
+	// pages and regions are handed out by pointer, so neither can move
+	std::vector<std::unique_ptr<Page>>			m_pages;
+	std::deque<TextureRegion>					m_regions;
+	std::unordered_map<std::string, TextureRegion*>	m_names;
+};
+
+} // namespace aie
@@ -0,0 +1,195 @@
+#include "TextureStreamer.h"
+#include "Texture.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace aie {
+
+TextureStreamer::TextureStreamer(unsigned int budget, unsigned int startSize /* = 64 */)
+	: m_budget(budget),
+	m_startSize(startSize),
+	m_residentSize(0),
+	m_pendingSize(0),
+	m_pendingCount(0),
+	m_starvedCount(0),
+	m_quit(false) {
+
+	m_thread = std::thread(&TextureStreamer::run, this);
+}
+
+TextureStreamer::~TextureStreamer() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+	m_wake.notify_one();
+	m_thread.join();
+}
+
+void TextureStreamer::add(Texture* texture) {
+	assert(texture != nullptr);
+	if (texture->getCacheKey() == 0 ||
+		find(texture) != nullptr)
+		return;
+
+	Entry entry;
+	entry.texture = texture;
+	entry.requested = texture->getMaxResidentLevel();
+	entry.loading = false;
+	m_entries.push_back(entry);
+}
+
+void TextureStreamer::remove(Texture* texture) {
+	m_entries.erase(std::remove_if(m_entries.begin(), m_entries.end(),
+								   [texture](const Entry& entry) { return entry.texture == texture; }),
+					m_entries.end());
+
+	// anything in flight for it is thrown away once finished, as it no longer has an entry
+}
+
+void TextureStreamer::request(const Texture* texture, unsigned int level) {
+	Entry* entry = find(texture);
+	if (entry != nullptr)
+		entry->requested = std::min(entry->requested, level);
+}
+
+unsigned int TextureStreamer::getLevelForCoverage(const Texture& texture, float screenSize) {
+	float size = (float)std::max(texture.getWidth(), texture.getHeight());
+	if (size <= screenSize)
+		return 0;
+
+	unsigned int level = (unsigned int)log2f(size / std::max(screenSize, 1.0f));
+	return std::min(level, texture.getLevelCount() - 1);
+}
+
+TextureStreamer::Entry* TextureStreamer::find(const Texture* texture) {
+	for (auto& entry : m_entries)
+		if (entry.texture == texture)
+			return &entry;
+	return nullptr;
+}
+
+void TextureStreamer::update() {
+
+	// upload whatever the thread has finished
+	std::deque<Load> finished;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		finished.swap(m_finished);
+	}
+
+	for (auto& load : finished) {
+		m_pendingSize -= load.size;
+		m_pendingCount--;
+
+		Entry* entry = find(load.texture);
+		if (entry == nullptr)
+			continue;
+
+		entry->loading = false;
+
+		// stop streaming a texture whose cache file has gone
+		if (load.succeeded == false) {
+			Texture* texture = entry->texture;
+			texture->setResidentLevelRange(texture->getResidentLevel(), texture->getResidentLevel());
+			continue;
+		}
+
+		// skip loads that no longer line up with what is resident
+		if (load.last == entry->texture->getResidentLevel())
+			entry->texture->setResidentLevel(load.first, load.levels);
+	}
+
+	// clamp each request to the texture's range, then drop levels that aren't needed
+	m_residentSize = 0;
+	for (auto& entry : m_entries) {
+		Texture* texture = entry.texture;
+		entry.requested = std::max(std::min(entry.requested, texture->getMaxResidentLevel()),
+								   texture->getMinResidentLevel());
+
+		if (entry.requested > texture->getResidentLevel() &&
+			entry.loading == false)
+			texture->setResidentLevel(entry.requested, std::vector<std::vector<unsigned char>>());
+
+		m_residentSize += texture->getMemorySize();
+	}
+
+	// the textures furthest from their request are loaded first
+	std::vector<Entry*> wanted;
+	for (auto& entry : m_entries)
+		if (entry.requested < entry.texture->getResidentLevel() &&
+			entry.loading == false)
+			wanted.push_back(&entry);
+
+	std::sort(wanted.begin(), wanted.end(), [](const Entry* a, const Entry* b) {
+		return a->texture->getResidentLevel() - a->requested > b->texture->getResidentLevel() - b->requested;
+	});
+
+	m_starvedCount = 0;
+	unsigned int committed = m_residentSize + m_pendingSize;
+	for (Entry* entry : wanted) {
+		Texture* texture = entry->texture;
+
+		// take as many of the levels as fit, working up from the resident level
+		unsigned int first = texture->getResidentLevel();
+		while (first > entry->requested &&
+			   committed + texture->getLevelSize(first - 1) <= m_budget) {
+			--first;
+			committed += texture->getLevelSize(first);
+		}
+
+		if (first != entry->requested)
+			m_starvedCount++;
+		if (first == texture->getResidentLevel())
+			continue;
+
+		Load load;
+		load.texture = texture;
+		load.key = texture->getCacheKey();
+		load.first = first;
+		load.last = texture->getResidentLevel();
+		load.size = 0;
+		load.succeeded = false;
+		for (unsigned int level = first; level < load.last; ++level)
+			load.size += texture->getLevelSize(level);
+
+		m_pendingSize += load.size;
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_queued.push_back(std::move(load));
+		}
+		m_wake.notify_one();
+
+		entry->loading = true;
+		m_pendingCount++;
+	}
+
+	// requests are made afresh every frame
+	for (auto& entry : m_entries)
+		entry.requested = entry.texture->getMaxResidentLevel();
+}
+
+void TextureStreamer::run() {
+	while (true) {
+		Load load;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [this]() { return m_quit || m_queued.empty() == false; });
+			if (m_quit)
+				return;
+
+			load = std::move(m_queued.front());
+			m_queued.pop_front();
+		}
+
+		// only reads the cache file, the texture itself is left to the main thread
+		load.succeeded = Texture::readCachedLevels(load.key, load.first, load.last, load.levels);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_finished.push_back(std::move(load));
+	}
+}
+
+} // namespace aie
\ No newline at end of file
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace aie {
+
+class Texture;
+
+// brings the detailed mips of textures in and out of video memory as they are needed, within
+// a budget. textures are loaded with just their small mips, then each frame the application
+// requests the level each texture needs from how large it appears on screen. the levels are
+// read from the texture cache on a background thread and uploaded in update()
+class TextureStreamer {
+public:
+
+	// textures are loaded with their mips up to the start size, the rest are streamed
+	TextureStreamer(unsigned int budget, unsigned int startSize = 64);
+	~TextureStreamer();
+
+	TextureStreamer(const TextureStreamer&) = delete;
+	TextureStreamer& operator = (const TextureStreamer&) = delete;
+
+	// the maximum size to give loadCompressed() for textures that will be streamed
+	unsigned int getStartSize() const { return m_startSize; }
+
+	// textures must have been loaded with loadCompressed() and a maximum size, and must be
+	// removed before they are destroyed or moved
+	void add(Texture* texture);
+	void remove(Texture* texture);
+
+	// asks for a level to be resident this frame, the most detailed requested wins.
+	// textures not requested in a frame can drop back to their maximum resident level
+	void request(const Texture* texture, unsigned int level);
+
+	// uploads loads that have finished, then drops unneeded levels and queues
+	// loads for needed ones that fit in the budget. call once a frame
+	void update();
+
+	// the level at which one texel of the texture covers about one pixel, given its size on screen in pixels
+	static unsigned int getLevelForCoverage(const Texture& texture, float screenSize);
+
+	unsigned int getBudget() const { return m_budget; }
+	void setBudget(unsigned int budget) { m_budget = budget; }
+
+	// bytes of video memory used by the streamed textures, and the loads still in flight
+	unsigned int getResidentSize() const { return m_residentSize; }
+	unsigned int getPendingCount() const { return m_pendingCount; }
+
+	// textures that were given fewer levels than requested because of the budget, last update
+	unsigned int getStarvedCount() const { return m_starvedCount; }
+
+private:
+
+	struct Entry {
+		Texture*		texture;
+		unsigned int	requested;
+		bool			loading;
+	};
+
+	// levels to read from the cache, first up to the texture's resident level
+	struct Load {
+		Texture*			texture;
+		unsigned long long	key;
+		unsigned int		first;
+		unsigned int		last;
+		unsigned int		size;
+		bool				succeeded;
+
+		std::vector<std::vector<unsigned char>>	levels;
+	};
+
+	Entry* find(const Texture* texture);
+
+	void run();
+
+	std::vector<Entry>		m_entries;
+
+	unsigned int			m_budget;
+	unsigned int			m_startSize;
+	unsigned int			m_residentSize;
+	unsigned int			m_pendingSize;
+	unsigned int			m_pendingCount;
+	unsigned int			m_starvedCount;
+
+	// loads waiting for the thread, and loads it has finished, guarded by the mutex
+	std::deque<Load>		m_queued;
+	std::deque<Load>		m_finished;
+	bool					m_quit;
+
+	std::mutex				m_mutex;
+	std::condition_variable	m_wake;
+	std::thread				m_thread;
+};
+
+} // namespace aie
\ No newline at end of file
@@ -0,0 +1,298 @@
+#include "gl_core_4_4.h"
+#include "TextureUploader.h"
+#include "Texture.h"
+#include "RingBuffer.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace aie {
+
+TextureUploader* TextureUploader::m_instance = nullptr;
+
+TextureUploader::TextureUploader(unsigned int frameBudget /* = 8 * 1024 * 1024 */, unsigned int bufferSize /* = 32 * 1024 * 1024 */)
+	: m_frameBudget(frameBudget),
+	m_uploadedSize(0),
+	m_failedCount(0),
+	m_stagingBuffer(nullptr),
+	m_nextID(1),
+	m_quit(false) {
+
+	m_stagingBuffer = new RingBuffer(bufferSize);
+
+	// mip generation already spreads large images over threads, so a couple of workers is plenty
+	unsigned int threadCount = std::max(std::min(std::thread::hardware_concurrency() / 2, 2u), 1u);
+	for (unsigned int i = 0; i < threadCount; ++i)
+		m_threads.emplace_back(&TextureUploader::run, this);
+}
+
+TextureUploader::~TextureUploader() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+	m_wake.notify_all();
+	for (auto& thread : m_threads)
+		thread.join();
+
+	for (auto& job : m_fenced)
+		glDeleteSync(job.sync);
+
+	// textures still loading keep what arrived, but nothing more will
+	for (auto& target : m_targets)
+		target.second->m_uploadID = 0;
+
+	delete m_stagingBuffer;
+}
+
+TextureUploader::Job TextureUploader::makeJob(Texture* texture) {
+	assert(texture != nullptr);
+
+	// a newer upload replaces the texture's current one, which is dropped when next seen
+	cancel(texture);
+
+	Job job;
+	job.id = m_nextID++;
+	job.content = 0;
+	job.succeeded = false;
+	job.format = job.width = job.height = 0;
+	job.started = false;
+	job.level = 0;
+	job.row = 0;
+	job.sync = nullptr;
+
+	m_targets[job.id] = texture;
+	texture->m_uploadID = job.id;
+	texture->m_loadFailed = false;
+	return job;
+}
+
+void TextureUploader::load(Texture* texture, const char* filename, unsigned int content) {
+	Job job = makeJob(texture);
+	job.filename = filename;
+	job.content = content;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_queued.push_back(std::move(job));
+	}
+	m_wake.notify_one();
+}
+
+void TextureUploader::upload(Texture* texture, const unsigned char* pixels, unsigned int size) {
+	assert(texture->getHandle() != 0);
+
+	// nothing to decode, so it goes straight to the gl thread's queue
+	Job job = makeJob(texture);
+	job.succeeded = true;
+	job.format = texture->getFormat();
+	job.width = texture->getWidth();
+	job.height = texture->getHeight();
+	job.levels.emplace_back(pixels, pixels + size);
+	job.started = true;
+
+	m_uploading.push_back(std::move(job));
+}
+
+void TextureUploader::uploadRegion(unsigned int texture, unsigned int channels, unsigned int x, unsigned int y,
+								   unsigned int width, unsigned int height, const unsigned char* pixels, unsigned int rowLength) {
+	assert(channels >= 1 && channels <= 4);
+	const unsigned int formats[] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	if (m_instance != nullptr) {
+
+		// the rows are packed together in the ring, and the gpu copies them in from there
+		unsigned int rowSize = width * channels;
+		unsigned int offset = 0;
+		unsigned char* staging = (unsigned char*)m_instance->m_stagingBuffer->allocate(rowSize * height, 16, offset);
+		for (unsigned int row = 0; row < height; ++row)
+			memcpy(staging + row * rowSize, pixels + row * rowLength * channels, rowSize);
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_instance->m_stagingBuffer->getHandle());
+		glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, formats[channels - 1], GL_UNSIGNED_BYTE,
+						(void*)(size_t)offset);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+		m_instance->m_stagingBuffer->fence();
+	}
+	else {
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, rowLength);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, formats[channels - 1], GL_UNSIGNED_BYTE, pixels);
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void TextureUploader::cancel(Texture* texture) {
+	if (texture->m_uploadID == 0)
+		return;
+
+	// its jobs are thrown away when they are next seen, as they no longer have a target
+	m_targets.erase(texture->m_uploadID);
+	texture->m_uploadID = 0;
+}
+
+void TextureUploader::retarget(unsigned int id, Texture* texture) {
+	auto iter = m_targets.find(id);
+	if (iter != m_targets.end())
+		iter->second = texture;
+}
+
+Texture* TextureUploader::getTarget(const Job& job) const {
+	auto iter = m_targets.find(job.id);
+	return iter != m_targets.end() ? iter->second : nullptr;
+}
+
+void TextureUploader::update() {
+
+	// fences pass in the order they were made, so stop at the first the gpu hasn't reached
+	while (m_fenced.empty() == false) {
+		Job& job = m_fenced.front();
+		if (glClientWaitSync(job.sync, GL_SYNC_FLUSH_COMMANDS_BIT, 0) == GL_TIMEOUT_EXPIRED)
+			break;
+		glDeleteSync(job.sync);
+
+		Texture* texture = getTarget(job);
+		if (texture != nullptr) {
+			texture->m_uploadID = 0;
+			m_targets.erase(job.id);
+		}
+		m_fenced.pop_front();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		while (m_decoded.empty() == false) {
+			m_uploading.push_back(std::move(m_decoded.front()));
+			m_decoded.pop_front();
+		}
+	}
+
+	m_uploadedSize = 0;
+	unsigned int budget = m_frameBudget;
+
+	// the gl calls source their pixels from the ring rather than from client memory
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_stagingBuffer->getHandle());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	while (m_uploading.empty() == false &&
+		   budget > 0) {
+		Job& job = m_uploading.front();
+		Texture* texture = getTarget(job);
+
+		if (texture != nullptr &&
+			job.succeeded == false) {
+			printf("Failed to load texture [%s]!\n", job.filename.c_str());
+			texture->m_uploadID = 0;
+			texture->m_loadFailed = true;
+			m_targets.erase(job.id);
+			m_failedCount++;
+		}
+		else if (texture != nullptr) {
+			if (upload(job, *texture, budget) == false)
+				break;
+
+			// the texture is only done once the gpu has read every row out of the ring
+			job.sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			m_fenced.push_back(std::move(job));
+		}
+
+		m_uploading.pop_front();
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	m_stagingBuffer->fence();
+}
+
+bool TextureUploader::upload(Job& job, Texture& texture, unsigned int& budget) {
+
+	// a decoded image's storage is made when its first rows go up, pixels given to upload()
+	// go in to the texture's existing storage
+	if (job.started == false) {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		texture.initialise(job.format, job.width, job.height, (unsigned int)job.levels.size());
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_stagingBuffer->getHandle());
+		job.started = true;
+		job.level = (unsigned int)job.levels.size() - 1;
+	}
+	else {
+		glBindTexture(GL_TEXTURE_2D, texture.getHandle());
+	}
+
+	while (budget > 0) {
+		const std::vector<unsigned char>& pixels = job.levels[job.level];
+		unsigned int rows = texture.getLevelRows(job.level);
+		unsigned int rowSize = (unsigned int)pixels.size() / rows;
+
+		// at least one row goes up each time so that a tiny budget still makes progress,
+		// and no more than half the ring so that the gpu can be reading the other half
+		unsigned int count = std::min(std::max(budget / rowSize, 1u), rows - job.row);
+		count = std::max(std::min(count, m_stagingBuffer->getSize() / 2 / rowSize), 1u);
+
+		unsigned int offset = 0;
+		void* staging = m_stagingBuffer->allocate(count * rowSize, 16, offset);
+		memcpy(staging, pixels.data() + job.row * rowSize, count * rowSize);
+		texture.uploadRows(job.level, job.row, count, (void*)(size_t)offset, count * rowSize);
+
+		m_uploadedSize += count * rowSize;
+		budget -= std::min(budget, count * rowSize);
+		job.row += count;
+
+		if (job.row < rows)
+			continue;
+
+		// every row of the level has been issued, so sampling can start using it. until the smallest
+		// level's single row is in nothing has been drawn with the storage, as it was made this call
+		if (job.levels.size() > 1)
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, (int)job.level);
+
+		if (job.level == 0) {
+
+			// keep a loaded image's base level, as Texture::load() does
+			if (job.filename.empty() == false) {
+				texture.m_loadedPixels = (unsigned char*)malloc(job.levels[0].size());
+				memcpy(texture.m_loadedPixels, job.levels[0].data(), job.levels[0].size());
+				texture.m_filename = job.filename;
+			}
+			return true;
+		}
+
+		job.level--;
+		job.row = 0;
+	}
+
+	return false;
+}
+
+void TextureUploader::run() {
+	while (true) {
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [this]() { return m_quit || m_queued.empty() == false; });
+			if (m_quit)
+				return;
+
+			job = std::move(m_queued.front());
+			m_queued.pop_front();
+		}
+
+		job.succeeded = Texture::decode(job.filename.c_str(), (Texture::Content)job.content, job.format, job.width,
+										job.height, job.levels);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_decoded.push_back(std::move(job));
+	}
+}
+
+} // namespace aie
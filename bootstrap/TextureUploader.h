@@ -0,0 +1,140 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+typedef struct __GLsync *GLsync;
+
+namespace aie {
+
+class Texture;
+class RingBuffer;
+
+// loads textures without stalling the frame. images are decoded and their mips made on worker threads,
+// then update() copies them a few rows at a time in to a persistently mapped pixel unpack buffer
+// and has the gpu copy them in to the texture from there, so large images are spread over several
+// frames. the ring's fences keep its space from being reused until the gpu has read it, and each
+// texture has its own fence so that it only stops loading once the gpu has all of it.
+// Texture::load() and Texture::create() go through it whenever the Application has made one
+class TextureUploader {
+public:
+
+	static TextureUploader* getInstance() { return m_instance; }
+
+	// queues an image to be loaded in to the texture, replacing anything queued for it before.
+	// content is a Texture::Content. Texture::load() calls this
+	void load(Texture* texture, const char* filename, unsigned int content);
+
+	// queues pixels to be uploaded in to the base level of the texture's storage, which must already
+	// exist, replacing anything queued for it before. the pixels are copied. Texture::create() calls this
+	void upload(Texture* texture, const unsigned char* pixels, unsigned int size);
+
+	// copies a rectangle of an 8-bit image with 1 to 4 channels in to level 0 of a texture straight away,
+	// rows being rowLength pixels apart. it is staged through the uploader's ring if there is one,
+	// so that the driver doesn't have to copy it out of client memory first
+	static void uploadRegion(unsigned int texture, unsigned int channels, unsigned int x, unsigned int y,
+							 unsigned int width, unsigned int height, const unsigned char* pixels, unsigned int rowLength);
+
+	// forgets anything queued for the texture. textures cancel their own when destroyed
+	void cancel(Texture* texture);
+
+	// finishes textures the gpu has passed the fence of, then uploads the rows of decoded images that
+	// fit in the frame budget. the Application calls this once a frame
+	void update();
+
+	unsigned int getFrameBudget() const { return m_frameBudget; }
+	void setFrameBudget(unsigned int budget) { m_frameBudget = budget; }
+
+	// textures queued or in flight, the bytes uploaded by the last update, and the images that
+	// failed to load since creation
+	unsigned int getPendingCount() const { return (unsigned int)m_targets.size(); }
+	unsigned int getUploadedSize() const { return m_uploadedSize; }
+	unsigned int getFailedCount() const { return m_failedCount; }
+
+	// the ring the pixels are staged in, for its stall statistics
+	RingBuffer* getStagingBuffer() const { return m_stagingBuffer; }
+
+protected:
+
+	// just giving the Application class access to the TextureUploader singleton,
+	// and textures access to retarget their uploads when they are moved
+	friend class Application;
+	friend class Texture;
+
+	// singleton pointer
+	static TextureUploader* m_instance;
+
+	// only want the Application class to be able to create / destroy, once there is a context
+	static void create()	{ m_instance = new TextureUploader(); }
+	static void destroy()	{ delete m_instance; m_instance = nullptr; }
+
+	// points an upload at the texture it was moved in to
+	void retarget(unsigned int id, Texture* texture);
+
+private:
+
+	// bytes given to update() each frame, and the size of the pixel unpack ring
+	TextureUploader(unsigned int frameBudget = 8 * 1024 * 1024, unsigned int bufferSize = 32 * 1024 * 1024);
+	~TextureUploader();
+
+	struct Job {
+		unsigned int	id;
+
+		// the image to decode, or empty for pixels given to upload()
+		std::string		filename;
+		unsigned int	content;
+
+		// filled in by the worker
+		bool			succeeded;
+		unsigned int	format, width, height;
+		std::vector<std::vector<unsigned char>>	levels;
+
+		// the next rows to upload. levels go from the smallest up, each becoming the base level
+		// once its rows have been issued, so the texture sharpens as it arrives
+		bool			started;
+		unsigned int	level;
+		unsigned int	row;
+
+		// passed by the gpu once the last rows are in the texture
+		GLsync			sync;
+	};
+
+	Job makeJob(Texture* texture);
+
+	// the texture a job is still wanted for, or nullptr if a newer upload or a cancel orphaned it
+	Texture* getTarget(const Job& job) const;
+
+	// uploads the job's rows that fit in the budget, returning true once they have all been issued
+	bool upload(Job& job, Texture& texture, unsigned int& budget);
+
+	void run();
+
+	unsigned int					m_frameBudget;
+	unsigned int					m_uploadedSize;
+	unsigned int					m_failedCount;
+	RingBuffer*						m_stagingBuffer;
+
+	// the texture each current job is for, keyed by the job's id, which the texture also holds
+	std::unordered_map<unsigned int, Texture*>	m_targets;
+	unsigned int					m_nextID;
+
+	// decoded jobs partly uploaded, and jobs fully issued waiting on their fence
+	std::deque<Job>					m_uploading;
+	std::deque<Job>					m_fenced;
+
+	// jobs waiting for a worker, and jobs they have decoded, guarded by the mutex
+	std::deque<Job>					m_queued;
+	std::deque<Job>					m_decoded;
+	bool							m_quit;
+
+	std::mutex						m_mutex;
+	std::condition_variable			m_wake;
+	std::vector<std::thread>		m_threads;
+};
+
+} // namespace aie
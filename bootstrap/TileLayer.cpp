@@ -0,0 +1,161 @@
+#include "gl_core_4_4.h"
+#include "TileLayer.h"
+#include "GLState.h"
+#include "Texture.h"
+#include <random>
+#include <stb_image.h>
+
+// the generator draws from its own numbers rather than rand(), so that seeding a layer
+// doesn't reseed everyone else's. like the generator's own tables it isn't thread safe
+static std::minstd_rand wangRandom;
+
+#define STB_HBWANG_STATIC
+#define STB_HBWANG_RAND() ((int)(wangRandom() >> 4))
+#define STB_HERRINGBONE_WANG_TILE_IMPLEMENTATION
+#include <stb_herringbone_wang_tile.h>
+
+namespace aie {
+
+TileLayer::TileLayer(Texture* tileset, unsigned int tileSize, unsigned int columns, unsigned int rows,
+					 float tileWorldSize /* = 0.0f */, unsigned int chunkSize /* = 32 */)
+	: m_tileset(tileset),
+	m_tileSize(tileSize > 0 ? tileSize : 1),
+	m_columns(columns),
+	m_rows(rows),
+	m_tileWorldSize(tileWorldSize > 0 ? tileWorldSize : (float)m_tileSize),
+	m_x(0), m_y(0),
+	m_depth(0),
+	m_tiles(columns * rows, -1),
+	m_chunkSize(chunkSize > 0 ? chunkSize : 32),
+	m_rebuildCount(0) {
+
+	m_chunksX = (m_columns + m_chunkSize - 1) / m_chunkSize;
+	m_chunksY = (m_rows + m_chunkSize - 1) / m_chunkSize;
+
+	// buffers are made when a chunk is first drawn
+	Chunk chunk = { 0, 0, 0, 0, true };
+	m_chunks.assign(m_chunksX * m_chunksY, chunk);
+}
+
+TileLayer::~TileLayer() {
+	for (auto& chunk : m_chunks) {
+		if (chunk.vao != 0) {
+			GLState::forgetVertexArray(chunk.vao);
+			glDeleteVertexArrays(1, &chunk.vao);
+			glDeleteBuffers(1, &chunk.vbo);
+			glDeleteBuffers(1, &chunk.ibo);
+		}
+	}
+}
+
+void TileLayer::setTile(unsigned int x, unsigned int y, int tile) {
+	if (x >= m_columns || y >= m_rows)
+		return;
+
+	int& current = m_tiles[y * m_columns + x];
+	if (current == tile)
+		return;
+
+	current = tile;
+	m_chunks[getChunkIndex(x, y)].dirty = true;
+}
+
+int TileLayer::getTile(unsigned int x, unsigned int y) const {
+	if (x >= m_columns || y >= m_rows)
+		return -1;
+	return m_tiles[y * m_columns + x];
+}
+
+void TileLayer::fill(int tile) {
+	m_tiles.assign(m_tiles.size(), tile);
+	markAllDirty();
+}
+
+bool TileLayer::generate(const char* wangTileset, const unsigned int* palette, unsigned int paletteSize, unsigned int seed /* = 0 */) {
+
+	int x = 0, y = 0, comp = 0;
+	unsigned char* pixels = stbi_load(wangTileset, &x, &y, &comp, STBI_rgb);
+	if (pixels == nullptr)
+		return false;
+
+	bool generated = generate(pixels, x, y, palette, paletteSize, seed);
+	stbi_image_free(pixels);
+	return generated;
+}
+
+bool TileLayer::generate(const unsigned char* wangTileset, unsigned int width, unsigned int height,
+						 const unsigned int* palette, unsigned int paletteSize, unsigned int seed /* = 0 */) {
+
+	// the builder doesn't write to the image, it just isn't declared const
+	stbhw_tileset tileset;
+	if (stbhw_build_tileset_from_image(&tileset, (unsigned char*)wangTileset, width * 3, width, height) == 0)
+		return false;
+
+	// a seed gives the same layer each time
+	wangRandom.seed(seed);
+
+	std::vector<unsigned char> map(m_columns * m_rows * 3);
+	int generated = stbhw_generate_image(&tileset, nullptr, map.data(), m_columns * 3, m_columns, m_rows);
+	stbhw_free_tileset(&tileset);
+	if (generated == 0)
+		return false;
+
+	// the map's top row is the layer's top row
+	for (unsigned int row = 0; row < m_rows; ++row) {
+		const unsigned char* pixel = &map[(m_rows - 1 - row) * m_columns * 3];
+		for (unsigned int column = 0; column < m_columns; ++column, pixel += 3) {
+			unsigned int colour = (pixel[0] << 16) | (pixel[1] << 8) | pixel[2];
+
+			int tile = -1;
+			for (unsigned int i = 0; i < paletteSize; ++i) {
+				if ((palette[i] & 0xffffff) == colour) {
+					tile = (int)i;
+					break;
+				}
+			}
+
+			m_tiles[row * m_columns + column] = tile;
+		}
+	}
+
+	markAllDirty();
+	return true;
+}
+
+bool TileLayer::makeWangTemplate(unsigned int tileSize, std::vector<unsigned char>& pixels,
+								 unsigned int& width, unsigned int& height) {
+
+	// two colours for each edge type and no extra variations, the smallest set that still varies
+	stbhw_config config = {};
+	config.short_side_len = (int)tileSize;
+	for (int i = 0; i < 6; ++i)
+		config.num_color[i] = 2;
+
+	int w = 0, h = 0;
+	stbhw_get_template_size(&config, &w, &h);
+	pixels.resize(w * h * 3);
+	if (stbhw_make_template(&config, pixels.data(), w, h, w * 3) == 0)
+		return false;
+
+	width = (unsigned int)w;
+	height = (unsigned int)h;
+	return true;
+}
+
+void TileLayer::setPosition(float x, float y) {
+
+	// chunks are built relative to the layer and placed when drawn, so nothing is rebuilt
+	m_x = x;
+	m_y = y;
+}
+
+void TileLayer::setDepth(float depth) {
+	m_depth = depth;
+}
+
+void TileLayer::markAllDirty() {
+	for (auto& chunk : m_chunks)
+		chunk.dirty = true;
+}
+
+} // namespace aie
\ No newline at end of file
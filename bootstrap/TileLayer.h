@@ -0,0 +1,96 @@
+#pragma once
+
+#include <vector>
+
+namespace aie {
+
+class Texture;
+
+// a grid of tiles cut from one tileset texture, drawn with Renderer2D::drawTileLayer(). the grid
+// is split in to square chunks whose quads are built once in to their own gpu buffers, so each
+// chunk in view is a single draw call, and changing a tile only rebuilds the chunk it is in.
+// chunks are built relative to the layer, so moving it or changing its depth rebuilds nothing.
+// tile 0, 0 is at the layer's position with rows going up
+class TileLayer {
+public:
+
+	// tiles are tileSize pixels square in the tileset, at least 1, numbered left to right then top
+	// to bottom, and drawn tileWorldSize across, or at their pixel size if it is 0
+	TileLayer(Texture* tileset, unsigned int tileSize, unsigned int columns, unsigned int rows,
+			  float tileWorldSize = 0.0f, unsigned int chunkSize = 32);
+	~TileLayer();
+
+	TileLayer(const TileLayer&) = delete;
+	TileLayer& operator = (const TileLayer&) = delete;
+
+	// a negative tile leaves the cell empty
+	void setTile(unsigned int x, unsigned int y, int tile);
+	int getTile(unsigned int x, unsigned int y) const;
+	void fill(int tile);
+
+	// fills the layer from a herringbone wang tileset image made from stb_herringbone_wang_tile's
+	// template, each pixel of the generated map becoming a tile. a pixel whose colour is
+	// palette[i], as 0xrrggbb, becomes tile i and any other colour is left empty. returns false if the tileset
+	// can't be loaded or the layer is larger than the generator allows
+	bool generate(const char* wangTileset, const unsigned int* palette, unsigned int paletteSize, unsigned int seed = 0);
+
+	// the same from an rgb tileset image already in memory
+	bool generate(const unsigned char* wangTileset, unsigned int width, unsigned int height,
+				  const unsigned int* palette, unsigned int paletteSize, unsigned int seed = 0);
+
+	// makes the rgb template for a tileset of tiles tileSize pixels on their short side, with two
+	// colours for each edge. the tiles are left white with their edges marked, to be painted in
+	static bool makeWangTemplate(unsigned int tileSize, std::vector<unsigned char>& pixels,
+								 unsigned int& width, unsigned int& height);
+
+	void setPosition(float x, float y);
+	void getPosition(float& x, float& y) const { x = m_x; y = m_y; }
+
+	// depth is in the range [0,100] with lower being closer to the viewer
+	void setDepth(float depth);
+	float getDepth() const { return m_depth; }
+
+	Texture* getTileset() const { return m_tileset; }
+	unsigned int getColumns() const { return m_columns; }
+	unsigned int getRows() const { return m_rows; }
+	float getTileWorldSize() const { return m_tileWorldSize; }
+
+	unsigned int getChunkCount() const { return (unsigned int)m_chunks.size(); }
+
+	// chunks rebuilt since the layer was made
+	unsigned int getRebuildCount() const { return m_rebuildCount; }
+
+protected:
+
+	friend class Renderer2D;
+
+	struct Chunk {
+		unsigned int	vao, vbo, ibo;
+		unsigned int	indexCount;
+		bool			dirty;
+	};
+
+	unsigned int getChunkIndex(unsigned int x, unsigned int y) const {
+		return (y / m_chunkSize) * m_chunksX + x / m_chunkSize;
+	}
+
+	void markAllDirty();
+
+	Texture*			m_tileset;
+	unsigned int		m_tileSize;
+	unsigned int		m_columns, m_rows;
+	float				m_tileWorldSize;
+	float				m_x, m_y;
+	float				m_depth;
+
+	std::vector<int>	m_tiles;
+
+	// chunks are chunkSize tiles square, row by row from the bottom left, and only
+	// rebuilt when drawn after one of their tiles has changed
+	unsigned int		m_chunkSize;
+	unsigned int		m_chunksX, m_chunksY;
+	std::vector<Chunk>	m_chunks;
+	unsigned int		m_rebuildCount;
+};
+
+} // namespace aie
\ No newline at end of file